@@ -38,15 +38,20 @@
 
 # define UNIQUE_THRESHOLD 32
         /* Sizes up to this many HBLKs each have their own free list    */
-# define HUGE_THRESHOLD 256
-        /* Sizes of at least this many heap blocks are mapped to a      */
-        /* single free list.                                            */
-# define FL_COMPRESSION 8
-        /* In between sizes map this many distinct sizes to a single    */
-        /* bin.                                                         */
-
-# define N_HBLK_FLS ((HUGE_THRESHOLD - UNIQUE_THRESHOLD) / FL_COMPRESSION \
-                     + UNIQUE_THRESHOLD)
+# define LOG_UNIQUE_THRESHOLD 5
+# define LOG_FL_SUBDIVISIONS 3
+        /* Larger sizes are segregated by their binary order, and each  */
+        /* power-of-two range is further split into this many (log2)   */
+        /* equally wide free lists.  Thus a free list of index greater  */
+        /* than that of a requested size holds only blocks which are    */
+        /* large enough for it.                                         */
+# define FL_SUBDIVISIONS (1 << LOG_FL_SUBDIVISIONS)
+# define LOG_MAX_FL_BLOCKS (CPP_WORDSZ - 2 - CPP_LOG_HBLKSIZE)
+        /* Binary order of the largest possible free block in HBLKs;    */
+        /* we never generate blocks with negative signed_word size.     */
+
+# define N_HBLK_FLS (UNIQUE_THRESHOLD + ((LOG_MAX_FL_BLOCKS \
+                        - LOG_UNIQUE_THRESHOLD + 1) << LOG_FL_SUBDIVISIONS))
 
 #ifndef GC_GCJ_SUPPORT
   STATIC
@@ -64,18 +69,101 @@
   word GC_free_bytes[N_HBLK_FLS+1] = { 0 };
         /* Number of free bytes on each list.  Remains visible to GCJ.  */
 
+/* Occupancy bitmap of GC_hblkfreelist: bit i (counted in words of      */
+/* GC_hblkfl_map) is set iff the i-th free list is non-empty.  Bit j    */
+/* of GC_hblkfl_summary is set iff GC_hblkfl_map[j] is nonzero.  This   */
+/* lets us find the first non-empty free list above the given index     */
+/* with a couple of loads, instead of probing every list in turn.       */
+# define HBLKFL_MAP_SZ (N_HBLK_FLS / CPP_WORDSZ + 1)
+STATIC word GC_hblkfl_map[HBLKFL_MAP_SZ] = { 0 };
+STATIC word GC_hblkfl_summary = 0;
+
+#if defined(__GNUC__) && (__GNUC__ >= 4 || (__GNUC__ == 3 \
+                                            && __GNUC_MINOR__ >= 4))
+  /* Index of the lowest and highest set bit of a nonzero word.  */
+# define LOWEST_BIT(w) __builtin_ctzll((unsigned long long)(w))
+# define HIGHEST_BIT(w) (63 - __builtin_clzll((unsigned long long)(w)))
+#else
+  STATIC int GC_lowest_bit(word w)
+  {
+    int i = 0;
+
+    while ((w & 1) == 0) {
+      w >>= 1;
+      ++i;
+    }
+    return i;
+  }
+# define LOWEST_BIT(w) GC_lowest_bit(w)
+
+  STATIC int GC_highest_bit(word w)
+  {
+    int i = 0;
+
+    while ((w >>= 1) != 0) ++i;
+    return i;
+  }
+# define HIGHEST_BIT(w) GC_highest_bit(w)
+#endif
+
+GC_INLINE void GC_set_fl_nonempty(int index)
+{
+    unsigned i = (unsigned)index / CPP_WORDSZ;
+
+    GC_hblkfl_map[i] |= (word)1 << ((unsigned)index % CPP_WORDSZ);
+    GC_hblkfl_summary |= (word)1 << i;
+}
+
+GC_INLINE void GC_set_fl_empty(int index)
+{
+    unsigned i = (unsigned)index / CPP_WORDSZ;
+
+    GC_hblkfl_map[i] &= ~((word)1 << ((unsigned)index % CPP_WORDSZ));
+    if (0 == GC_hblkfl_map[i])
+      GC_hblkfl_summary &= ~((word)1 << i);
+}
+
+/* Return the smallest index >= n of a non-empty free list, or -1.      */
+STATIC int GC_next_nonempty_fl(int n)
+{
+    unsigned i = (unsigned)n / CPP_WORDSZ;
+    word bits;
+
+    if (n > N_HBLK_FLS) return -1;
+    bits = GC_hblkfl_map[i] & (ONES << ((unsigned)n % CPP_WORDSZ));
+    if (0 == bits) {
+      /* Consult the summary word for the first non-empty map word.     */
+      word summary = GC_hblkfl_summary & ((ONES << i) << 1);
+
+      if (0 == summary) return -1;
+      i = (unsigned)LOWEST_BIT(summary);
+      bits = GC_hblkfl_map[i];
+    }
+    return (int)(i * CPP_WORDSZ + LOWEST_BIT(bits));
+}
+
 /* Return the largest n such that the number of free bytes on lists     */
 /* n .. N_HBLK_FLS is greater or equal to GC_max_large_allocd_bytes     */
 /* minus GC_large_allocd_bytes.  If there is no such n, return 0.       */
 GC_INLINE int GC_enough_large_bytes_left(void)
 {
-    int n;
+    int i;
     word bytes = GC_large_allocd_bytes;
 
     GC_ASSERT(GC_max_large_allocd_bytes <= GC_heapsize);
-    for (n = N_HBLK_FLS; n >= 0; --n) {
+    if (bytes >= GC_max_large_allocd_bytes) return N_HBLK_FLS;
+    /* Only non-empty lists contribute, so visit just those.    */
+    for (i = HBLKFL_MAP_SZ - 1; i >= 0; --i) {
+      word bits = GC_hblkfl_map[i];
+
+      while (bits != 0) {
+        int b = HIGHEST_BIT(bits);
+        int n = i * CPP_WORDSZ + b;
+
         bytes += GC_free_bytes[n];
         if (bytes >= GC_max_large_allocd_bytes) return n;
+        bits &= ~((word)1 << b);
+      }
     }
     return 0;
 }
@@ -83,11 +171,15 @@ GC_INLINE int GC_enough_large_bytes_left(void)
 /* Map a number of blocks to the appropriate large block free list index. */
 STATIC int GC_hblk_fl_from_blocks(word blocks_needed)
 {
-    if (blocks_needed <= UNIQUE_THRESHOLD) return (int)blocks_needed;
-    if (blocks_needed >= HUGE_THRESHOLD) return N_HBLK_FLS;
-    return (int)(blocks_needed - UNIQUE_THRESHOLD)/FL_COMPRESSION
-                                        + UNIQUE_THRESHOLD;
+    int log_blocks;
 
+    if (blocks_needed <= UNIQUE_THRESHOLD) return (int)blocks_needed;
+    log_blocks = HIGHEST_BIT(blocks_needed);
+    if (log_blocks > LOG_MAX_FL_BLOCKS) return N_HBLK_FLS;
+    return UNIQUE_THRESHOLD + 1
+           + ((log_blocks - LOG_UNIQUE_THRESHOLD) << LOG_FL_SUBDIVISIONS)
+           + (int)((blocks_needed >> (log_blocks - LOG_FL_SUBDIVISIONS))
+                   & (FL_SUBDIVISIONS - 1));
 }
 
 # define PHDR(hhdr) HDR((hhdr) -> hb_prev)
@@ -178,7 +270,9 @@ void GC_dump_regions(void)
         start = GC_heap_sects[i].hs_start;
         bytes = GC_heap_sects[i].hs_bytes;
         end = start + bytes;
-        /* Merge in contiguous sections.        */
+        /* Merge in contiguous sections.  (GC_add_to_heap merges them   */
+        /* already, except on Win32.)  Every section is printed anyway, */
+        /* so there is no lookup to be done by GC_heap_sect_index.      */
           while (i+1 < GC_n_heap_sects && GC_heap_sects[i+1].hs_start == end) {
             ++i;
             end = GC_heap_sects[i].hs_start + GC_heap_sects[i].hs_bytes;
@@ -242,6 +336,9 @@ static GC_bool setup_header(hdr * hhdr, struct hblk *block, size_t byte_sz,
       hhdr -> hb_obj_kind = (unsigned char)kind;
       hhdr -> hb_flags = (unsigned char)flags;
       hhdr -> hb_block = block;
+#     ifdef REMOTE_FREE
+        hhdr -> hb_owner = 0;
+#     endif
       descr = GC_obj_kinds[kind].ok_descriptor;
       if (GC_obj_kinds[kind].ok_relocate_descr) descr += byte_sz;
       hhdr -> hb_descr = descr;
@@ -283,12 +380,26 @@ static GC_bool setup_header(hdr * hhdr, struct hblk *block, size_t byte_sz,
 #   endif /* MARK_BIT_PER_GRANULE */
 
     /* Clear mark bits */
+#   ifdef SIDE_MARK_BITS
+      GC_bind_side_marks(hhdr, block);
+#   endif
     GC_clear_hdr_marks(hhdr);
 
     hhdr -> hb_last_reclaimed = (unsigned short)GC_gc_no;
     return(TRUE);
 }
 
+#if defined(THREAD_LOCAL_ALLOC) && !defined(NO_TL_HBLK_CACHE)
+  GC_INNER GC_bool GC_setup_hblk(struct hblk *h, size_t sz, int kind)
+  {
+    hdr * hhdr = HDR(h);
+
+    GC_ASSERT(!HBLK_IS_FREE(hhdr) && hhdr -> hb_sz <= HBLKSIZE);
+    GC_ASSERT(sz <= MAXOBJBYTES);
+    return setup_header(hhdr, h, sz, kind, 0);
+  }
+#endif
+
 /* Remove hhdr from the free list (it is assumed to specified by index). */
 STATIC void GC_remove_from_fl_at(hdr *hhdr, int index)
 {
@@ -296,6 +407,8 @@ STATIC void GC_remove_from_fl_at(hdr *hhdr, int index)
     if (hhdr -> hb_prev == 0) {
         GC_ASSERT(HDR(GC_hblkfreelist[index]) == hhdr);
         GC_hblkfreelist[index] = hhdr -> hb_next;
+        if (0 == GC_hblkfreelist[index])
+          GC_set_fl_empty(index);
     } else {
         hdr *phdr;
         GET_HDR(hhdr -> hb_prev, phdr);
@@ -368,6 +481,8 @@ STATIC void GC_add_to_fl(struct hblk *h, hdr *hhdr)
 
     GC_ASSERT(((hhdr -> hb_sz) & (HBLKSIZE-1)) == 0);
     GC_hblkfreelist[index] = h;
+    if (0 == second)
+      GC_set_fl_nonempty(index);
     GC_free_bytes[index] += hhdr -> hb_sz;
     GC_ASSERT(GC_free_bytes[index] <= GC_large_free_bytes);
     hhdr -> hb_next = second;
@@ -387,6 +502,9 @@ STATIC void GC_add_to_fl(struct hblk *h, hdr *hhdr)
 
 GC_INNER int GC_unmap_threshold = MUNMAP_THRESHOLD;
 
+GC_INNER word GC_scavenge_no = 0;
+GC_INNER word GC_scavenged_bytes = 0;
+
 /* Unmap blocks that haven't been recently touched.  This is the only way */
 /* way blocks are ever unmapped.                                          */
 GC_INNER void GC_unmap_old(void)
@@ -403,7 +521,7 @@ GC_INNER void GC_unmap_old(void)
         hhdr = HDR(h);
         if (!IS_MAPPED(hhdr)) continue;
 
-        if ((unsigned short)GC_gc_no - hhdr -> hb_last_reclaimed >
+        if ((unsigned short)(GC_UNMAP_CLOCK() - hhdr -> hb_last_reclaimed) >
                 (unsigned short)GC_unmap_threshold) {
           GC_unmap((ptr_t)h, hhdr -> hb_sz);
           hhdr -> hb_flags |= WAS_UNMAPPED;
@@ -412,6 +530,47 @@ GC_INNER void GC_unmap_old(void)
     }
 }
 
+GC_INNER void GC_scavenge(unsigned age, word target_rss)
+{
+    struct hblk * h;
+    hdr * hhdr;
+    int i;
+    word limit = ~(word)0;
+    word released = 0;
+
+    GC_ASSERT(I_HOLD_LOCK());
+    GC_scavenge_no++;
+    if (target_rss != 0) {
+      word rss = GC_get_rss();
+
+      if (0 == rss) rss = GC_heapsize - GC_unmapped_bytes;
+      if (rss <= target_rss) return;
+      limit = rss - target_rss;
+    }
+    /* Start from the largest blocks, so that fewer system calls are    */
+    /* needed to go below the target.                                   */
+    for (i = N_HBLK_FLS; i >= 0 && released < limit; --i) {
+      for (h = GC_hblkfreelist[i]; 0 != h && released < limit;
+           h = hhdr -> hb_next) {
+        hhdr = HDR(h);
+        if (!IS_MAPPED(hhdr)) continue;
+
+        if ((unsigned short)(GC_UNMAP_CLOCK() - hhdr -> hb_last_reclaimed) >
+                (unsigned short)age) {
+          word unmapped_before = GC_unmapped_bytes;
+
+          GC_unmap((ptr_t)h, hhdr -> hb_sz);
+          hhdr -> hb_flags |= WAS_UNMAPPED;
+          released += GC_unmapped_bytes - unmapped_before;
+        }
+      }
+    }
+    GC_scavenged_bytes += released;
+    if (released > 0 && GC_print_stats == VERBOSE)
+      GC_log_printf("Scavenger returned %lu bytes to OS\n",
+                    (unsigned long)released);
+}
+
 /* Merge all unmapped blocks that are adjacent to other free            */
 /* blocks.  This may involve remapping, since all blocks are either     */
 /* fully mapped or fully unmapped.                                      */
@@ -551,13 +710,80 @@ STATIC void GC_split_block(struct hblk *h, hdr *hhdr, struct hblk *n,
       GC_ASSERT(GC_free_bytes[index] > h_size);
       GC_free_bytes[index] -= h_size;
 #   ifdef USE_MUNMAP
-      hhdr -> hb_last_reclaimed = (unsigned short)GC_gc_no;
+      hhdr -> hb_last_reclaimed = GC_UNMAP_CLOCK();
 #   endif
     hhdr -> hb_sz = h_size;
     GC_add_to_fl(h, hhdr);
     nhdr -> hb_flags |= FREE_BLK;
 }
 
+#ifdef USE_HUGE_PAGES
+# ifndef MAX_HUGE_PAGE_PROBES
+#   define MAX_HUGE_PAGE_PROBES 8
+# endif
+
+  /* Does the free block contain a whole huge page?  Such a page is     */
+  /* not touched by any allocated object, so it might be still backed   */
+  /* by a single huge page (or might not be populated at all).          */
+  GC_INLINE GC_bool GC_has_free_huge_page(struct hblk *h, word sz)
+  {
+    word start = ((word)h + HUGE_PAGE_SIZE - 1) & ~(word)(HUGE_PAGE_SIZE - 1);
+
+    return start >= (word)h && start - (word)h + HUGE_PAGE_SIZE <= sz;
+  }
+
+  /* Before splitting a block from the nth free list to satisfy a       */
+  /* small request, look (among the first few ones) for a block which   */
+  /* lies within partially used huge pages, and move it to the head of  */
+  /* the list.  Thus we fill such pages before splitting fresh ones.    */
+  STATIC void GC_prefer_used_huge_pages(int n)
+  {
+    struct hblk *h = GC_hblkfreelist[n];
+    hdr *hhdr;
+    int i;
+
+    if (0 == h || !GC_has_free_huge_page(h, HDR(h) -> hb_sz)) return;
+    for (i = 0; i < MAX_HUGE_PAGE_PROBES; i++) {
+      h = HDR(h) -> hb_next;
+      if (0 == h) return;
+      hhdr = HDR(h);
+      if (!GC_has_free_huge_page(h, hhdr -> hb_sz)) {
+        GC_remove_from_fl_at(hhdr, n);
+        GC_add_to_fl(h, hhdr);
+        return;
+      }
+    }
+  }
+#endif /* USE_HUGE_PAGES */
+
+#ifdef USE_NUMA
+# ifndef MAX_NUMA_PROBES
+#   define MAX_NUMA_PROBES 8
+# endif
+
+  /* Look (among the first few blocks of the nth free list) for a block */
+  /* in a heap section bound to the given node, and move it to the head */
+  /* of the list, so that the allocating thread gets local memory.      */
+  STATIC void GC_prefer_node(int n, int node)
+  {
+    struct hblk *h = GC_hblkfreelist[n];
+    hdr *hhdr;
+    int i;
+
+    for (i = 0; h != 0 && i < MAX_NUMA_PROBES; i++) {
+      hhdr = HDR(h);
+      if (GC_numa_node_of((ptr_t)h) == node) {
+        if (i > 0) {
+          GC_remove_from_fl_at(hhdr, n);
+          GC_add_to_fl(h, hhdr);
+        }
+        return;
+      }
+      h = hhdr -> hb_next;
+    }
+  }
+#endif /* USE_NUMA */
+
 STATIC struct hblk *
 GC_allochblk_nth(size_t sz /* bytes */, int kind, unsigned flags, int n,
                  int may_split);
@@ -573,24 +799,39 @@ GC_allochblk_nth(size_t sz /* bytes */, int kind, unsigned flags, int n,
  * The client is responsible for clearing the block, if necessary.
  */
 GC_INNER struct hblk *
-GC_allochblk(size_t sz, int kind, unsigned flags/* IGNORE_OFF_PAGE or 0 */)
+GC_allochblk(size_t sz, int kind, unsigned flags)
 {
     word blocks;
     int start_list;
-    struct hblk *result;
+    int n;
+    struct hblk *result = 0;
     int may_split;
     int split_limit; /* Highest index of free list whose blocks we      */
                      /* split.                                          */
+#   ifdef USE_NUMA
+      int node = GC_numa_nodes > 1 ? GC_numa_current_node() : -1;
+#   endif
 
     GC_ASSERT((sz & (GRANULE_BYTES - 1)) == 0);
+    GC_STATIC_ASSERT(HBLKFL_MAP_SZ <= CPP_WORDSZ);
+#   ifdef CAN_START_SCAVENGER
+      if (EXPECT(GC_scavenge_requested, FALSE)) GC_requested_scavenge();
+#   endif
     blocks = OBJ_SZ_TO_BLOCKS(sz);
     if ((signed_word)(blocks * HBLKSIZE) < 0) {
       return 0;
     }
     start_list = GC_hblk_fl_from_blocks(blocks);
-    /* Try for an exact match first. */
-    result = GC_allochblk_nth(sz, kind, flags, start_list, FALSE);
-    if (0 != result) return result;
+    if (start_list <= UNIQUE_THRESHOLD) {
+      /* Try for an exact match first.  Blocks in the list are all of   */
+      /* the same size, so this takes only a look at its head unless    */
+      /* there is black-listing.                                        */
+#     ifdef USE_NUMA
+        if (node >= 0) GC_prefer_node(start_list, node);
+#     endif
+      result = GC_allochblk_nth(sz, kind, flags, start_list, FALSE);
+      if (0 != result) return result;
+    }
 
     may_split = TRUE;
     if (GC_use_entire_heap || GC_dont_gc
@@ -615,15 +856,30 @@ GC_allochblk(size_t sz, int kind, unsigned flags/* IGNORE_OFF_PAGE or 0 */)
               may_split = AVOID_SPLIT_REMAPPED;
 #         endif
     }
-    if (start_list < UNIQUE_THRESHOLD) {
-      /* No reason to try start_list again, since all blocks are exact  */
-      /* matches.                                                       */
-      ++start_list;
+    /* Every block on a list above start_list is large enough, so  */
+    /* the first one which is not black-listed will do.  Unlike     */
+    /* start_list itself, those lists need no search for a fit.     */
+    for (n = GC_next_nonempty_fl(start_list + 1);
+         n > 0 && n <= split_limit; n = GC_next_nonempty_fl(n + 1)) {
+#       ifdef USE_HUGE_PAGES
+          if (GC_huge_pages != 0 && blocks * HBLKSIZE < HUGE_PAGE_SIZE)
+            GC_prefer_used_huge_pages(n);
+#       endif
+#       ifdef USE_NUMA
+          if (node >= 0) GC_prefer_node(n, node);
+#       endif
+        result = GC_allochblk_nth(sz, kind, flags, n, may_split);
+        if (0 != result) return result;
     }
-    for (; start_list <= split_limit; ++start_list) {
-        result = GC_allochblk_nth(sz, kind, flags, start_list, may_split);
-        if (0 != result)
-            break;
+    if (start_list > UNIQUE_THRESHOLD && GC_hblkfreelist[start_list] != 0) {
+      /* Nothing larger is available; look for a fit among blocks of    */
+      /* the same size range (or at least for an exact match, if we     */
+      /* are not allowed to split them).                                */
+#     ifdef USE_NUMA
+        if (node >= 0) GC_prefer_node(start_list, node);
+#     endif
+      result = GC_allochblk_nth(sz, kind, flags, start_list,
+                                start_list <= split_limit ? may_split : FALSE);
     }
     return result;
 }
@@ -632,7 +888,8 @@ STATIC long GC_large_alloc_warn_suppressed = 0;
                         /* Number of warnings suppressed so far.        */
 
 /* The same, but with search restricted to nth free list.  Flags is     */
-/* IGNORE_OFF_PAGE or zero.  sz is in bytes.  The may_split flag        */
+/* IGNORE_OFF_PAGE or zero (plus HBLK_ALIGN_FLAGS, if the block should  */
+/* be aligned beyond HBLKSIZE).  sz is in bytes.  The may_split flag    */
 /* indicates whether it is OK to split larger blocks (if set to         */
 /* AVOID_SPLIT_REMAPPED then memory remapping followed by splitting     */
 /* should be generally avoided).                                        */
@@ -647,24 +904,35 @@ GC_allochblk_nth(size_t sz, int kind, unsigned flags, int n, int may_split)
     hdr * thishdr;              /* Header corr. to hbp */
     signed_word size_needed;    /* number of bytes in requested objects */
     signed_word size_avail;     /* bytes available in this block        */
+    int start_list;             /* free list index for size_needed      */
+    word align_mask = HBLK_ALIGNMENT(flags) - 1;
 
     size_needed = HBLKSIZE * OBJ_SZ_TO_BLOCKS(sz);
+    start_list = GC_hblk_fl_from_blocks(divHBLKSZ(size_needed));
 
     /* search for a big enough block in free list */
         hbp = GC_hblkfreelist[n];
         for(; 0 != hbp; hbp = hhdr -> hb_next) {
+            struct hblk *alignedhbp;
+
             GET_HDR(hbp, hhdr);
-            size_avail = hhdr->hb_sz;
+            /* The object should start at a multiple of the requested   */
+            /* alignment; the free blocks before it are split off.      */
+            alignedhbp = (struct hblk *)(((word)hbp + align_mask)
+                                         & ~align_mask);
+            size_avail = hhdr->hb_sz - ((ptr_t)alignedhbp - (ptr_t)hbp);
             if (size_avail < size_needed) continue;
-            if (size_avail != size_needed) {
+            if (size_avail != size_needed || alignedhbp != hbp) {
               signed_word next_size;
 
               if (!may_split) continue;
               /* If the next heap block is obviously better, go on.     */
               /* This prevents us from disassembling a single large     */
-              /* block to get tiny blocks.                              */
+              /* block to get tiny blocks.  Blocks on the lists above   */
+              /* the one for the requested size differ little in size,  */
+              /* so we just take the first of them there.               */
               thishbp = hhdr -> hb_next;
-              if (thishbp != 0) {
+              if (thishbp != 0 && n == start_list) {
                 GET_HDR(thishbp, thishdr);
                 next_size = (signed_word)(thishdr -> hb_sz);
                 if (next_size < size_avail
@@ -676,8 +944,8 @@ GC_allochblk_nth(size_t sz, int kind, unsigned flags, int n, int may_split)
             }
             if (!IS_UNCOLLECTABLE(kind) && (kind != PTRFREE
                         || size_needed > (signed_word)MAX_BLACK_LIST_ALLOC)) {
-              struct hblk * lasthbp = hbp;
-              ptr_t search_end = (ptr_t)hbp + size_avail - size_needed;
+              struct hblk * lasthbp = alignedhbp;
+              ptr_t search_end = (ptr_t)alignedhbp + size_avail - size_needed;
               signed_word orig_avail = size_avail;
               signed_word eff_size_needed = (flags & IGNORE_OFF_PAGE) != 0 ?
                                                 (signed_word)HBLKSIZE
@@ -686,37 +954,14 @@ GC_allochblk_nth(size_t sz, int kind, unsigned flags, int n, int may_split)
               while ((word)lasthbp <= (word)search_end
                      && (thishbp = GC_is_black_listed(lasthbp,
                                             (word)eff_size_needed)) != 0) {
-                lasthbp = thishbp;
+                lasthbp = (struct hblk *)(((word)thishbp + align_mask)
+                                          & ~align_mask);
               }
-              size_avail -= (ptr_t)lasthbp - (ptr_t)hbp;
+              size_avail -= (ptr_t)lasthbp - (ptr_t)alignedhbp;
               thishbp = lasthbp;
-              if (size_avail >= size_needed) {
-                if (thishbp != hbp) {
-#                 ifdef USE_MUNMAP
-                    /* Avoid remapping followed by splitting.   */
-                    if (may_split == AVOID_SPLIT_REMAPPED && !IS_MAPPED(hhdr))
-                      continue;
-#                 endif
-                  thishdr = GC_install_header(thishbp);
-                  if (0 != thishdr) {
-                  /* Make sure it's mapped before we mangle it. */
-#                   ifdef USE_MUNMAP
-                      if (!IS_MAPPED(hhdr)) {
-                        GC_remap((ptr_t)hbp, hhdr -> hb_sz);
-                        hhdr -> hb_flags &= ~WAS_UNMAPPED;
-                      }
-#                   endif
-                  /* Split the block at thishbp */
-                      GC_split_block(hbp, hhdr, thishbp, thishdr, n);
-                  /* Advance to thishbp */
-                      hbp = thishbp;
-                      hhdr = thishdr;
-                      /* We must now allocate thishbp, since it may     */
-                      /* be on the wrong free list.                     */
-                  }
-                }
-              } else if (size_needed > (signed_word)BL_LIMIT
-                         && orig_avail - size_needed
+              if (size_avail < size_needed
+                  && size_needed > (signed_word)BL_LIMIT
+                  && orig_avail - size_needed
                             > (signed_word)BL_LIMIT) {
                 /* Punt, since anything else risks unreasonable heap growth. */
                 if (++GC_large_alloc_warn_suppressed
@@ -728,8 +973,9 @@ GC_allochblk_nth(size_t sz, int kind, unsigned flags, int n, int may_split)
                   GC_large_alloc_warn_suppressed = 0;
                 }
                 size_avail = orig_avail;
+                thishbp = alignedhbp;
               } else if (size_avail == 0 && size_needed == HBLKSIZE
-                         && IS_MAPPED(hhdr)) {
+                         && alignedhbp == hbp && IS_MAPPED(hhdr)) {
                 if (!GC_find_leak) {
                   static unsigned count = 0;
 
@@ -771,6 +1017,34 @@ GC_allochblk_nth(size_t sz, int kind, unsigned flags, int n, int may_split)
                   }
                 }
               }
+            } else {
+              thishbp = alignedhbp;
+            }
+            if (size_avail >= size_needed && thishbp != hbp) {
+#             ifdef USE_MUNMAP
+                /* Avoid remapping followed by splitting.   */
+                if (may_split == AVOID_SPLIT_REMAPPED && !IS_MAPPED(hhdr))
+                  continue;
+#             endif
+              thishdr = GC_install_header(thishbp);
+              if (0 != thishdr) {
+                /* Make sure it's mapped before we mangle it. */
+#               ifdef USE_MUNMAP
+                  if (!IS_MAPPED(hhdr)) {
+                    GC_remap((ptr_t)hbp, hhdr -> hb_sz);
+                    hhdr -> hb_flags &= ~WAS_UNMAPPED;
+                  }
+#               endif
+                /* Split the block at thishbp */
+                GC_split_block(hbp, hhdr, thishbp, thishdr, n);
+                /* Advance to thishbp */
+                hbp = thishbp;
+                hhdr = thishdr;
+                /* We must now allocate thishbp, since it may be on the */
+                /* wrong free list.                                     */
+              } else if (align_mask >= HBLKSIZE) {
+                continue;
+              }
             }
             if( size_avail >= size_needed ) {
 #               ifdef USE_MUNMAP
@@ -794,7 +1068,7 @@ GC_allochblk_nth(size_t sz, int kind, unsigned flags, int n, int may_split)
         /* This leaks memory under very rare conditions. */
 
     /* Set up header */
-        if (!setup_header(hhdr, hbp, sz, kind, flags)) {
+        if (!setup_header(hhdr, hbp, sz, kind, flags & IGNORE_OFF_PAGE)) {
             GC_remove_counts(hbp, (word)size_needed);
             return(0); /* ditto */
         }
@@ -817,6 +1091,50 @@ GC_allochblk_nth(size_t sz, int kind, unsigned flags, int n, int may_split)
     return( hbp );
 }
 
+/* Grow the large object block h in place to new_size bytes (a          */
+/* multiple of HBLKSIZE) by taking the first part of the free block     */
+/* following it, if that one is large enough (and not black-listed for  */
+/* the object kind).  Only hb_sz of the object header is updated.       */
+/* Return FALSE if the block cannot be extended (h is unchanged then).  */
+GC_INNER GC_bool GC_extend_hblk(struct hblk *h, size_t new_size)
+{
+    hdr *hhdr = HDR(h);
+    word size = HBLKSIZE * OBJ_SZ_TO_BLOCKS(hhdr -> hb_sz);
+    word extra = new_size - size;
+    struct hblk *next = (struct hblk *)((ptr_t)h + size);
+    hdr *nexthdr;
+    int kind = hhdr -> hb_obj_kind;
+
+    GC_ASSERT(I_HOLD_LOCK());
+    GC_ASSERT((new_size & (HBLKSIZE-1)) == 0 && new_size > size);
+    GET_HDR(next, nexthdr);
+    if (0 == nexthdr || !HBLK_IS_FREE(nexthdr) || nexthdr -> hb_sz < extra)
+      return FALSE;
+    if (!IS_UNCOLLECTABLE(kind) && (hhdr -> hb_flags & IGNORE_OFF_PAGE) == 0
+        && (kind != PTRFREE || extra > MAX_BLACK_LIST_ALLOC)
+        && GC_is_black_listed(next, extra) != 0)
+      return FALSE;
+#   ifdef USE_MUNMAP
+      if (!IS_MAPPED(nexthdr)) {
+        GC_remap((ptr_t)next, nexthdr -> hb_sz);
+        nexthdr -> hb_flags &= ~WAS_UNMAPPED;
+      }
+#   endif
+    if (GC_get_first_part(next, nexthdr, extra,
+                GC_hblk_fl_from_blocks(divHBLKSZ(nexthdr -> hb_sz))) == 0)
+      return FALSE;
+    GC_remove_header(next);
+    if (!GC_install_counts(h, new_size)) return FALSE;
+        /* This leaks the taken blocks under very rare conditions,      */
+        /* as in GC_allochblk_nth.                                      */
+#   ifndef GC_DISABLE_INCREMENTAL
+      GC_remove_protection(next, divHBLKSZ(extra), hhdr -> hb_descr == 0);
+#   endif
+    hhdr -> hb_sz = new_size;
+    GC_large_free_bytes -= extra;
+    return TRUE;
+}
+
 /*
  * Free a heap block.
  *
@@ -840,7 +1158,7 @@ GC_INNER void GC_freehblk(struct hblk *hbp)
     GC_remove_counts(hbp, size);
     hhdr->hb_sz = size;
 #   ifdef USE_MUNMAP
-      hhdr -> hb_last_reclaimed = (unsigned short)GC_gc_no;
+      hhdr -> hb_last_reclaimed = GC_UNMAP_CLOCK();
 #   endif
 
     /* Check for duplicate deallocation in the easy case */
@@ -853,6 +1171,9 @@ GC_INNER void GC_freehblk(struct hblk *hbp)
 
     GC_ASSERT(IS_MAPPED(hhdr));
     hhdr -> hb_flags |= FREE_BLK;
+#   ifdef SIDE_MARK_BITS
+      GC_release_side_marks(hbp);
+#   endif
     next = (struct hblk *)((ptr_t)hbp + size);
     GET_HDR(next, nexthdr);
     prev = GC_free_block_ending_at(hbp);
@@ -872,7 +1193,7 @@ GC_INNER void GC_freehblk(struct hblk *hbp)
           GC_remove_from_fl(prevhdr);
           prevhdr -> hb_sz += hhdr -> hb_sz;
 #         ifdef USE_MUNMAP
-            prevhdr -> hb_last_reclaimed = (unsigned short)GC_gc_no;
+            prevhdr -> hb_last_reclaimed = GC_UNMAP_CLOCK();
 #         endif
           GC_remove_header(hbp);
           hbp = prev;
@@ -609,6 +609,11 @@ STATIC GC_bool GC_stopped_mark(GC_stop_func stop_func)
         GET_TIME(start_time);
 #   endif
 
+#   if defined(THREAD_LOCAL_ALLOC) && !defined(NO_TL_HBLK_CACHE)
+      /* This must precede stopping the world, since it waits for the   */
+      /* threads setting up a cached block without the lock.            */
+      GC_flush_thread_local_hblks();
+#   endif
     STOP_WORLD();
 #   ifdef THREAD_LOCAL_ALLOC
       GC_world_stopped = TRUE;
@@ -742,6 +747,9 @@ GC_INNER void GC_set_fl_marks(ptr_t q)
       AO_t *p;
 
       if ((word)list <= HBLKSIZE) return;
+#     ifdef USE_ALLOC_SPANS
+        if (((word)list & GC_SPAN_TAG) != 0) return; /* not a list */
+#     endif
 
       prev = (AO_t *)pfreelist;
       for (p = list; p != NULL;) {
@@ -895,6 +903,10 @@ STATIC void GC_finish_collection(void)
 #     endif
     }
 
+#   ifdef HEAP_PROFILE
+      GC_heap_profile_update_live();
+#   endif
+
     /* Clear free list mark bits, in case they got accidentally marked   */
     /* (or GC_find_leak is set and they were intentionally marked).      */
     /* Also subtract memory remaining from GC_bytes_found count.         */
@@ -947,6 +959,16 @@ STATIC void GC_finish_collection(void)
     GC_bytes_allocd_before_gc += GC_bytes_allocd;
     GC_non_gc_bytes_at_gc = GC_non_gc_bytes;
     GC_bytes_allocd = 0;
+#   ifndef SMALL_CONFIG
+      {
+        unsigned kind;
+        size_t lg;
+
+        for (kind = 0; kind < GC_n_kinds; kind++)
+          for (lg = 0; lg <= MAXOBJGRANULES; lg++)
+            GC_class_stats[kind][lg].cs_bytes_allocd = 0;
+      }
+#   endif
     GC_bytes_dropped = 0;
     GC_bytes_freed = 0;
     GC_finalizer_bytes_freed = 0;
@@ -1047,6 +1069,127 @@ GC_INNER word GC_n_heap_sects = 0;
   }
 #endif
 
+GC_INNER word GC_heap_sect_index(ptr_t p)
+{
+    word lo = 0;
+    word hi = GC_n_heap_sects;
+
+    while (lo < hi) {
+        word mid = (lo + hi) >> 1;
+
+        if ((word)p < (word)GC_heap_sects[mid].hs_start) {
+            hi = mid;
+        } else if ((word)p >= (word)GC_heap_sects[mid].hs_start
+                                + GC_heap_sects[mid].hs_bytes) {
+            lo = mid + 1;
+        } else {
+            return mid;
+        }
+    }
+    return lo;
+}
+
+#if !defined(MSWIN32) && !defined(MSWINCE) && !defined(CYGWIN32) \
+    && !defined(GWW_VDB) && !defined(PCR)
+  /* Adjacent sections may be merged.  (On Win32, each section should   */
+  /* correspond to a single VirtualAlloc'ed region.)                    */
+# define COALESCE_HEAP_SECTS
+#endif
+
+/* Record the new section [p, p + bytes) in GC_heap_sects keeping the   */
+/* table sorted, merging it with the adjacent sections if possible.     */
+STATIC void GC_add_heap_sect(ptr_t p, size_t bytes)
+{
+    word i = GC_heap_sect_index(p);
+#   ifdef USE_NUMA
+      int node = 0;
+
+      if (GC_numa_nodes > 1) {
+        /* Bind the section to the node of the expanding thread, which  */
+        /* is likely to allocate from it first.                         */
+        node = GC_numa_current_node();
+        GC_numa_bind(p, bytes, node);
+      }
+#     define SAME_NODE(j) (GC_heap_sects[j].hs_node == node)
+#   else
+#     define SAME_NODE(j) TRUE
+#   endif
+
+    GC_ASSERT(i == GC_n_heap_sects
+              || (word)(p + bytes) <= (word)GC_heap_sects[i].hs_start);
+#   ifdef COALESCE_HEAP_SECTS
+      if (i > 0 && GC_heap_sects[i-1].hs_start
+                   + GC_heap_sects[i-1].hs_bytes == p && SAME_NODE(i-1)) {
+        GC_heap_sects[i-1].hs_bytes += bytes;
+        if (i < GC_n_heap_sects && GC_heap_sects[i].hs_start == p + bytes
+            && SAME_NODE(i)) {
+          /* The gap between two sections is filled.    */
+          GC_heap_sects[i-1].hs_bytes += GC_heap_sects[i].hs_bytes;
+          for (; i + 1 < GC_n_heap_sects; i++)
+            GC_heap_sects[i] = GC_heap_sects[i+1];
+          GC_n_heap_sects--;
+        }
+        return;
+      }
+      if (i < GC_n_heap_sects && GC_heap_sects[i].hs_start == p + bytes
+          && SAME_NODE(i)) {
+        GC_heap_sects[i].hs_start = p;
+        GC_heap_sects[i].hs_bytes += bytes;
+        return;
+      }
+#   endif
+    if (GC_n_heap_sects == GC_capacity_heap_sects) {
+      /* Grow the table geometrically.  The old one is not reclaimed    */
+      /* (it is scratch memory) but the total waste is bounded by the   */
+      /* size of the final table.                                       */
+      word new_capacity = GC_n_heap_sects > 0 ? GC_n_heap_sects * 2
+                                              : INITIAL_HEAP_SECTS;
+      struct HeapSect *new_heap_sects = (struct HeapSect *)GC_scratch_alloc(
+                            (size_t)new_capacity * sizeof(struct HeapSect));
+
+      if (EXPECT(NULL == new_heap_sects, FALSE)) {
+        /* Try a smaller increment.     */
+        new_capacity = GC_n_heap_sects + INITIAL_HEAP_SECTS;
+        new_heap_sects = (struct HeapSect *)GC_scratch_alloc(
+                            (size_t)new_capacity * sizeof(struct HeapSect));
+        if (NULL == new_heap_sects)
+          ABORT("Insufficient memory for heap sections");
+      }
+      if (GC_n_heap_sects > 0)
+        BCOPY(GC_heap_sects, new_heap_sects,
+              GC_n_heap_sects * sizeof(struct HeapSect));
+      GC_heap_sects = new_heap_sects;
+      GC_capacity_heap_sects = new_capacity;
+      if (GC_print_stats == VERBOSE)
+        GC_log_printf("Grew heap sections table to %lu entries\n",
+                      (unsigned long)new_capacity);
+    }
+    {
+      word j;
+
+      for (j = GC_n_heap_sects; j > i; j--)
+        GC_heap_sects[j] = GC_heap_sects[j-1];
+    }
+    GC_heap_sects[i].hs_start = p;
+    GC_heap_sects[i].hs_bytes = bytes;
+#   ifdef USE_NUMA
+      GC_heap_sects[i].hs_node = node;
+#   endif
+    GC_n_heap_sects++;
+#   undef SAME_NODE
+}
+
+#ifdef USE_NUMA
+  GC_INNER int GC_numa_node_of(ptr_t p)
+  {
+    word i = GC_heap_sect_index(p);
+
+    if (i == GC_n_heap_sects || (word)p < (word)GC_heap_sects[i].hs_start)
+      return -1;
+    return GC_heap_sects[i].hs_node;
+  }
+#endif
+
 /*
  * Use the chunk of memory starting at p of size bytes as part of the heap.
  * Assumes p is HBLKSIZE aligned, and bytes is a multiple of HBLKSIZE.
@@ -1056,9 +1199,6 @@ GC_INNER void GC_add_to_heap(struct hblk *p, size_t bytes)
     hdr * phdr;
     word endp;
 
-    if (GC_n_heap_sects >= MAX_HEAP_SECTS) {
-        ABORT("Too many heap sections: Increase MAXHINCR or MAX_HEAP_SECTS");
-    }
     while ((word)p <= HBLKSIZE) {
         /* Can't handle memory near address zero. */
         ++p;
@@ -1072,6 +1212,9 @@ GC_INNER void GC_add_to_heap(struct hblk *p, size_t bytes)
         if (0 == bytes) return;
         endp -= HBLKSIZE;
     }
+#   ifdef SIDE_MARK_BITS
+      if (!GC_add_mark_table(p, bytes)) return;
+#   endif
     phdr = GC_install_header(p);
     if (0 == phdr) {
         /* This is extremely unlikely. Can't add it.  This will         */
@@ -1080,9 +1223,7 @@ GC_INNER void GC_add_to_heap(struct hblk *p, size_t bytes)
         return;
     }
     GC_ASSERT(endp > (word)p && endp == (word)p + bytes);
-    GC_heap_sects[GC_n_heap_sects].hs_start = (ptr_t)p;
-    GC_heap_sects[GC_n_heap_sects].hs_bytes = bytes;
-    GC_n_heap_sects++;
+    GC_add_heap_sect((ptr_t)p, bytes);
     phdr -> hb_sz = bytes;
     phdr -> hb_flags = 0;
     GC_freehblk(p);
@@ -1163,9 +1304,10 @@ GC_INNER GC_bool GC_expand_hp_inner(word n)
 
     if (n < MINHINCR) n = MINHINCR;
     bytes = n * HBLKSIZE;
-    /* Make sure bytes is a multiple of GC_page_size */
+    /* Make sure bytes is a multiple of GC_page_size (or huge page     */
+    /* size in the huge page mode).                                     */
       {
-        word mask = GC_page_size - 1;
+        word mask = HEAP_SECT_GRANULE - 1;
         bytes += mask;
         bytes &= ~mask;
       }
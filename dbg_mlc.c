@@ -153,6 +153,9 @@
         /* This doesn't yield a uniform distribution, especially if     */
         /* e.g. RAND_MAX = 1.5* GC_heapsize.  But for typical cases,    */
         /* it's not too bad.                                            */
+        /* The section is found by an offset, not by an address, so     */
+        /* GC_heap_sect_index() does not apply; this is called once per */
+        /* generated backtrace, and the sections are mostly merged.     */
     for (i = 0;; ++i) {
         if (i >= GC_n_heap_sects)
           ABORT("GC_generate_random_heap_address: size inconsistency");
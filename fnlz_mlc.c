@@ -109,6 +109,7 @@ GC_API void GC_CALL GC_register_disclaim_proc(int kind, GC_disclaim_proc proc,
             *opp = obj_link(op);
             obj_link(op) = 0;
             GC_bytes_allocd += GRANULES_TO_BYTES(lg);
+            GC_CLASS_ALLOCD(GC_finalized_kind, lg, GRANULES_TO_BYTES(lg));
             UNLOCK();
         }
         GC_ASSERT(lg > 0);
@@ -185,6 +185,7 @@ static void maybe_finalize(void)
         } else {
             *opp = obj_link(op);
             GC_bytes_allocd += GRANULES_TO_BYTES(lg);
+            GC_CLASS_ALLOCD(GC_gcj_kind, lg, GRANULES_TO_BYTES(lg));
         }
         *(void **)op = ptr_to_struct_containing_descr;
         GC_ASSERT(((void **)op)[1] == 0);
@@ -261,6 +262,7 @@ GC_API void * GC_CALL GC_gcj_malloc_ignore_off_page(size_t lb,
         } else {
             *opp = obj_link(op);
             GC_bytes_allocd += GRANULES_TO_BYTES(lg);
+            GC_CLASS_ALLOCD(GC_gcj_kind, lg, GRANULES_TO_BYTES(lg));
         }
     } else {
         LOCK();
@@ -201,6 +201,17 @@ GC_INNER void GC_init_headers(void)
       EXIT();
     }
     BZERO(GC_all_nils, sizeof(bottom_index));
+#   ifdef FLAT_HDR_TABLE
+      GC_flat_hdrs = (hdr **)GC_unix_reserve_mem(FLAT_HDR_ENTRIES
+                                                 * sizeof(hdr *));
+      GC_all_nils -> index = (hdr **)GC_scratch_alloc(BOTTOM_SZ
+                                                      * sizeof(hdr *));
+      if (NULL == GC_flat_hdrs || NULL == GC_all_nils -> index) {
+        GC_err_printf("Insufficient memory for flat header table\n");
+        EXIT();
+      }
+      BZERO(GC_all_nils -> index, BOTTOM_SZ * sizeof(hdr *));
+#   endif
     for (i = 0; i < TOP_SZ; i++) {
         GC_top_index[i] = GC_all_nils;
     }
@@ -216,6 +227,9 @@ static GC_bool get_index(word addr)
     bottom_index ** prev;
     bottom_index *pi;
 
+#   ifdef FLAT_HDR_TABLE
+      if (hi >= (FLAT_HDR_ENTRIES >> LOG_BOTTOM_SZ)) return(FALSE);
+#   endif
 #   ifdef HASH_TL
       word i = TL_HASH(hi);
       bottom_index * old;
@@ -238,6 +252,9 @@ static GC_bool get_index(word addr)
       BZERO(r, sizeof (bottom_index));
 #   endif
     r -> key = hi;
+#   ifdef FLAT_HDR_TABLE
+      r -> index = GC_flat_hdrs + (hi << LOG_BOTTOM_SZ);
+#   endif
     /* Add it to the list of bottom indices */
       prev = &GC_all_bottom_indices;    /* pointer to p */
       pi = 0;                           /* bottom_index preceding p */
@@ -268,7 +285,7 @@ GC_INNER struct hblkhdr * GC_install_header(struct hblk *h)
     if (result) {
       SET_HDR(h, result);
 #     ifdef USE_MUNMAP
-        result -> hb_last_reclaimed = (unsigned short)GC_gc_no;
+        result -> hb_last_reclaimed = GC_UNMAP_CLOCK();
 #     endif
     }
     return(result);
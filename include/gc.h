@@ -99,6 +99,22 @@ GC_API GC_word GC_CALL GC_get_gc_no(void);
                         /* number of existing parallel marker threads   */
                         /* excluding the initiating one).               */
   GC_API int GC_CALL GC_get_parallel(void);
+
+  GC_API int GC_CALL GC_set_markers_count(int /* markers */);
+                        /* Set the number of marker threads, including  */
+                        /* the one initiating a collection.  If called  */
+                        /* before GC_INIT, this overrides GC_MARKERS.   */
+                        /* Otherwise, if the parallel marking is on,    */
+                        /* the helper threads are started or retired    */
+                        /* (parked) at runtime, keeping at least 2 and  */
+                        /* at most the pool size (the number of         */
+                        /* processors or the initial number of markers, */
+                        /* whichever is greater); a retirement takes    */
+                        /* effect from the next collection.  Returns    */
+                        /* the resulting number of markers.  Only the   */
+                        /* POSIX threads (non-Win32) implementation     */
+                        /* supports this; otherwise, the number is not  */
+                        /* changed.  Acquires the GC lock.              */
 #endif
 
 
@@ -400,7 +416,8 @@ GC_API GC_ATTR_MALLOC GC_ATTR_ALLOC_SIZE(1) void * GC_CALL
 GC_API GC_ATTR_MALLOC GC_ATTR_ALLOC_SIZE(1) void * GC_CALL
         GC_malloc_stubborn(size_t /* size_in_bytes */);
 
-/* GC_memalign() is not well tested.                                    */
+/* GC_memalign() returns the base of a (collectable) object if align   */
+/* is a power of two; its size is rounded up to a multiple of align.    */
 GC_API GC_ATTR_MALLOC GC_ATTR_ALLOC_SIZE(2) void * GC_CALL
         GC_memalign(size_t /* align */, size_t /* lb */);
 GC_API int GC_CALL GC_posix_memalign(void ** /* memptr */, size_t /* align */,
@@ -579,6 +596,68 @@ GC_API size_t GC_CALL GC_get_free_bytes(void);
 /* getter (see GC_get_heap_size comment regarding thread-safety).       */
 GC_API size_t GC_CALL GC_get_unmapped_bytes(void);
 
+/* Start a background thread which, every interval_ms milliseconds,     */
+/* returns to the OS the free heap blocks not reused for more than age  */
+/* such intervals (both the intervals and the collections are counted), */
+/* while the resident set size of the process (or the mapped heap size  */
+/* if the former is unknown) exceeds target_rss (0 means no target,     */
+/* i.e. all the old blocks are returned).  If the thread is already     */
+/* running then just update its parameters.  Supported only if the      */
+/* collector is built with USE_MUNMAP and pthreads support (otherwise   */
+/* the function fails).  Returns 0 on success.                          */
+GC_API int GC_CALL GC_start_scavenger(unsigned /* interval_ms */,
+                                      unsigned /* age */,
+                                      GC_word /* target_rss */);
+
+/* Return the total number of bytes returned to the OS by the           */
+/* background scavenger.  Unsynchronized getter.                        */
+GC_API GC_word GC_CALL GC_get_scavenged_bytes(void);
+
+/* Set custom size classes for the small objects: sizes[0..n-1] are the */
+/* largest request sizes (in bytes, strictly ascending) of the classes, */
+/* i.e. a request is served by the smallest class not less than it      */
+/* (the objects of a class may be a bit larger if this does not reduce  */
+/* the number of them fitting in a heap block).  Only the sizes above   */
+/* those getting the exact number of granules (24 granules or so) are   */
+/* affected; the requests larger than sizes[n-1] get the default size   */
+/* classes.  Should be called before GC_INIT() (the environment         */
+/* variable GC_SIZE_CLASSES could be used instead).  Returns 0 on       */
+/* success, nonzero if the table is invalid or the collector is         */
+/* already initialized.                                                 */
+GC_API int GC_CALL GC_set_size_classes(const size_t * /* sizes */,
+                                       unsigned /* n */);
+
+/* Start recording the sizes of the small object requests made by       */
+/* GC_malloc, GC_malloc_atomic, GC_malloc_uncollectable and             */
+/* GC_generic_malloc (the requests served by the thread-local free      */
+/* lists, i.e. those not affected by GC_set_size_classes, are not       */
+/* recorded).                                                           */
+GC_API void GC_CALL GC_start_size_profiling(void);
+
+/* Print the number of the recorded requests, the share of the bytes    */
+/* lost to rounding them up to the size classes, and the table of size  */
+/* classes (in the GC_SIZE_CLASSES format) minimizing the latter.  Does */
+/* nothing unless the size profiling is started.                        */
+GC_API void GC_CALL GC_print_size_profile(void);
+
+/* Start the sampling heap profiler: the stack of an allocation is      */
+/* recorded once per about sample_interval bytes allocated (at random   */
+/* distances, so every byte is equally likely to be sampled), 512 KiB   */
+/* if sample_interval is 0.  Each collection finds out which of the     */
+/* sampled objects are still live.  May be called again to change the   */
+/* interval.  Returns GC_SUCCESS, GC_NO_MEMORY, or GC_UNIMPLEMENTED if  */
+/* the collector is built without HEAP_PROFILE (or with                 */
+/* REDIRECT_MALLOC), or the platform lacks backtrace().                 */
+GC_API int GC_CALL GC_start_heap_profiling(size_t /* sample_interval */);
+
+/* Write the heap profile to the given file in the (legacy text) format */
+/* understood by pprof: the live sampled objects (as of the last        */
+/* collection, so call GC_gcollect first for an accurate picture) and   */
+/* all the sampled allocations, by allocation stack.  Returns 0 on      */
+/* success, GC_NOT_FOUND if the profiling is not started, another       */
+/* nonzero value on failure.                                            */
+GC_API int GC_CALL GC_dump_heap_profile(const char * /* file_name */);
+
 /* Return the number of bytes allocated since the last collection.      */
 /* This is an unsynchronized getter (see GC_get_heap_size comment       */
 /* regarding thread-safety).                                            */
@@ -638,6 +717,22 @@ struct GC_prof_stats_s {
   GC_word reclaimed_bytes_before_gc;
             /* Approximate number of bytes reclaimed before the recent  */
             /* garbage collection.  The value may wrap.                 */
+  GC_word scavenged_bytes;
+            /* Total amount of memory returned to OS by the background  */
+            /* scavenger.  Same as returned by GC_get_scavenged_bytes.  */
+  GC_word tl_refills;
+            /* Number of refills of the thread-local free lists (some   */
+            /* of those done without the lock are counted only at the   */
+            /* next collection).  0 without the thread-local allocation.*/
+  GC_word tl_locked_refills;
+            /* Number of the above refills which acquired the lock.     */
+  GC_word tl_stranded_bytes;
+            /* Bytes held by the thread-local free lists (thus not      */
+            /* usable by the other threads) at the recent collection.   */
+  GC_word realloc_moved_bytes;
+            /* Bytes of the objects moved by GC_realloc by swapping     */
+            /* their pages rather than copying them.  0 unless the      */
+            /* collector is built with USE_MREMAP_REALLOC.              */
 };
 
 /* Atomically get GC statistics (various global counters).  Clients     */
@@ -659,6 +754,43 @@ GC_API size_t GC_CALL GC_get_prof_stats(struct GC_prof_stats_s *,
                                                  size_t /* stats_sz */);
 #endif
 
+/* Structure used to query the statistics of an object kind and size    */
+/* class.  Extended in the same way as GC_prof_stats_s.                 */
+struct GC_size_class_stats_s {
+  GC_word bytes_allocd_since_gc;
+            /* Number of bytes allocated since the recent collection,   */
+            /* including the objects handed out to the thread-local     */
+            /* free lists.  Approximate with the parallel marking.      */
+  GC_word live_bytes;
+            /* Number of bytes found marked by the recent collection.   */
+  GC_word blocks;
+            /* Number of heap blocks in use at the recent collection.   */
+  GC_word free_list_len;
+            /* Number of objects on the global free list (those on the  */
+            /* thread-local ones are not counted).                      */
+  GC_word nearly_full_blocks;
+            /* Number of blocks not swept after the recent collection   */
+            /* since nearly all their objects were live.                */
+};
+
+/* Get the statistics of the objects of the given kind (0 for the       */
+/* pointer-free ones, 1 for the normal ones, 2 for the uncollectable    */
+/* ones, or a value returned by GC_new_kind) and size in granules       */
+/* (GC_GRANULE_BYTES each), 0 meaning all the large objects of the      */
+/* kind.  The size of the buffer is passed the same way as to           */
+/* GC_get_prof_stats.  Return 0 if the kind or size is out of range     */
+/* (or the collector is built with SMALL_CONFIG), so the classes can be */
+/* enumerated by incrementing granules until 0 is returned, for each    */
+/* kind until the call with zero granules returns 0.                    */
+GC_API size_t GC_CALL GC_get_size_class_stats(int /* kind */,
+                                        size_t /* granules */,
+                                        struct GC_size_class_stats_s *,
+                                        size_t /* stats_sz */);
+
+/* Print the statistics of all the size classes in use (i.e. having    */
+/* blocks or allocations since the recent collection).                  */
+GC_API void GC_CALL GC_print_size_class_stats(void);
+
 /* Disable garbage collection.  Even GC_gcollect calls will be          */
 /* ineffective.                                                         */
 GC_API void GC_CALL GC_disable(void);
@@ -1400,6 +1532,66 @@ GC_API GC_ATTR_MALLOC void * GC_CALL GC_malloc_many(size_t /* lb */);
 #define GC_NEXT(p) (*(void * *)(p))     /* Retrieve the next element    */
                                         /* in returned list.            */
 
+/* Allocate n objects of size lb and store pointers to them in          */
+/* result[0..n-1], acquiring the allocation lock only once.  Unlike     */
+/* GC_malloc_many, this is not limited to small sizes or to one block   */
+/* worth of objects.  The result array should be visible to the         */
+/* collector (e.g., be on the stack or in the GC heap), since a         */
+/* collection may occur before all the objects are allocated.  Returns  */
+/* the number of allocated objects, which is less than n only if out of */
+/* memory (the rest of result is then cleared).                         */
+GC_API size_t GC_CALL GC_malloc_bulk(size_t /* lb */, size_t /* n */,
+                                     void ** /* result */) GC_ATTR_NONNULL(3);
+GC_API size_t GC_CALL GC_malloc_atomic_bulk(size_t /* lb */, size_t /* n */,
+                                            void ** /* result */)
+                                                        GC_ATTR_NONNULL(3);
+GC_API size_t GC_CALL GC_malloc_uncollectable_bulk(size_t /* lb */,
+                                                   size_t /* n */,
+                                                   void ** /* result */)
+                                                        GC_ATTR_NONNULL(3);
+
+/* Set the bounds (in bytes) of the batch in which the thread-local     */
+/* free lists are refilled.  The batch of each thread and size class    */
+/* starts at a heap block worth of objects; it is doubled whenever the  */
+/* list is refilled often between two collections (so the allocation   */
+/* lock is acquired less often), and halved at each collection if the   */
+/* list was refilled at most once since the previous one (so fewer free */
+/* objects are held by threads allocating little of that size).  A list */
+/* not refilled at all in a collection cycle is returned to the         */
+/* collector but for a couple of objects.  Equal bounds fix the batch;  */
+/* the defaults are HBLKSIZE/4 and 8*HBLKSIZE.                          */
+/* Has no effect unless the thread-local allocation is supported.       */
+GC_API void GC_CALL GC_set_tl_refill_limits(size_t /* min_bytes */,
+                                            size_t /* max_bytes */);
+GC_API void GC_CALL GC_get_tl_refill_limits(size_t * /* pmin_bytes */,
+                                            size_t * /* pmax_bytes */)
+                                                GC_ATTR_NONNULL(1)
+                                                GC_ATTR_NONNULL(2);
+
+/* Scoped allocation regions.  Small objects allocated in a region come */
+/* from blocks private to it; no lock is acquired except to get a new   */
+/* block, so a region should be used by one thread at a time.  The      */
+/* objects are ordinary (collectable) ones, except that they are not    */
+/* reclaimed (and GC_free ignores them) until the region ends.  Large   */
+/* objects are allocated as by GC_malloc.  GC_region_end hands the      */
+/* blocks to the collector, or releases them at once if flags contain   */
+/* GC_REGION_RELEASE; the latter is only safe if no reference to any    */
+/* object of the region remains (including finalizers and disappearing  */
+/* links).  With GC_REGION_CHECK (or if GC_CHECK_REGIONS environment    */
+/* variable is set), a full collection is run before releasing to check */
+/* that; if some (conservatively) referenced object is found, or if the */
+/* collection is disabled, it is reported and the blocks are handed to  */
+/* the collector instead.                                               */
+typedef struct GC_region_s *GC_region_t;
+GC_API GC_region_t GC_CALL GC_region_begin(void);
+GC_API GC_ATTR_MALLOC GC_ATTR_ALLOC_SIZE(2) void * GC_CALL
+        GC_region_malloc(GC_region_t, size_t /* lb */);
+GC_API GC_ATTR_MALLOC GC_ATTR_ALLOC_SIZE(2) void * GC_CALL
+        GC_region_malloc_atomic(GC_region_t, size_t /* lb */);
+#define GC_REGION_RELEASE 1
+#define GC_REGION_CHECK 2
+GC_API void GC_CALL GC_region_end(GC_region_t, unsigned /* flags */);
+
 /* A filter function to control the scanning of dynamic libraries.      */
 /* If implemented, called by GC before registering a dynamic library    */
 /* (discovered by GC) section as a static data root (called only as     */
@@ -96,9 +96,32 @@ GC_API void GC_CALL GC_generic_malloc_many(size_t /* lb */, int /* k */,
                 } \
             } \
         } \
-        next = *(void **)(my_entry); \
-        result = (void *)my_entry; \
-        *my_fl = next; \
+        if (GC_EXPECT(((GC_word)my_entry & GC_SPAN_TAG) != 0, 0)) { \
+            /* Bump the pointer in a span, see gc_tiny_fl.h.    */ \
+            GC_word span_sz = GC_RAW_BYTES_FROM_INDEX((granules) == 0 ? 1 \
+                                                      : (granules)); \
+            result = (void *)((GC_word)my_entry \
+                              & ~(GC_word)(GC_SPAN_TAG | GC_SPAN_CLEAR)); \
+            if (((GC_word)my_entry & GC_SPAN_CLEAR) != 0) { \
+                /* Clear it granule by granule (2 words each). */ \
+                void **span_p = (void **)result; \
+                do { \
+                    span_p[0] = 0; \
+                    span_p[1] = 0; \
+                    span_p += 2; \
+                } while ((char *)span_p < (char *)result + span_sz); \
+            } \
+            next = (char *)result + span_sz; \
+            *my_fl = ((((GC_word)next + span_sz - 1) ^ (GC_word)result) \
+                      < GC_SPAN_BYTES) \
+                        ? (void *)((GC_word)next | ((GC_word)my_entry \
+                                     & (GC_SPAN_TAG | GC_SPAN_CLEAR))) \
+                        : (void *)0; \
+        } else { \
+            next = *(void **)(my_entry); \
+            result = (void *)my_entry; \
+            *my_fl = next; \
+        } \
         init; \
         PREFETCH_FOR_WRITE(next); \
         GC_ASSERT(GC_size(result) >= (granules)*GC_GRANULE_BYTES); \
@@ -192,6 +192,14 @@ GC_API unsigned GC_CALL GC_new_proc_inner(GC_mark_proc);
 GC_API GC_ATTR_MALLOC void * GC_CALL
         GC_generic_malloc(size_t /* lb */, int /* k */);
 
+/* The bulk version of GC_generic_malloc; see GC_malloc_bulk.  For the  */
+/* same reason, it should be used with care for kinds that keep the     */
+/* descriptor in the object.                                            */
+GC_API size_t GC_CALL GC_generic_malloc_bulk(size_t /* lb */, int /* k */,
+                                             size_t /* n */,
+                                             void ** /* result */)
+                                                        GC_ATTR_NONNULL(4);
+
 typedef void (GC_CALLBACK * GC_describe_type_fn)(void * /* p */,
                                                  char * /* out_buf */);
                                 /* A procedure which                    */
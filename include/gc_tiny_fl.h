@@ -87,4 +87,17 @@
 /* inverse of the above.                                        */
 #define GC_RAW_BYTES_FROM_INDEX(i) ((i) * GC_GRANULE_BYTES)
 
+/* A thread-local free list entry may also hold a "span" instead of a   */
+/* list: the address of the next object in a fresh heap block tagged    */
+/* with GC_SPAN_TAG.  The objects of a span are allocated by bumping    */
+/* the address until the end of the GC_SPAN_BYTES-aligned block, so     */
+/* that the block need not be threaded into a list in advance.  If      */
+/* GC_SPAN_CLEAR is also set then each object should be cleared when    */
+/* allocated.  Spans are only ever stored in the collector's own        */
+/* per-thread free lists (whose remaining objects it knows how to       */
+/* keep alive), never in client ones.                                   */
+#define GC_SPAN_TAG 1
+#define GC_SPAN_CLEAR 2
+#define GC_SPAN_BYTES 4096
+
 #endif /* GC_TINY_FL_H */
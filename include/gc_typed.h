@@ -88,6 +88,12 @@ GC_API GC_ATTR_MALLOC GC_ATTR_ALLOC_SIZE(1) void * GC_CALL
         GC_malloc_explicitly_typed_ignore_off_page(size_t /* size_in_bytes */,
                                                    GC_descr /* d */);
 
+GC_API size_t GC_CALL GC_malloc_explicitly_typed_bulk(size_t /* lb */,
+                                GC_descr /* d */, size_t /* n */,
+                                void ** /* result */) GC_ATTR_NONNULL(4);
+                /* Allocate n objects as GC_malloc_explicitly_typed     */
+                /* does, see GC_malloc_bulk.                            */
+
 GC_API GC_ATTR_MALLOC void * GC_CALL
         GC_calloc_explicitly_typed(size_t /* nelements */,
                                    size_t /* element_size_in_bytes */,
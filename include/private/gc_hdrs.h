@@ -116,7 +116,11 @@ typedef struct hce {
         }
 
 typedef struct bi {
+# ifdef FLAT_HDR_TABLE
+    hdr ** index;               /* BOTTOM_SZ entries of GC_flat_hdrs.   */
+# else
     hdr * index[BOTTOM_SZ];
+# endif
         /*
          * The bottom level index contains one of three kinds of values:
          * 0 means we're not responsible for this block,
@@ -193,6 +197,26 @@ typedef struct bi {
 # define HDR(p) GC_find_header((ptr_t)(p))
 #endif
 
+#ifdef FLAT_HDR_TABLE
+  /* All the headers are kept in GC_flat_hdrs, a sparse array indexed   */
+  /* directly by the block number, reserved at start-up and committed   */
+  /* by the OS on first write.  The bottom indices (still used to       */
+  /* enumerate the heap) just refer to slices of it.  Thus, looking a   */
+  /* header up is a single load (past a range check, as p may be an     */
+  /* arbitrary word in the mark phase).                                 */
+# define FLAT_HDR_ENTRIES ((word)1 << (FLAT_HDR_ADDR_BITS - LOG_HBLKSIZE))
+# define FLAT_HDR_INDEX(p) ((word)(p) >> LOG_HBLKSIZE)
+# undef HDR
+# undef GET_HDR
+# undef SET_HDR
+# undef GET_HDR_ADDR
+# define HDR(p) (EXPECT(FLAT_HDR_INDEX(p) < FLAT_HDR_ENTRIES, TRUE) \
+                 ? GC_flat_hdrs[FLAT_HDR_INDEX(p)] : (hdr *)0)
+# define GET_HDR(p, hhdr) (hhdr) = HDR(p)
+# define SET_HDR(p, hhdr) GC_flat_hdrs[FLAT_HDR_INDEX(p)] = (hhdr)
+# define GET_HDR_ADDR(p, ha) (ha) = GC_flat_hdrs + FLAT_HDR_INDEX(p)
+#endif /* FLAT_HDR_TABLE */
+
 /* Is the result a forwarding address to someplace closer to the        */
 /* beginning of the block or NULL?                                      */
 #define IS_FORWARDING_ADDR_OR_NIL(hhdr) ((size_t) (hhdr) <= MAX_JUMP)
@@ -140,20 +140,56 @@
 #    ifdef USE_PTHREAD_LOCKS
 #      include <pthread.h>
        GC_EXTERN pthread_mutex_t GC_allocate_ml;
+#      if defined(FINE_GRAINED_LOCKS) \
+          && (!defined(AO_HAVE_fetch_and_add_full) \
+              || !defined(AO_HAVE_nop_full) \
+              || !defined(AO_HAVE_store_release) \
+              || !defined(AO_HAVE_test_and_set_acquire))
+#        undef FINE_GRAINED_LOCKS
+#      endif
+#      ifdef FINE_GRAINED_LOCKS
+         /* A few allocation paths (see GC_enter_shared_alloc in        */
+         /* gc_priv.h) run without the allocation lock ("in the shared  */
+         /* mode"), holding finer locks instead.  The allocation lock    */
+         /* holder excludes them: it raises GC_shared_alloc_excluded,    */
+         /* then waits for those already running to leave.  The full     */
+         /* barrier guarantees that either it sees their increment of    */
+         /* GC_shared_allocators or they see the flag.                   */
+         GC_EXTERN volatile AO_t GC_shared_allocators;
+         GC_EXTERN volatile AO_t GC_shared_alloc_excluded;
+         GC_INNER void GC_wait_shared_alloc(void);
+#        define EXCLUDE_SHARED_ALLOC() \
+                { AO_store(&GC_shared_alloc_excluded, TRUE); \
+                  AO_nop_full(); \
+                  if (AO_load(&GC_shared_allocators) != 0) \
+                    GC_wait_shared_alloc(); }
+        /* The flag is cleared before the lock is released, so that it   */
+        /* is never cleared after being raised by the next lock holder.  */
+#        define ADMIT_SHARED_ALLOC() \
+                AO_store_release(&GC_shared_alloc_excluded, FALSE)
+#      else
+#        define EXCLUDE_SHARED_ALLOC() (void)0
+#        define ADMIT_SHARED_ALLOC() (void)0
+#      endif
 #      ifdef GC_ASSERTIONS
-#        define UNCOND_LOCK() { GC_lock(); SET_LOCK_HOLDER(); }
+#        define UNCOND_LOCK() \
+                { GC_lock(); EXCLUDE_SHARED_ALLOC(); SET_LOCK_HOLDER(); }
 #        define UNCOND_UNLOCK() \
                 { GC_ASSERT(I_HOLD_LOCK()); UNSET_LOCK_HOLDER(); \
+                  ADMIT_SHARED_ALLOC(); \
                   pthread_mutex_unlock(&GC_allocate_ml); }
 #      else /* !GC_ASSERTIONS */
 #        if defined(NO_PTHREAD_TRYLOCK)
-#          define UNCOND_LOCK() GC_lock()
+#          define UNCOND_LOCK() { GC_lock(); EXCLUDE_SHARED_ALLOC(); }
 #        else /* !defined(NO_PTHREAD_TRYLOCK) */
 #        define UNCOND_LOCK() \
            { if (0 != pthread_mutex_trylock(&GC_allocate_ml)) \
-               GC_lock(); }
+               GC_lock(); \
+             EXCLUDE_SHARED_ALLOC(); }
 #        endif
-#        define UNCOND_UNLOCK() pthread_mutex_unlock(&GC_allocate_ml)
+#        define UNCOND_UNLOCK() \
+                { ADMIT_SHARED_ALLOC(); \
+                  pthread_mutex_unlock(&GC_allocate_ml); }
 #      endif /* !GC_ASSERTIONS */
 #    endif /* USE_PTHREAD_LOCKS */
 #    define SET_LOCK_HOLDER() \
@@ -202,8 +202,13 @@ exit_label: ; \
 #endif /* !USE_MARK_BYTES */
 
 #ifdef PARALLEL_MARK
+  /* The markers only ensure hb_n_marks is nonzero, which is all that   */
+  /* GC_push_marked needs, rather than racing to increment it (in the   */
+  /* shared block header) for every object; it is recounted with        */
+  /* GC_count_hdr_marks by GC_reclaim_block.                            */
 # define INCR_MARKS(hhdr) \
-                AO_store(&hhdr->hb_n_marks, AO_load(&hhdr->hb_n_marks) + 1)
+        (void)(AO_load(&hhdr->hb_n_marks) != 0 \
+               || (AO_store(&hhdr->hb_n_marks, 1), FALSE))
 #else
 # define INCR_MARKS(hhdr) (void)(++hhdr->hb_n_marks)
 #endif
@@ -850,6 +850,14 @@ union word_ptr_ao_u {
 /* We maintain layout maps for heap blocks containing objects of a given */
 /* size.  Each entry in this map describes a byte offset and has the     */
 /* following type.                                                       */
+#ifdef REMOTE_FREE
+# include "atomic_ops.h"
+# if !defined(AO_HAVE_compare_and_swap_release) \
+     || !defined(AO_HAVE_compare_and_swap_full) || !defined(AO_HAVE_load) \
+     || !defined(AO_HAVE_fetch_and_add)
+#   undef REMOTE_FREE
+# endif
+#endif
 struct hblkhdr {
     struct hblk * hb_next;      /* Link field for hblk free list         */
                                 /* and for lists of chunks waiting to be */
@@ -879,6 +887,9 @@ struct hblkhdr {
                                 /* not.  Used to mark objects needed by */
                                 /* reclaim notifier.                    */
 #       endif
+#       define REGION_BLK 0x20 /* Block belongs to an active region,  */
+                                /* so it is not swept, and GC_free      */
+                                /* ignores the objects in it.           */
     unsigned short hb_last_reclaimed;
                                 /* Value of GC_gc_no when block was     */
                                 /* last allocated or swept. May wrap.   */
@@ -887,6 +898,11 @@ struct hblkhdr {
                                 /* when the header was allocated, or    */
                                 /* when the size of the block last      */
                                 /* changed.                             */
+#   ifdef REMOTE_FREE
+      unsigned short hb_owner;  /* Remote-free queue (index) of the     */
+                                /* thread whose local free lists were   */
+                                /* last refilled from the block, or 0.  */
+#   endif
     size_t hb_sz;  /* If in use, size in bytes, of objects in the block. */
                    /* if free, the size in bytes of the whole block      */
                    /* We assume that this is convertible to signed_word  */
@@ -907,24 +923,21 @@ struct hblkhdr {
 #   endif
     counter_t hb_n_marks;       /* Number of set mark bits, excluding   */
                                 /* the one always set at the end.       */
-                                /* Currently it is concurrently         */
-                                /* updated and hence only approximate.  */
-                                /* But a zero value does guarantee that */
-                                /* the block contains no marked         */
-                                /* objects.                             */
-                                /* Ensuring this property means that we */
-                                /* never decrement it to zero during a  */
-                                /* collection, and hence the count may  */
-                                /* be one too high.  Due to concurrent  */
-                                /* updates, an arbitrary number of      */
-                                /* increments, but not all of them (!)  */
-                                /* may be lost, hence it may in theory  */
-                                /* be much too low.                     */
-                                /* The count may also be too high if    */
-                                /* multiple mark threads mark the       */
-                                /* same object due to a race.           */
-                                /* Without parallel marking, the count  */
-                                /* is accurate.                         */
+                                /* With parallel marking, the markers   */
+                                /* only set it to 1 (if it is zero),    */
+                                /* and it is recounted exactly by       */
+                                /* GC_reclaim_block.  In between, only  */
+                                /* a zero value is meaningful: it does  */
+                                /* guarantee that the block contains no */
+                                /* marked objects.  Ensuring this       */
+                                /* property means that we never         */
+                                /* decrement it to zero during a        */
+                                /* collection.  Without parallel        */
+                                /* marking, the count is accurate,      */
+                                /* unless SIDE_MARK_BITS: it is not     */
+                                /* reset by GC_clear_marks then, so it  */
+                                /* is only an upper bound until it is   */
+                                /* recounted the same way.              */
 #   ifdef USE_MARK_BYTES
 #     define MARK_BITS_SZ (MARK_BITS_PER_HBLK + 1)
         /* Unlike the other case, this is in units of bytes.            */
@@ -932,6 +945,19 @@ struct hblkhdr {
         /* mark bit per 2 words.  But we do allocate and set one        */
         /* extra mark bit to avoid an explicit check for the            */
         /* partial object at the end of each block.                     */
+#   else
+#     define MARK_BITS_SZ (MARK_BITS_PER_HBLK/CPP_WORDSZ + 1)
+#   endif
+#   ifdef SIDE_MARK_BITS
+      /* The mark bits are in the side table of the heap section (see   */
+      /* GC_bind_side_marks), so that the marks of the consecutive      */
+      /* blocks are contiguous.  The layout is otherwise the same.      */
+#     ifdef USE_MARK_BYTES
+        char *hb_marks;
+#     else
+        word *hb_marks;
+#     endif
+#   elif defined(USE_MARK_BYTES)
       union {
         char _hb_marks[MARK_BITS_SZ];
                             /* The i'th byte is 1 if the object         */
@@ -944,9 +970,8 @@ struct hblkhdr {
       } _mark_byte_union;
 #     define hb_marks _mark_byte_union._hb_marks
 #   else
-#     define MARK_BITS_SZ (MARK_BITS_PER_HBLK/CPP_WORDSZ + 1)
       word hb_marks[MARK_BITS_SZ];
-#   endif /* !USE_MARK_BYTES */
+#   endif /* !USE_MARK_BYTES && !SIDE_MARK_BITS */
 };
 
 # define ANY_INDEX 23   /* "Random" mark bit index for assertions */
@@ -1019,6 +1044,9 @@ struct roots {
 #   define RT_SIZE (1 << LOG_RT_SIZE) /* Power of 2, may be != MAX_ROOT_SETS */
 #endif
 
+/* MAX_HEAP_SECTS bounds only the tables of raw memory regions (the    */
+/* Win32 heap bases and GC_our_memory); GC_heap_sects itself is grown   */
+/* on demand starting from INITIAL_HEAP_SECTS entries.                  */
 #ifndef MAX_HEAP_SECTS
 # ifdef LARGE_CONFIG
 #   if CPP_WORDSZ > 32
@@ -1035,6 +1063,10 @@ struct roots {
 # endif
 #endif /* !MAX_HEAP_SECTS */
 
+#ifndef INITIAL_HEAP_SECTS
+# define INITIAL_HEAP_SECTS 32
+#endif
+
 /* Lists of all heap blocks and free lists      */
 /* as well as other random data structures      */
 /* that should not be scanned by the            */
@@ -1054,6 +1086,22 @@ struct roots {
 /* of macros is defined when the client is      */
 /* compiled.                                    */
 
+/* Object kinds: */
+#define MAXOBJKINDS 16
+
+#ifndef SMALL_CONFIG
+  /* The statistics of an object kind and size class.   */
+  struct GC_class_stats_s {
+    word cs_bytes_allocd;       /* Since the last collection (including */
+                                /* the objects handed out to the        */
+                                /* thread-local free lists).            */
+    word cs_live_bytes;         /* The following are found by the sweep */
+                                /* start of the last collection.        */
+    word cs_blocks;
+    word cs_nearly_full_blocks; /* Not worth sweeping.                  */
+  };
+#endif
+
 struct _GC_arrays {
   word _heapsize;               /* Heap size in bytes.                  */
   word _requested_heapsize;     /* Heap size due to explicit expansion. */
@@ -1134,6 +1182,12 @@ struct _GC_arrays {
   size_t _size_map[MAXOBJBYTES+1];
         /* Number of granules to allocate when asked for a certain      */
         /* number of bytes.                                             */
+# ifndef SMALL_CONFIG
+#   define GC_class_stats GC_arrays._class_stats
+    struct GC_class_stats_s _class_stats[MAXOBJKINDS][MAXOBJGRANULES+1];
+                        /* Indexed by the kind and object size in       */
+                        /* granules, 0 for the large objects.           */
+# endif
 
 # ifdef STUBBORN_ALLOC
 #   define GC_sobjfreelist GC_arrays._sobjfreelist
@@ -1191,8 +1245,35 @@ struct _GC_arrays {
   struct HeapSect {
     ptr_t hs_start;
     size_t hs_bytes;
-  } _heap_sects[MAX_HEAP_SECTS];        /* Heap segments potentially    */
-                                        /* client objects.              */
+#   ifdef USE_NUMA
+      int hs_node;                      /* The node the memory of the   */
+                                        /* section is bound to.         */
+#   endif
+  } *_heap_sects;                       /* Heap segments potentially    */
+                                        /* client objects, sorted by    */
+                                        /* address (GC_n_heap_sects     */
+                                        /* entries are valid).          */
+# define GC_capacity_heap_sects GC_arrays._capacity_heap_sects
+  word _capacity_heap_sects;            /* Number of entries allocated  */
+                                        /* for GC_heap_sects.           */
+# ifdef SIDE_MARK_BITS
+#   define GC_mark_tables GC_arrays._mark_tables
+    struct MarkTable {
+      struct hblk *mt_start;
+      word mt_n_blocks;
+      word *mt_marks;                   /* The mark bits of the blocks, */
+                                        /* MARK_SLOT_WORDS per block.   */
+      unsigned short *mt_final;         /* FINAL_MARK_BIT of each       */
+                                        /* in-use block, or MT_FREE,    */
+                                        /* or MT_KEEP (uncollectable).  */
+    } *_mark_tables;                    /* The side mark tables (one    */
+                                        /* per GC_add_to_heap call),    */
+                                        /* sorted by address.           */
+#   define GC_n_mark_tables GC_arrays._n_mark_tables
+    word _n_mark_tables;
+#   define GC_capacity_mark_tables GC_arrays._capacity_mark_tables
+    word _capacity_mark_tables;
+# endif
 # if defined(USE_PROC_FOR_LIBRARIES)
 #   define GC_our_memory GC_arrays._our_memory
     struct HeapSect _our_memory[MAX_HEAP_SECTS];
@@ -1219,6 +1300,10 @@ struct _GC_arrays {
   /* Block header index; see gc_headers.h */
   bottom_index * _all_nils;
   bottom_index * _top_index [TOP_SZ];
+# ifdef FLAT_HDR_TABLE
+#   define GC_flat_hdrs GC_arrays._flat_hdrs
+    hdr ** _flat_hdrs;  /* FLAT_HDR_ENTRIES entries, see gc_hdrs.h.     */
+# endif
 # ifdef ENABLE_TRACE
 #   define GC_trace_addr GC_arrays._trace_addr
     ptr_t _trace_addr;
@@ -1265,8 +1350,6 @@ GC_API_PRIV GC_FAR struct _GC_arrays GC_arrays;
 #define endGC_arrays (((ptr_t)(&GC_arrays)) + (sizeof GC_arrays))
 #define USED_HEAP_SIZE (GC_heapsize - GC_large_free_bytes)
 
-/* Object kinds: */
-#define MAXOBJKINDS 16
 
 GC_EXTERN struct obj_kind {
    void **ok_freelist;  /* Array of free listheaders for this kind of object */
@@ -1339,6 +1422,12 @@ GC_EXTERN unsigned GC_n_kinds;
 GC_EXTERN word GC_n_heap_sects; /* Number of separately added heap      */
                                 /* sections.                            */
 
+GC_INNER word GC_heap_sect_index(ptr_t p);
+                        /* Return the index of the heap section       */
+                        /* containing p, or (if none) the index at    */
+                        /* which a section starting at p would be     */
+                        /* inserted.  Uses binary search.             */
+
 #ifdef USE_PROC_FOR_LIBRARIES
   GC_EXTERN word GC_n_memory;   /* Number of GET_MEM allocated memory   */
                                 /* sections.                            */
@@ -1586,6 +1675,40 @@ GC_INNER void GC_clear_hdr_marks(hdr * hhdr);
                                     /* Clear the mark bits in a header */
 GC_INNER void GC_set_hdr_marks(hdr * hhdr);
                                     /* Set the mark bits in a header */
+GC_EXTERN unsigned (*GC_count_hdr_marks)(const hdr * hhdr);
+                                    /* Count the set mark bits in a     */
+                                    /* header (excluding the one past   */
+                                    /* the end); not for uncollectable  */
+                                    /* blocks with USE_MARK_BITS.       */
+#ifdef SIMD_MARK_KERNELS
+  GC_INNER void GC_init_mark_kernels(void);
+                                    /* Choose the above according to    */
+                                    /* the CPU features.                */
+#endif
+#ifdef PREFETCH_FIFO
+# ifndef PREFETCH_FIFO_SIZE
+#   define PREFETCH_FIFO_SIZE 32    /* Entries, a power of 2.           */
+# endif
+# ifndef PREFETCH_FIFO_DEPTH
+#   define PREFETCH_FIFO_DEPTH 8    /* The default depth.               */
+# endif
+  GC_EXTERN unsigned GC_prefetch_fifo_depth;
+                                    /* The number of candidate pointers */
+                                    /* GC_mark_from keeps prefetched    */
+                                    /* before marking them (at most     */
+                                    /* PREFETCH_FIFO_SIZE - 1).         */
+#endif
+#ifdef SIDE_MARK_BITS
+  GC_INNER GC_bool GC_add_mark_table(struct hblk *h, size_t bytes);
+                                    /* Allocate the side mark table of  */
+                                    /* a chunk about to be added to the */
+                                    /* heap.  FALSE if out of memory.   */
+  GC_INNER void GC_bind_side_marks(hdr * hhdr, struct hblk *h);
+                                    /* Point hb_marks of the block in   */
+                                    /* use at its slot in the table.    */
+  GC_INNER void GC_release_side_marks(struct hblk *h);
+                                    /* Note that the block is free.     */
+#endif
 GC_INNER void GC_set_fl_marks(ptr_t p);
                                     /* Set all mark bits associated with */
                                     /* a free list.                      */
@@ -1699,16 +1822,51 @@ GC_INNER struct hblk * GC_allochblk(size_t size_in_bytes, int kind,
                                 /* the marker that block is valid       */
                                 /* for objects of indicated size.       */
 
+#if defined(THREAD_LOCAL_ALLOC) && !defined(NO_TL_HBLK_CACHE)
+  GC_INNER GC_bool GC_setup_hblk(struct hblk *h, size_t size_in_bytes,
+                                 int kind);
+                                /* Reinitialize the header of a single  */
+                                /* heap block, returned by GC_allochblk */
+                                /* but not used yet, for objects of the */
+                                /* indicated size and kind.  The lock   */
+                                /* is not needed if the caller owns the */
+                                /* block and the object map for the     */
+                                /* size already exists.                 */
+#endif
+
+#define HBLK_ALIGN_SHIFT 8
+#define HBLK_ALIGN_FLAGS(log_blocks) ((unsigned)(log_blocks) << HBLK_ALIGN_SHIFT)
+                        /* Request (in the flags of GC_alloc_large and  */
+                        /* GC_allochblk) the block to be aligned to     */
+                        /* HBLKSIZE << log_blocks bytes.                */
+#define HBLK_ALIGNMENT(flags) ((word)HBLKSIZE << ((flags) >> HBLK_ALIGN_SHIFT))
+
 GC_INNER ptr_t GC_alloc_large(size_t lb, int k, unsigned flags);
                         /* Allocate a large block of size lb bytes.     */
                         /* The block is not cleared.                    */
-                        /* Flags is 0 or IGNORE_OFF_PAGE.               */
+                        /* Flags is 0 or IGNORE_OFF_PAGE, optionally    */
+                        /* combined with HBLK_ALIGN_FLAGS.              */
                         /* Calls GC_allchblk to do the actual           */
                         /* allocation, but also triggers GC and/or      */
                         /* heap expansion as appropriate.               */
                         /* Does not update GC_bytes_allocd, but does    */
                         /* other accounting.                            */
 
+#ifdef USE_MREMAP_REALLOC
+  GC_INNER GC_bool GC_move_pages(ptr_t dest, ptr_t src, size_t bytes);
+                                /* Swap pages with mremap() instead of  */
+                                /* copying; defined in os_dep.c.        */
+  GC_EXTERN word GC_realloc_moved_bytes;
+                                /* Bytes moved that way by GC_realloc;  */
+                                /* defined in mallocx.c.                */
+#endif
+
+GC_INNER GC_bool GC_extend_hblk(struct hblk *h, size_t new_size);
+                                /* Grow the large object block h in     */
+                                /* place, taking the adjacent free      */
+                                /* block; new_size is a multiple of     */
+                                /* HBLKSIZE.  Does no other accounting. */
+
 GC_INNER void GC_freehblk(struct hblk * p);
                                 /* Deallocate a heap block and mark it  */
                                 /* as invalid.                          */
@@ -1787,12 +1945,25 @@ GC_INNER void * GC_generic_malloc_inner_ignore_off_page(size_t lb, int k);
                                 /* will always be a pointer to the      */
                                 /* beginning of the object while the    */
                                 /* object is live.                      */
+GC_INNER void * GC_generic_malloc_aligned(size_t lb, int k, size_t align);
+                                /* Allocate an object aligned to align  */
+                                /* (a power of two greater than         */
+                                /* GRANULE_BYTES) without padding it.   */
 
 GC_INNER ptr_t GC_allocobj(size_t sz, int kind);
                                 /* Make the indicated                   */
                                 /* free list nonempty, and return its   */
                                 /* head.  Sz is in granules.            */
 
+GC_EXTERN GC_bool GC_check_regions;
+                                /* Check that no references to the      */
+                                /* objects of a region remain when it   */
+                                /* is released (GC_CHECK_REGIONS).      */
+
+GC_INNER GC_bool GC_alloc_reclaim_list(struct obj_kind *kind);
+                                /* Allocate reclaim list for kind.      */
+                                /* Return TRUE on success.              */
+
 #ifdef GC_ADD_CALLER
 # define GC_DBG_RA GC_RETURN_ADDR,
 #else
@@ -1820,12 +1991,19 @@ GC_INNER ptr_t GC_allocobj(size_t sz, int kind);
 #ifdef THREAD_LOCAL_ALLOC
   GC_INNER void * GC_core_malloc(size_t);
   GC_INNER void * GC_core_malloc_atomic(size_t);
+  GC_INNER void * GC_core_malloc_uncollectable(size_t);
 # ifdef GC_GCJ_SUPPORT
     GC_INNER void * GC_core_gcj_malloc(size_t, void *);
 # endif
 #endif /* THREAD_LOCAL_ALLOC */
 
 GC_INNER void GC_init_headers(void);
+#ifdef FLAT_HDR_TABLE
+  GC_INNER ptr_t GC_unix_reserve_mem(word bytes);
+                                /* Reserve zero-filled memory which is  */
+                                /* committed lazily by the OS.  Return  */
+                                /* 0 on failure.                        */
+#endif
 GC_INNER struct hblkhdr * GC_install_header(struct hblk *h);
                                 /* Install a header for block h.        */
                                 /* Return 0 on failure, or the header   */
@@ -2058,6 +2236,70 @@ GC_EXTERN signed_word GC_bytes_found;
 #ifdef USE_MUNMAP
   GC_EXTERN int GC_unmap_threshold; /* defined in allchblk.c */
   GC_EXTERN GC_bool GC_force_unmap_on_gcollect; /* defined in misc.c */
+
+  /* Defined in allchblk.c.     */
+  GC_EXTERN word GC_scavenge_no;
+                        /* Number of passes of the background scavenger. */
+  GC_EXTERN word GC_scavenged_bytes;
+                        /* Bytes returned to OS by the scavenger.       */
+# define GC_UNMAP_CLOCK() ((unsigned short)(GC_gc_no + GC_scavenge_no))
+                        /* The age of a free block (stored in its       */
+                        /* hb_last_reclaimed) is measured in both the   */
+                        /* collections and the scavenger passes.        */
+  GC_INNER void GC_scavenge(unsigned age, word target_rss);
+                        /* Unmap free blocks older than age while the   */
+                        /* resident set size is above target_rss.       */
+                        /* Called by the scavenger with the lock held.  */
+
+  GC_INNER word GC_get_rss(void);       /* defined in os_dep.c */
+
+# ifdef USE_MADVISE_UNMAP
+    GC_EXTERN GC_bool GC_madv_free;     /* Use MADV_FREE if available;  */
+                                        /* defined in os_dep.c.         */
+# endif
+
+# if defined(GC_PTHREADS) && !defined(GC_WIN32_THREADS) \
+     && !defined(GC_RTEMS_PTHREADS)
+#   define CAN_START_SCAVENGER
+    GC_INNER int GC_start_scavenger_inner(unsigned interval_ms,
+                                          unsigned age, word target_rss);
+                        /* Start the scavenger thread or update its     */
+                        /* parameters; defined in pthread_support.c.    */
+    GC_EXTERN volatile GC_bool GC_scavenge_requested;
+    GC_INNER void GC_requested_scavenge(void);
+                        /* Do the scavenger pass requested while the    */
+                        /* allocation lock was not in use.              */
+# endif
+#endif
+
+#ifdef USE_HUGE_PAGES
+  GC_EXTERN int GC_huge_pages;  /* Huge page mode: 0 - off, 1 - THP,    */
+                                /* 2 - try MAP_HUGETLB first; defined   */
+                                /* in os_dep.c.                         */
+# define HEAP_SECT_GRANULE \
+                (GC_huge_pages != 0 ? (word)HUGE_PAGE_SIZE : GC_page_size)
+#else
+# define HEAP_SECT_GRANULE GC_page_size
+#endif
+                        /* Heap sections are multiples of this, and are */
+                        /* aligned to it; pages are unmapped in units   */
+                        /* of it, so as not to break huge pages up.     */
+
+#ifdef USE_NUMA
+  /* Defined in os_dep.c.       */
+  GC_EXTERN int GC_numa_nodes;  /* Number of NUMA nodes; 1 if the NUMA  */
+                                /* mode is off.                         */
+  GC_INNER void GC_numa_init(void);
+  GC_INNER int GC_numa_current_node(void);
+                                /* The node of the CPU the current      */
+                                /* thread runs on.                      */
+  GC_INNER void GC_numa_bind(ptr_t start, size_t bytes, int node);
+                                /* Prefer node for the pages of memory. */
+
+  GC_INNER int GC_numa_node_of(ptr_t p);
+                                /* The node of the heap section         */
+                                /* containing p, or -1 if p is not in   */
+                                /* the heap; defined in alloc.c.        */
 #endif
 
 #ifdef MSWIN32
@@ -2092,6 +2334,135 @@ GC_EXTERN signed_word GC_bytes_found;
 #ifdef THREAD_LOCAL_ALLOC
   GC_EXTERN GC_bool GC_world_stopped; /* defined in alloc.c */
   GC_INNER void GC_mark_thread_local_free_lists(void);
+
+  /* Defined in thread_local_alloc.c.   */
+  GC_EXTERN size_t GC_tl_refill_min;
+  GC_EXTERN size_t GC_tl_refill_max;
+                /* Bounds of the refill batch of the thread-local free  */
+                /* lists (in bytes).                                    */
+  GC_EXTERN word GC_tl_locked_refills;
+                /* Number of the thread-local free list refills which   */
+                /* acquired the allocation lock.                        */
+  GC_EXTERN word GC_tl_lockless_refills;
+                /* Number of the other ones (from the cached blocks or  */
+                /* in the shared mode, see FINE_GRAINED_LOCKS).         */
+  GC_EXTERN word GC_tl_stranded_bytes;
+                /* Bytes held by the thread-local free lists at the     */
+                /* recent marking.                                      */
+  GC_INNER size_t GC_tl_refill_bytes(void **result);
+                /* Return the number of bytes GC_generic_malloc_many    */
+                /* should put to result if it is a free list of the     */
+                /* current thread, adjusting the batch of the list to   */
+                /* its refill frequency; return 0 otherwise.            */
+# ifdef REMOTE_FREE
+    /* Defined in thread_local_alloc.c.                                 */
+    GC_INNER GC_bool GC_remote_free(void *p, hdr *hhdr);
+                /* Push the small object p (being deallocated) to the   */
+                /* remote-free queue of the owner of its block, without */
+                /* the lock.  Return FALSE if the block has no owner,   */
+                /* the kind is not supported or the queue is full.      */
+    GC_INNER unsigned short GC_tl_remote_slot(void);
+                /* The queue index of the current thread, or 0.         */
+    GC_INNER GC_bool GC_tl_remote_drain(unsigned short slot, size_t lb,
+                                        int k, void **result);
+                /* Move the objects of size lb and kind k from the      */
+                /* given queue (of the current thread) to the empty     */
+                /* thread-local free list result, without the lock.     */
+                /* Return FALSE if there are none.                      */
+    GC_INNER void GC_tl_remote_flush(unsigned short slot);
+                /* Return the objects of the queue left by the above    */
+                /* to the global free lists.  Acquires the lock (or     */
+                /* enters the shared mode, see FINE_GRAINED_LOCKS) if   */
+                /* there are any.                                       */
+# endif
+# ifdef PER_CPU_ALLOC
+    GC_EXTERN GC_bool GC_no_per_cpu_alloc;
+                /* Do not use the per-CPU free lists (set in GC_init).  */
+# endif
+# if CPP_HBLKSIZE == GC_SPAN_BYTES && !defined(NO_ALLOC_SPANS)
+#   define USE_ALLOC_SPANS
+    /* Defined in thread_local_alloc.c.                                 */
+    GC_INNER ptr_t GC_tl_build_fl(struct hblk *h, size_t words,
+                                  GC_bool clear, void **result);
+                /* Same as GC_build_fl(h, words, clear, 0)              */
+                /* unless result is a free list of the current thread,  */
+                /* in which case a span (see gc_tiny_fl.h) covering     */
+                /* the whole (fresh) block is returned instead.         */
+# endif
+# ifndef NO_TL_HBLK_CACHE
+    GC_INNER void GC_flush_thread_local_hblks(void);
+                /* Return the empty heap blocks cached by all threads   */
+                /* to the global free lists.  Called with the lock      */
+                /* held, before the world is stopped for marking.       */
+
+    /* Defined in thread_local_alloc.c.                                 */
+    GC_INNER struct hblk * GC_tl_allochblk(size_t lb, int k);
+                /* Same as GC_allochblk(lb, k, 0) for small lb but      */
+                /* takes the block from the cache of the current        */
+                /* thread (refilling it in a batch if needed).          */
+    GC_INNER GC_bool GC_tl_hblk_malloc_many(size_t lb, int k,
+                                            void **result);
+                /* Try to build a free list of objects of size lb and   */
+                /* kind k (as GC_generic_malloc_many does) in a block   */
+                /* taken from the cache of the current thread without   */
+                /* acquiring the allocation lock.  Return FALSE (and    */
+                /* leave *result intact) if this is not possible.       */
+# endif
+#endif
+
+#ifdef FINE_GRAINED_LOCKS
+  /* Defined in pthread_support.c.  The threads allocating or           */
+  /* deallocating in the shared mode (i.e. without the allocation       */
+  /* lock, but between GC_enter_shared_alloc and GC_leave_shared_alloc) */
+  /* access the free and reclaim lists of a size class of a kind only   */
+  /* holding its lock, and the block allocator only holding             */
+  /* GC_hblk_lock (acquired after the former if both are needed).  The  */
+  /* counters are then updated atomically.  The allocation lock holder  */
+  /* does not need these locks, as it excludes the shared mode.         */
+  GC_EXTERN volatile AO_TS_t GC_fl_locks[MAXOBJKINDS][MAXOBJGRANULES+1];
+  GC_EXTERN volatile AO_TS_t GC_hblk_lock;
+  GC_INNER void GC_spin_lock_wait(volatile AO_TS_t *lock);
+                /* Acquire the spin lock, pausing or yielding between   */
+                /* attempts.                                            */
+# define SPIN_LOCK(lock) \
+        { if (AO_test_and_set_acquire(lock) == AO_TS_SET) \
+            GC_spin_lock_wait(lock); }
+# define FL_LOCK(k, lg) SPIN_LOCK(&GC_fl_locks[k][lg])
+# define FL_UNLOCK(k, lg) AO_CLEAR(&GC_fl_locks[k][lg])
+# ifdef GC_ASSERTIONS
+    GC_EXTERN unsigned long GC_hblk_lock_holder;
+#   define HBLK_LOCK() \
+        { SPIN_LOCK(&GC_hblk_lock); \
+          GC_hblk_lock_holder = NUMERIC_THREAD_ID(pthread_self()); }
+#   define HBLK_UNLOCK() \
+        { GC_hblk_lock_holder = NO_THREAD; AO_CLEAR(&GC_hblk_lock); }
+#   define I_HOLD_HBLK_LOCK() \
+        (GC_hblk_lock_holder == NUMERIC_THREAD_ID(pthread_self()))
+# else
+#   define HBLK_LOCK() SPIN_LOCK(&GC_hblk_lock)
+#   define HBLK_UNLOCK() AO_CLEAR(&GC_hblk_lock)
+# endif
+# define SHARED_COUNT_ADD(cnt, n) \
+        (void)AO_fetch_and_add((volatile AO_t *)&(cnt), (AO_t)(n))
+
+  /* Enter the shared mode unless the allocation lock is held (or being */
+  /* acquired) by another thread, or is not needed at all.  Return      */
+  /* FALSE in that case; the caller should acquire the lock instead.    */
+  GC_INLINE GC_bool GC_enter_shared_alloc(void)
+  {
+    if (!GC_need_to_lock) return FALSE;
+    (void)AO_fetch_and_add_full(&GC_shared_allocators, 1);
+    if (EXPECT(!AO_load(&GC_shared_alloc_excluded), TRUE)) return TRUE;
+    (void)AO_fetch_and_add_full(&GC_shared_allocators, (AO_t)(-1));
+    return FALSE;
+  }
+
+# define GC_leave_shared_alloc() \
+        (void)AO_fetch_and_add_full(&GC_shared_allocators, (AO_t)(-1))
+#else
+# define FL_LOCK(k, lg) (void)0
+# define FL_UNLOCK(k, lg) (void)0
+# define SHARED_COUNT_ADD(cnt, n) (void)((cnt) += (n))
 #endif
 
 #ifdef GC_GCJ_SUPPORT
@@ -2116,6 +2487,66 @@ GC_INNER void GC_default_print_heap_obj_proc(ptr_t p);
 
 GC_INNER void GC_extend_size_map(size_t); /* in misc.c */
 
+#define MAX_SIZE_CLASSES 64 /* Max length of the GC_set_size_classes() */
+                            /* table.                                   */
+
+GC_EXTERN word *GC_size_histogram;
+                /* Counts of the small object requests by size (in      */
+                /* bytes) if size profiling is on, NULL otherwise;      */
+                /* protected by the allocation lock; defined in misc.c. */
+/* Count n bytes allocated as objects of kind k and lg granules (0 for  */
+/* a large object).  Called with the lock held except when building the */
+/* free lists in parallel or from the thread-local blocks, so the       */
+/* counts are approximate, as is GC_bytes_found.                        */
+#ifndef SMALL_CONFIG
+# define GC_CLASS_ALLOCD(k, lg, n) \
+        (void)(GC_class_stats[k][lg].cs_bytes_allocd += (word)(n))
+#else
+# define GC_CLASS_ALLOCD(k, lg, n) (void)0
+#endif
+
+#define GC_RECORD_SIZE(lb) \
+        (void)(EXPECT(GC_size_histogram != NULL, FALSE) \
+                ? ++GC_size_histogram[lb] : 0)
+
+#ifdef HEAP_PROFILE
+  GC_EXTERN signed_word GC_heap_sample_countdown;
+                /* Bytes to be allocated (through the global free lists */
+                /* and GC_generic_malloc) before the next sample of the */
+                /* heap profiler; protected by the allocation lock.     */
+
+  GC_INNER signed_word GC_next_heap_sample(void);
+                /* Draw the next (exponentially distributed) sampling   */
+                /* distance.  Called with the lock held.                */
+
+  GC_INNER void GC_sample_alloc(void *op, size_t lb,
+                                signed_word *countdown);
+                /* Record the stack of the sampled allocation of op     */
+                /* (lb bytes) and reset *countdown (unless NULL).       */
+                /* Called without the lock.                             */
+
+  GC_INNER void GC_heap_profile_update_live(void);
+                /* Drop the samples which were not marked by the last   */
+                /* collection.  Called with the lock held before the    */
+                /* mark bits are cleared.                               */
+
+  /* Release the lock taken to allocate op, sampling the allocation if  */
+  /* the countdown expires.                                             */
+# define UNLOCK_AND_SAMPLE(op, lb) \
+        do { \
+          if (EXPECT((GC_heap_sample_countdown -= (signed_word)(lb)) < 0, \
+                     FALSE)) { \
+            GC_heap_sample_countdown = GC_next_heap_sample(); \
+            UNLOCK(); \
+            GC_sample_alloc(op, lb, NULL); \
+          } else { \
+            UNLOCK(); \
+          } \
+        } while (0)
+#else
+# define UNLOCK_AND_SAMPLE(op, lb) UNLOCK()
+#endif /* !HEAP_PROFILE */
+
 GC_INNER void GC_setpagesize(void);
 
 GC_INNER void GC_initialize_offsets(void);      /* defined in obj_map.c */
@@ -2249,6 +2680,10 @@ GC_INNER ptr_t GC_store_debug_info(ptr_t p, word sz, const char *str,
 # define GC_markers_m1 GC_parallel
                         /* Number of mark threads we would like to have */
                         /* excluding the initiating thread.             */
+  GC_EXTERN int GC_max_markers_m1;
+                        /* Size of the marker pool (excluding the       */
+                        /* initiating thread); GC_markers_m1 may be     */
+                        /* changed at runtime up to this value.         */
 
   /* The mark lock and condition variable.  If the GC lock is also      */
   /* acquired, the GC lock must be acquired first.  The mark lock is    */
@@ -2270,6 +2705,19 @@ GC_INNER ptr_t GC_store_debug_info(ptr_t p, word sz, const char *str,
 
   GC_INNER void GC_notify_all_marker(void);
   GC_INNER void GC_wait_marker(void);
+  GC_INNER void GC_marker_yield(void);
+                        /* Give up the processor for a while; used by   */
+                        /* the idle markers polling for work to steal.  */
+# ifdef MARKER_FUTEX
+    GC_INNER void GC_park_marker(void);
+                        /* Same as GC_wait_marker() but for the helpers */
+                        /* waiting for a mark phase to start.           */
+    GC_INNER void GC_notify_all_helpers(void);
+                        /* Wake up those; the mark lock is held.        */
+# else
+#   define GC_park_marker() GC_wait_marker()
+#   define GC_notify_all_helpers() GC_notify_all_marker()
+# endif
   GC_EXTERN word GC_mark_no;            /* Protected by mark lock.      */
 
   GC_INNER void GC_help_marker(word my_mark_no);
@@ -2338,12 +2338,116 @@
     /* We tried ...                                             */
 #endif
 
+#ifdef USE_HUGE_PAGES
+# if !defined(LINUX)
+    /* Only implemented on top of mmap() and madvise() for Linux.       */
+#   undef USE_HUGE_PAGES
+# else
+#   ifndef USE_MMAP
+#     define USE_MMAP
+#   endif
+#   ifndef HUGE_PAGE_SIZE
+#     define HUGE_PAGE_SIZE 0x200000 /* 2 MiB (x86_64, AArch64 w/ 4K) */
+#   endif
+# endif
+#endif /* USE_HUGE_PAGES */
+
+#ifdef USE_NUMA
+# if !defined(LINUX)
+    /* Only implemented on top of sched_getcpu() and mbind().           */
+#   undef USE_NUMA
+# elif !defined(MAX_NUMA_NODES)
+#   define MAX_NUMA_NODES CPP_WORDSZ /* bits in a node mask word */
+# endif
+#endif /* USE_NUMA */
+
+#ifdef PER_CPU_ALLOC
+# if !defined(LINUX) || !defined(X86_64) || !defined(THREAD_LOCAL_ALLOC) \
+     || !defined(__GNUC__) || !defined(__GLIBC__) \
+     || __GLIBC__ < 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ < 35)
+    /* The critical sections are written in x86_64 assembly, and use    */
+    /* the rseq area registered by glibc (2.35+) for every thread.      */
+#   undef PER_CPU_ALLOC
+# endif
+#endif /* PER_CPU_ALLOC */
+
+#if defined(THREAD_LOCAL_ALLOC) && !defined(NO_REMOTE_FREE) \
+    && !defined(REMOTE_FREE)
+# define REMOTE_FREE
+#endif
+
+#if defined(THREAD_LOCAL_ALLOC) && defined(GC_PTHREADS) \
+    && !defined(GC_WIN32_THREADS) && !defined(NO_FINE_GRAINED_LOCKS)
+  /* The allocation slow path holds the locks of the size class and of  */
+  /* the block allocator instead of the allocation one (see gc_locks.h).*/
+# ifndef FINE_GRAINED_LOCKS
+#   define FINE_GRAINED_LOCKS
+# endif
+#else
+# undef FINE_GRAINED_LOCKS
+#endif
+
+#if (defined(X86_64) || defined(I386)) && !defined(NO_SIMD_MARK_KERNELS) \
+    && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9) \
+        || defined(__clang__)) && !defined(SIMD_MARK_KERNELS)
+  /* The mark bits are counted with SSE2/AVX2 or popcnt, if supported   */
+  /* by the CPU (detected at runtime).                                  */
+# define SIMD_MARK_KERNELS
+#endif
+
+#if defined(PARALLEL_MARK) && defined(GC_LINUX_THREADS) \
+    && !defined(NO_MARKER_FUTEX) && !defined(MARKER_FUTEX)
+  /* The idle marker threads park on futexes (see pthread_support.c).  */
+# define MARKER_FUTEX
+#endif
+
+#if !defined(SMALL_CONFIG) && !defined(NO_PREFETCH_FIFO) \
+    && !defined(PREFETCH_FIFO)
+  /* GC_mark_from marks the candidate pointers through a small FIFO, so */
+  /* that they are prefetched well before (see mark.c).                 */
+# define PREFETCH_FIFO
+#endif
+
+#ifdef USE_MADVISE_UNMAP
+# if defined(MSWIN32) || defined(MSWINCE) || defined(CYGWIN32)
+#   undef USE_MADVISE_UNMAP
+# else
+    /* Free blocks are returned to the OS by madvise() instead of being */
+    /* remapped with PROT_NONE.                                         */
+#   ifndef USE_MUNMAP
+#     define USE_MUNMAP
+#   endif
+#   ifndef USE_MMAP
+#     define USE_MMAP
+#   endif
+# endif
+#endif /* USE_MADVISE_UNMAP */
+
+#ifdef FLAT_HDR_TABLE
+# if CPP_WORDSZ != 64 || !(defined(LINUX) || defined(FREEBSD) \
+                           || defined(SOLARIS))
+    /* Relies on a huge lazily committed anonymous mapping.             */
+#   undef FLAT_HDR_TABLE
+# elif !defined(FLAT_HDR_ADDR_BITS)
+#   if defined(AARCH64)
+#     define FLAT_HDR_ADDR_BITS 48
+#   else
+#     define FLAT_HDR_ADDR_BITS 47 /* user space part of x86_64 */
+#   endif
+# endif
+#endif /* FLAT_HDR_TABLE */
+
 #if defined(LINUX) && defined(USE_MMAP)
     /* The kernel may do a somewhat better job merging mappings etc.    */
     /* with anonymous mappings.                                         */
 #   define USE_MMAP_ANON
 #endif
 
+#if defined(USE_MREMAP_REALLOC) && !(defined(LINUX) && defined(USE_MMAP))
+    /* The pages of the heap are swapped with mremap().  */
+#   undef USE_MREMAP_REALLOC
+#endif
+
 #if defined(GC_LINUX_THREADS) && defined(REDIRECT_MALLOC) \
     && !defined(USE_PROC_FOR_LIBRARIES)
     /* Nptl allocates thread stacks with mmap, which is fine.  But it   */
@@ -2746,6 +2850,16 @@
 # define NEED_CALLINFO
 #endif
 
+/* The sampling heap profiler (opt-in, as it adds a countdown to the    */
+/* allocation fast paths) records the allocation stacks with            */
+/* backtrace(), which may call malloc and thus cannot be used if the    */
+/* latter is redirected to the collector.                               */
+#if defined(HEAP_PROFILE) && (!defined(GC_HAVE_BUILTIN_BACKTRACE) \
+        || defined(_MSC_VER) || defined(REDIRECT_MALLOC) \
+        || defined(SMALL_CONFIG))
+# undef HEAP_PROFILE
+#endif
+
 #if defined(MAKE_BACK_GRAPH) && !defined(DBG_HDRS_ALL)
 # define DBG_HDRS_ALL
 #endif
@@ -65,6 +65,30 @@
 
 #include <stdlib.h>
 
+#ifndef NO_TL_HBLK_CACHE
+# ifndef TL_HBLK_CACHE_SZ
+#   define TL_HBLK_CACHE_SZ 8   /* Number of empty heap blocks a thread */
+                                /* may keep for its own use.            */
+# endif
+# include "atomic_ops.h"
+# if defined(AO_HAVE_fetch_and_add_full) && defined(AO_HAVE_nop_full)
+    /* Blocks could be taken from the cache (and set up for objects)    */
+    /* without the allocation lock.                                     */
+#   define LOCK_FREE_HBLK_CACHE
+# endif
+#endif
+
+#ifdef GC_GCJ_SUPPORT
+# define TL_GCJ_FREELISTS 1
+#else
+# define TL_GCJ_FREELISTS 0
+#endif
+#ifdef ENABLE_DISCLAIM
+# define TL_FINALIZED_FREELISTS 1
+#else
+# define TL_FINALIZED_FREELISTS 0
+#endif
+
 /* One of these should be declared as the tlfs field in the     */
 /* structure pointed to by a GC_thread.                         */
 typedef struct thread_local_freelists {
@@ -79,6 +103,10 @@ typedef struct thread_local_freelists {
 # ifdef ENABLE_DISCLAIM
     void * finalized_freelists[TINY_FREELISTS];
 # endif
+  void * uncollectable_freelists[TINY_FREELISTS];
+        /* Counted in GC_non_gc_bytes when refilled.            */
+  void * typed_freelists[TINY_FREELISTS];
+        /* For GC_malloc_explicitly_typed.                      */
   /* Free lists contain either a pointer or a small count       */
   /* reflecting the number of granules allocated at that        */
   /* size.                                                      */
@@ -93,8 +121,60 @@ typedef struct thread_local_freelists {
 # define DIRECT_GRANULES (HBLKSIZE/GRANULE_BYTES)
         /* Don't use local free lists for up to this much       */
         /* allocation.                                          */
+# ifndef NO_TL_HBLK_CACHE
+    struct hblk * hblk_cache[TL_HBLK_CACHE_SZ];
+        /* Empty heap blocks taken from the global free lists   */
+        /* in a batch, and not yet used for objects.  They are  */
+        /* returned at the beginning of each collection.        */
+    unsigned hblk_cache_cnt;
+    word hblk_bytes_allocd;
+        /* Bytes allocated from the cached blocks, not yet      */
+        /* added to GC_bytes_allocd.                            */
+    word hblk_refills;
+        /* Free lists refilled from the cached blocks without   */
+        /* the lock, not yet added to GC_tl_lockless_refills.   */
+# endif
+# define TL_FREELIST_KINDS (4 + TL_GCJ_FREELISTS + TL_FINALIZED_FREELISTS)
+        /* Number of the free list arrays above; they are       */
+        /* contiguous and start the structure.                  */
+  unsigned char refill_log[TL_FREELIST_KINDS * TINY_FREELISTS];
+        /* Refill batch of each free list, as the binary        */
+        /* logarithm of its size in quarters of a heap block.   */
+  unsigned char refill_count[TL_FREELIST_KINDS * TINY_FREELISTS];
+        /* Number of the refills of each free list since the    */
+        /* collection recorded in refill_gc_no (saturated).     */
+  word refill_gc_no;
+        /* GC_gc_no when the batches were last adjusted by the  */
+        /* collector (see GC_mark_thread_local_fls_for).        */
+# ifdef HEAP_PROFILE
+    signed_word sample_countdown;
+        /* Bytes to be allocated from the free lists above      */
+        /* before the next heap profiler sample.                */
+# endif
+# ifdef REMOTE_FREE
+    unsigned short remote_slot;
+        /* Index of the remote-free queue of the thread (owning */
+        /* the blocks its free lists are refilled from), or 0.  */
+# endif
+# ifdef PER_CPU_ALLOC
+    void * cpu_refill;
+        /* A fresh list for a per-CPU free list, held here (and */
+        /* thus marked) until it is published on the latter.    */
+# endif
 } *GC_tlfs;
 
+#ifdef HEAP_PROFILE
+  /* Count lb bytes of the object op allocated from the thread-local    */
+  /* free lists against the sampling countdown of the thread.           */
+# define GC_TL_SAMPLE(tsd, op, lb) \
+        (void)(EXPECT((((GC_tlfs)(tsd)) -> sample_countdown \
+                        -= (signed_word)(lb)) < 0, FALSE) \
+                ? (GC_sample_alloc(op, lb, \
+                        &((GC_tlfs)(tsd)) -> sample_countdown), 0) : 0)
+#else
+# define GC_TL_SAMPLE(tsd, op, lb) (void)0
+#endif
+
 #if defined(USE_PTHREAD_SPECIFIC)
 # define GC_getspecific pthread_getspecific
 # define GC_setspecific pthread_setspecific
@@ -140,15 +220,45 @@ GC_INNER void GC_init_thread_local(GC_tlfs p);
 /* We hold the allocator lock.                          */
 GC_INNER void GC_destroy_thread_local(GC_tlfs p);
 
+#ifndef NO_TL_HBLK_CACHE
+  /* Return the heap blocks cached in p to the global free lists.       */
+  /* We hold the allocator lock, and the owner of p does not use the    */
+  /* cache concurrently.                                                */
+  GC_INNER void GC_flush_tl_hblk_cache(GC_tlfs p);
+
+# ifdef LOCK_FREE_HBLK_CACHE
+    GC_EXTERN volatile AO_t GC_tl_hblk_users;
+                /* Number of threads using their cache without the      */
+                /* allocation lock.                                     */
+    GC_EXTERN volatile AO_t GC_tl_hblk_flushing;
+                /* Nonzero while the caches are being flushed; no       */
+                /* thread may then start using its cache without lock.  */
+# endif
+#endif
+
 /* The thread support layer must arrange to mark thread-local   */
 /* free lists explicitly, since the link field is often         */
 /* invisible to the marker.  It knows how to find all threads;  */
 /* we take care of an individual thread freelist structure.     */
 GC_INNER void GC_mark_thread_local_fls_for(GC_tlfs p);
 
+#ifdef REMOTE_FREE
+  /* Same as above for the remote-free queues (of all threads).         */
+  /* The queues of the exited threads are emptied instead (the objects  */
+  /* are reclaimed by the collector).                                   */
+  GC_INNER void GC_mark_remote_free_queues(void);
+#endif
+
+#ifdef PER_CPU_ALLOC
+  /* Same as above for the free lists of all CPUs.  Called with the     */
+  /* world stopped (thus no thread is inside its critical section).     */
+  GC_INNER void GC_mark_cpu_freelists(void);
+#endif
+
 #ifdef ENABLE_DISCLAIM
   GC_EXTERN ptr_t * GC_finalized_objfreelist;
 #endif
+GC_EXTERN ptr_t * GC_eobjfreelist;
 
 extern
 #if defined(USE_COMPILER_TLS)
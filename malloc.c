@@ -20,7 +20,7 @@
 
 /* Allocate reclaim list for kind:      */
 /* Return TRUE on success               */
-STATIC GC_bool GC_alloc_reclaim_list(struct obj_kind *kind)
+GC_INNER GC_bool GC_alloc_reclaim_list(struct obj_kind *kind)
 {
     struct hblk ** result = (struct hblk **)
                 GC_scratch_alloc((MAXOBJGRANULES+1) * sizeof(struct hblk *));
@@ -36,7 +36,8 @@ GC_INNER GC_bool GC_collect_or_expand(word needed_blocks,
 
 /* Allocate a large block of size lb bytes.     */
 /* The block is not cleared.                    */
-/* Flags is 0 or IGNORE_OFF_PAGE.               */
+/* Flags is 0 or IGNORE_OFF_PAGE, optionally    */
+/* combined with HBLK_ALIGN_FLAGS.              */
 /* We hold the allocation lock.                 */
 /* EXTRA_BYTES were already added to lb.        */
 GC_INNER ptr_t GC_alloc_large(size_t lb, int k, unsigned flags)
@@ -60,14 +61,23 @@ GC_INNER ptr_t GC_alloc_large(size_t lb, int k, unsigned flags)
             h = GC_allochblk(lb, k, flags);
         }
 #   endif
-    while (0 == h && GC_collect_or_expand(n_blocks, flags != 0, retry)) {
+    if (0 == h && HBLK_ALIGNMENT(flags) > HBLKSIZE) {
+      /* Expand the heap enough to contain an aligned block for sure.   */
+      n_blocks += divHBLKSZ(HBLK_ALIGNMENT(flags)) - 1;
+    }
+    while (0 == h && GC_collect_or_expand(n_blocks,
+                                          (flags & IGNORE_OFF_PAGE) != 0,
+                                          retry)) {
         h = GC_allochblk(lb, k, flags);
         retry = TRUE;
     }
     if (h == 0) {
         result = 0;
     } else {
-        size_t total_bytes = n_blocks * HBLKSIZE;
+        size_t total_bytes;
+
+        n_blocks = OBJ_SZ_TO_BLOCKS(lb);
+        total_bytes = n_blocks * HBLKSIZE;
         if (n_blocks > 1) {
             GC_large_allocd_bytes += total_bytes;
             if (GC_large_allocd_bytes > GC_max_large_allocd_bytes)
@@ -138,9 +148,11 @@ GC_INNER void * GC_generic_malloc_inner(size_t lb, int k)
         *opp = obj_link(op);
         obj_link(op) = 0;
         GC_bytes_allocd += GRANULES_TO_BYTES(lg);
+        GC_CLASS_ALLOCD(k, lg, GRANULES_TO_BYTES(lg));
     } else {
         op = (ptr_t)GC_alloc_large_and_clear(ADD_SLOP(lb), k, 0);
         GC_bytes_allocd += lb;
+        GC_CLASS_ALLOCD(k, 0, lb);
     }
 
     return op;
@@ -159,9 +171,44 @@ GC_INNER void * GC_generic_malloc_inner_ignore_off_page(size_t lb, int k)
     lb_adjusted = ADD_SLOP(lb);
     op = GC_alloc_large_and_clear(lb_adjusted, k, IGNORE_OFF_PAGE);
     GC_bytes_allocd += lb_adjusted;
+    GC_CLASS_ALLOCD(k, 0, lb_adjusted);
     return op;
 }
 
+/* Allocate a large object of kind k; lb is a multiple of a granule.   */
+/* The caller handles out-of-memory.                                    */
+STATIC void * GC_generic_malloc_large(size_t lb, int k, unsigned flags)
+{
+    void * result;
+    word n_blocks = OBJ_SZ_TO_BLOCKS(lb);
+    GC_bool init = GC_obj_kinds[k].ok_init;
+    DCL_LOCK_STATE;
+
+    LOCK();
+    result = (ptr_t)GC_alloc_large(lb, k, flags);
+    if (0 != result) {
+      if (GC_debugging_started) {
+        BZERO(result, n_blocks * HBLKSIZE);
+      } else {
+#       ifdef THREADS
+          /* Clear any memory that might be used for GC descriptors     */
+          /* before we release the lock.                                */
+            ((word *)result)[0] = 0;
+            ((word *)result)[1] = 0;
+            ((word *)result)[BYTES_TO_WORDS(lb)-1] = 0;
+            ((word *)result)[BYTES_TO_WORDS(lb)-2] = 0;
+#       endif
+      }
+    }
+    GC_bytes_allocd += lb;
+    GC_CLASS_ALLOCD(k, 0, lb);
+    UNLOCK_AND_SAMPLE(result, lb);
+    if (init && !GC_debugging_started && 0 != result) {
+        BZERO(result, n_blocks * HBLKSIZE);
+    }
+    return result;
+}
+
 #ifdef GC_COLLECT_AT_MALLOC
   /* Parameter to force GC at every malloc of size greater or equal to  */
   /* the given value.  This might be handy during debugging.            */
@@ -179,41 +226,15 @@ GC_API void * GC_CALL GC_generic_malloc(size_t lb, int k)
     GC_DBG_COLLECT_AT_MALLOC(lb);
     if (SMALL_OBJ(lb)) {
         LOCK();
+        GC_RECORD_SIZE(lb);
         result = GC_generic_malloc_inner((word)lb, k);
-        UNLOCK();
+        UNLOCK_AND_SAMPLE(result, lb);
     } else {
-        size_t lg;
-        size_t lb_rounded;
-        word n_blocks;
-        GC_bool init;
+        size_t lb_rounded = GRANULES_TO_BYTES(ROUNDED_UP_GRANULES(lb));
 
-        lg = ROUNDED_UP_GRANULES(lb);
-        lb_rounded = GRANULES_TO_BYTES(lg);
         if (lb_rounded < lb)
             return((*GC_get_oom_fn())(lb));
-        n_blocks = OBJ_SZ_TO_BLOCKS(lb_rounded);
-        init = GC_obj_kinds[k].ok_init;
-        LOCK();
-        result = (ptr_t)GC_alloc_large(lb_rounded, k, 0);
-        if (0 != result) {
-          if (GC_debugging_started) {
-            BZERO(result, n_blocks * HBLKSIZE);
-          } else {
-#           ifdef THREADS
-              /* Clear any memory that might be used for GC descriptors */
-              /* before we release the lock.                            */
-                ((word *)result)[0] = 0;
-                ((word *)result)[1] = 0;
-                ((word *)result)[GRANULES_TO_WORDS(lg)-1] = 0;
-                ((word *)result)[GRANULES_TO_WORDS(lg)-2] = 0;
-#           endif
-          }
-        }
-        GC_bytes_allocd += lb_rounded;
-        UNLOCK();
-        if (init && !GC_debugging_started && 0 != result) {
-            BZERO(result, n_blocks * HBLKSIZE);
-        }
+        result = GC_generic_malloc_large(lb_rounded, k, 0);
     }
     if (0 == result) {
         return((*GC_get_oom_fn())(lb));
@@ -222,6 +243,65 @@ GC_API void * GC_CALL GC_generic_malloc(size_t lb, int k)
     }
 }
 
+/* Allocate an object of kind k whose size is a multiple of align (a    */
+/* power of two greater than GRANULE_BYTES).  Small objects of such a   */
+/* size are all aligned within their block, so there is no need to      */
+/* over-allocate; large ones are placed at a suitable block.            */
+GC_INNER void * GC_generic_malloc_aligned(size_t lb, int k, size_t align)
+{
+    size_t lb_rounded = (ADD_SLOP(lb) + align - 1) & ~(align - 1);
+    void * result;
+    DCL_LOCK_STATE;
+
+    GC_ASSERT(align > GRANULE_BYTES && (align & (align - 1)) == 0);
+    if (lb_rounded < lb)
+        return((*GC_get_oom_fn())(lb));
+    if (0 == lb_rounded) lb_rounded = align;
+    if (lb_rounded <= MAXOBJBYTES) {
+        size_t lg = BYTES_TO_GRANULES(lb_rounded);
+        void ** opp;
+
+        /* If the size class is exact, the usual (thread-local) free    */
+        /* lists will do.                                               */
+        if (GC_size_map[lb_rounded - EXTRA_BYTES] == lg) {
+          if (NORMAL == k) return GC_malloc(lb_rounded - EXTRA_BYTES);
+          if (PTRFREE == k) return GC_malloc_atomic(lb_rounded - EXTRA_BYTES);
+        }
+        if (EXPECT(GC_have_errors, FALSE))
+          GC_print_all_errors();
+        GC_INVOKE_FINALIZERS();
+        GC_DBG_COLLECT_AT_MALLOC(lb);
+        LOCK();
+        if (!EXPECT(GC_is_initialized, TRUE)) GC_init();
+        opp = &(GC_obj_kinds[k].ok_freelist[lg]);
+        result = *opp;
+        if (0 == result && (0 != GC_obj_kinds[k].ok_reclaim_list
+                            || GC_alloc_reclaim_list(GC_obj_kinds + k)))
+          result = GC_allocobj(lg, k);
+        if (EXPECT(result != 0, TRUE)) {
+          *opp = obj_link(result);
+          obj_link(result) = 0;
+          GC_bytes_allocd += lb_rounded;
+          GC_CLASS_ALLOCD(k, lg, lb_rounded);
+        }
+        UNLOCK();
+    } else {
+        unsigned log_blocks = 0;
+
+        while ((word)HBLKSIZE << log_blocks < align) log_blocks++;
+        if (EXPECT(GC_have_errors, FALSE))
+          GC_print_all_errors();
+        GC_INVOKE_FINALIZERS();
+        GC_DBG_COLLECT_AT_MALLOC(lb);
+        result = GC_generic_malloc_large(lb_rounded, k,
+                                         HBLK_ALIGN_FLAGS(log_blocks));
+    }
+    if (0 == result)
+        return((*GC_get_oom_fn())(lb));
+    GC_ASSERT(((word)result & (align - 1)) == 0);
+    return GC_clear_stack(result);
+}
+
 /* Allocate lb bytes of atomic (pointerfree) data */
 #ifdef THREAD_LOCAL_ALLOC
   GC_INNER void * GC_core_malloc_atomic(size_t lb)
@@ -245,7 +325,9 @@ GC_API void * GC_CALL GC_generic_malloc(size_t lb, int k)
         }
         *opp = obj_link(op);
         GC_bytes_allocd += GRANULES_TO_BYTES(lg);
-        UNLOCK();
+        GC_CLASS_ALLOCD(PTRFREE, lg, GRANULES_TO_BYTES(lg));
+        GC_RECORD_SIZE(lb);
+        UNLOCK_AND_SAMPLE(op, lb);
         return((void *) op);
    } else {
        return(GENERAL_MALLOC((word)lb, PTRFREE));
@@ -281,7 +363,9 @@ GC_API void * GC_CALL GC_generic_malloc(size_t lb, int k)
         *opp = obj_link(op);
         obj_link(op) = 0;
         GC_bytes_allocd += GRANULES_TO_BYTES(lg);
-        UNLOCK();
+        GC_CLASS_ALLOCD(NORMAL, lg, GRANULES_TO_BYTES(lg));
+        GC_RECORD_SIZE(lb);
+        UNLOCK_AND_SAMPLE(op, lb);
         return op;
    } else {
        return(GENERAL_MALLOC(lb, NORMAL));
@@ -289,7 +373,11 @@ GC_API void * GC_CALL GC_generic_malloc(size_t lb, int k)
 }
 
 /* Allocate lb bytes of pointerful, traced, but not collectable data */
-GC_API void * GC_CALL GC_malloc_uncollectable(size_t lb)
+#ifdef THREAD_LOCAL_ALLOC
+  GC_INNER void * GC_core_malloc_uncollectable(size_t lb)
+#else
+  GC_API void * GC_CALL GC_malloc_uncollectable(size_t lb)
+#endif
 {
     void *op;
     void **opp;
@@ -309,11 +397,13 @@ GC_API void * GC_CALL GC_malloc_uncollectable(size_t lb)
             *opp = obj_link(op);
             obj_link(op) = 0;
             GC_bytes_allocd += GRANULES_TO_BYTES(lg);
+            GC_CLASS_ALLOCD(UNCOLLECTABLE, lg, GRANULES_TO_BYTES(lg));
             /* Mark bit ws already set on free list.  It will be        */
             /* cleared only temporarily during a collection, as a       */
             /* result of the normal free list mark bit clearing.        */
             GC_non_gc_bytes += GRANULES_TO_BYTES(lg);
-            UNLOCK();
+            GC_RECORD_SIZE(lb);
+            UNLOCK_AND_SAMPLE(op, lb);
         } else {
             UNLOCK();
             op = (ptr_t)GC_generic_malloc((word)lb, UNCOLLECTABLE);
@@ -508,11 +598,33 @@ GC_API void GC_CALL GC_free(void * p)
         if (0 == hhdr) return;
 #   endif
     GC_ASSERT(GC_base(p) == p);
+    if (EXPECT((hhdr -> hb_flags & REGION_BLK) != 0, FALSE)) return;
+                /* Reclaimed at the region end.                 */
     sz = hhdr -> hb_sz;
     ngranules = BYTES_TO_GRANULES(sz);
     knd = hhdr -> hb_obj_kind;
     ok = &GC_obj_kinds[knd];
     if (EXPECT(ngranules <= MAXOBJGRANULES, TRUE)) {
+#       ifdef REMOTE_FREE
+          /* Queue it to the thread refilling its free lists from the   */
+          /* block, without the lock.                                   */
+          if (hhdr -> hb_owner != 0 && GC_remote_free(p, hhdr)) return;
+#       endif
+#       ifdef FINE_GRAINED_LOCKS
+          if (!IS_UNCOLLECTABLE(knd) && GC_enter_shared_alloc()) {
+            if (ok -> ok_init) {
+                BZERO((word *)p + 1, sz-sizeof(word));
+            }
+            SHARED_COUNT_ADD(GC_bytes_freed, sz);
+            FL_LOCK(knd, ngranules);
+            flh = &(ok -> ok_freelist[ngranules]);
+            obj_link(p) = *flh;
+            *flh = (ptr_t)p;
+            FL_UNLOCK(knd, ngranules);
+            GC_leave_shared_alloc();
+            return;
+          }
+#       endif
         LOCK();
         GC_bytes_freed += sz;
         if (IS_UNCOLLECTABLE(knd)) GC_non_gc_bytes -= sz;
@@ -69,6 +69,13 @@ STATIC void * GC_generic_or_special_malloc(size_t lb, int knd)
     }
 }
 
+#ifdef USE_MREMAP_REALLOC
+# ifndef MREMAP_MIN_BYTES
+#   define MREMAP_MIN_BYTES (1024 * 1024)
+# endif
+  GC_INNER word GC_realloc_moved_bytes = 0;
+#endif
+
 /* Change the size of the block pointed to by p to contain at least   */
 /* lb bytes.  The object may be (and quite likely will be) moved.     */
 /* The kind (e.g. atomic) is the same as that of the old.             */
@@ -134,11 +141,62 @@ GC_API void * GC_CALL GC_realloc(void * p, size_t lb)
         }
     } else {
         /* grow */
-          void * result =
-                GC_generic_or_special_malloc((word)lb, obj_kind);
+          void * result;
 
+          if (sz > MAXOBJBYTES && lb < ~(size_t)0 >> 1
+              && (obj_kind == PTRFREE || obj_kind == NORMAL
+                  || IS_UNCOLLECTABLE(obj_kind))) {
+            /* Try to take the free blocks following the object.        */
+            size_t new_sz = (ADD_SLOP(lb) + HBLKSIZE - 1) & ~HBLKMASK;
+            GC_bool grown;
+            DCL_LOCK_STATE;
+
+            LOCK();
+            grown = GC_extend_hblk(h, new_sz);
+            if (grown) {
+              word descr = GC_obj_kinds[obj_kind].ok_descriptor;
+
+              if (GC_obj_kinds[obj_kind].ok_relocate_descr) descr += new_sz;
+              hhdr -> hb_descr = descr;
+              if (IS_UNCOLLECTABLE(obj_kind))
+                GC_non_gc_bytes += new_sz - sz;
+              GC_large_allocd_bytes += sz > HBLKSIZE ? new_sz - sz : new_sz;
+              if (GC_large_allocd_bytes > GC_max_large_allocd_bytes)
+                GC_max_large_allocd_bytes = GC_large_allocd_bytes;
+              GC_bytes_allocd += new_sz - sz;
+              GC_CLASS_ALLOCD(obj_kind, 0, new_sz - sz);
+              /* Clear the tail before unlocking (as                    */
+              /* GC_alloc_large_and_clear does), so that the marker     */
+              /* never sees the stale contents of the taken blocks.     */
+              if (GC_debugging_started || GC_obj_kinds[obj_kind].ok_init)
+                BZERO((ptr_t)p + sz, new_sz - sz);
+            }
+            UNLOCK();
+            if (grown) return(p);
+          }
+          result = GC_generic_or_special_malloc((word)lb, obj_kind);
           if (result == 0) return(0);
-          BCOPY(p, result, sz);
+#         ifdef USE_MREMAP_REALLOC
+            /* Swap the pages of a huge object instead of copying them  */
+            /* (only the tail past the last whole page is copied); the  */
+            /* old object, which is about to be freed, gets the former  */
+            /* pages of result.                                         */
+            if (sz >= MREMAP_MIN_BYTES && !GC_incremental
+                && (((word)p | (word)result) & (GC_page_size - 1)) == 0
+                && GC_move_pages((ptr_t)result, (ptr_t)p,
+                                 sz & ~(size_t)(GC_page_size - 1))) {
+              size_t moved = sz & ~(size_t)(GC_page_size - 1);
+              DCL_LOCK_STATE;
+
+              BCOPY((ptr_t)p + moved, (ptr_t)result + moved, sz - moved);
+              LOCK();
+              GC_realloc_moved_bytes += moved;
+              UNLOCK();
+            } else
+#         endif
+          /* else */ {
+            BCOPY(p, result, sz);
+          }
 #         ifndef IGNORE_FREE
             GC_free(p);
 #         endif
@@ -207,6 +265,7 @@ GC_INNER void * GC_generic_malloc_ignore_off_page(size_t lb, int k)
         }
     }
     GC_bytes_allocd += lb_rounded;
+    GC_CLASS_ALLOCD(k, 0, lb_rounded);
     if (0 == result) {
         GC_oom_func oom_fn = GC_oom_fn;
         UNLOCK();
@@ -255,6 +314,117 @@ GC_API void GC_CALL GC_incr_bytes_freed(size_t n)
                         /* expensive.)                                  */
 # endif /* PARALLEL_MARK */
 
+#ifdef FINE_GRAINED_LOCKS
+  /* Try to do what GC_generic_malloc_many does below (for a small lb)  */
+  /* in the shared mode, i.e. holding only the lock of the size class   */
+  /* (and that of the block allocator if a new block is needed).        */
+  /* Return FALSE if the allocation lock is needed, e.g. to collect,    */
+  /* to expand the heap or to fill the global free list.  Batch is the  */
+  /* number of bytes of a thread-local refill (or 0).                   */
+  STATIC GC_bool GC_shared_malloc_many(size_t lb, int k, size_t batch,
+                                       unsigned short owner, void **result)
+  {
+    struct obj_kind * ok = &GC_obj_kinds[k];
+    size_t lg = BYTES_TO_GRANULES(lb);
+    size_t limit = batch != 0 ? batch : HBLKSIZE;
+    signed_word my_bytes_allocd = 0;
+    struct hblk *h = 0;
+    void *op = 0;
+    void *p;
+    void **opp;
+
+    /* The uncollectable objects are counted in GC_non_gc_bytes, the    */
+    /* disclaim procedures and the leak reports may call back to the    */
+    /* client, and the incremental mode has to do its share of marking. */
+    if (IS_UNCOLLECTABLE(k) || GC_incremental || GC_find_leak
+        || NULL == ok -> ok_reclaim_list
+#       ifdef ENABLE_DISCLAIM
+          || ok -> ok_disclaim_proc != 0
+#       endif
+        || !GC_enter_shared_alloc())
+      return FALSE;
+    FL_LOCK(k, lg);
+    if (limit >= HBLKSIZE) {
+      struct hblk ** rlh = ok -> ok_reclaim_list + lg;
+      struct hblk * hbp;
+
+      while ((hbp = *rlh) != 0) {
+        hdr * hhdr = HDR(hbp);
+
+        *rlh = hhdr -> hb_next;
+        GC_ASSERT(hhdr -> hb_sz == lb);
+        hhdr -> hb_last_reclaimed = (unsigned short) GC_gc_no;
+#       ifdef REMOTE_FREE
+          hhdr -> hb_owner = owner;
+#       endif
+        op = GC_reclaim_generic(hbp, hhdr, lb, ok -> ok_init,
+                                (ptr_t)op, &my_bytes_allocd);
+        if (op != 0 && (word)my_bytes_allocd >= limit) break;
+      }
+      if (op != 0) {
+        SHARED_COUNT_ADD(GC_bytes_found, my_bytes_allocd);
+        SHARED_COUNT_ADD(GC_bytes_allocd, my_bytes_allocd);
+        GC_CLASS_ALLOCD(k, lg, my_bytes_allocd);
+        goto out;
+      }
+    }
+    opp = &(ok -> ok_freelist[lg]);
+    if ((op = *opp) != 0) {
+      *opp = 0;
+      for (p = op; p != 0; p = obj_link(p)) {
+        my_bytes_allocd += lb;
+        if ((word)my_bytes_allocd >= limit) {
+          *opp = obj_link(p);
+          obj_link(p) = 0;
+          break;
+        }
+      }
+      SHARED_COUNT_ADD(GC_bytes_allocd, my_bytes_allocd);
+      GC_CLASS_ALLOCD(k, lg, my_bytes_allocd);
+      goto out;
+    }
+    if (limit >= HBLKSIZE) {
+      HBLK_LOCK();
+#     ifndef NO_TL_HBLK_CACHE
+        h = GC_tl_allochblk(lb, k);
+#     else
+        h = GC_allochblk(lb, k, 0);
+#     endif
+      HBLK_UNLOCK();
+      if (h != 0) {
+#       ifdef REMOTE_FREE
+          HDR(h) -> hb_owner = owner;
+#       endif
+        SHARED_COUNT_ADD(GC_bytes_allocd, HBLKSIZE - HBLKSIZE % lb);
+        GC_CLASS_ALLOCD(k, lg, HBLKSIZE - HBLKSIZE % lb);
+      }
+    }
+
+  out:
+    FL_UNLOCK(k, lg);
+    if (h != 0) {
+      /* The block is not reachable by the other threads yet.   */
+#     ifdef USE_ALLOC_SPANS
+        op = GC_tl_build_fl(h, BYTES_TO_WORDS(lb),
+                            ok -> ok_init || GC_debugging_started, result);
+#     else
+        op = GC_build_fl(h, BYTES_TO_WORDS(lb),
+                         ok -> ok_init || GC_debugging_started, 0);
+#     endif
+    }
+    if (op != 0) {
+      /* Stored before the collector could run.   */
+      *result = op;
+      if (batch != 0) SHARED_COUNT_ADD(GC_tl_lockless_refills, 1);
+    }
+    GC_leave_shared_alloc();
+#   ifndef REMOTE_FREE
+      (void)owner;
+#   endif
+    return op != 0;
+  }
+#endif /* FINE_GRAINED_LOCKS */
+
 /* Return a list of 1 or more objects of the indicated size, linked     */
 /* through the first word in the object.  This has the advantage that   */
 /* it acquires the allocation lock only once, and may greatly reduce    */
@@ -270,6 +440,8 @@ GC_API void GC_CALL GC_incr_bytes_freed(size_t n)
 /* since the collector would not retain the entire list if it were      */
 /* invoked just as we were returning.                                   */
 /* Note that the client should usually clear the link field.            */
+/* If result is a thread-local free list, the number of objects is      */
+/* adapted to its refill frequency (see GC_set_tl_refill_limits).       */
 GC_API void GC_CALL GC_generic_malloc_many(size_t lb, int k, void **result)
 {
     void *op;
@@ -277,8 +449,14 @@ GC_API void GC_CALL GC_generic_malloc_many(size_t lb, int k, void **result)
     void **opp;
     size_t lw;      /* Length in words.     */
     size_t lg;      /* Length in granules.  */
+    size_t batch;   /* Bytes to return, 0 if not a thread-local refill. */
+    size_t limit;
     signed_word my_bytes_allocd = 0;
     struct obj_kind * ok = &(GC_obj_kinds[k]);
+#   ifdef REMOTE_FREE
+      unsigned short owner = 0; /* Queue of the current thread if its  */
+                                /* free list is refilled.               */
+#   endif
     DCL_LOCK_STATE;
 
     GC_ASSERT(lb != 0 && (lb & (GRANULE_BYTES-1)) == 0);
@@ -295,8 +473,48 @@ GC_API void GC_CALL GC_generic_malloc_many(size_t lb, int k, void **result)
       GC_print_all_errors();
     GC_INVOKE_FINALIZERS();
     GC_DBG_COLLECT_AT_MALLOC(lb);
+#   ifdef THREAD_LOCAL_ALLOC
+      batch = GC_tl_refill_bytes(result);
+#   else
+      batch = 0;
+#   endif
+    limit = batch != 0 ? batch : HBLKSIZE;
+#   ifdef REMOTE_FREE
+      /* The objects deallocated to the blocks of the thread are reused */
+      /* first (without the lock).                                      */
+      if (batch != 0 && (owner = GC_tl_remote_slot()) != 0) {
+        if (GC_tl_remote_drain(owner, lb, k, result)) return;
+        /* The objects of other sizes left by GC_tl_remote_drain.       */
+        GC_tl_remote_flush(owner);
+      }
+#   endif
+#   if defined(THREAD_LOCAL_ALLOC) && !defined(NO_TL_HBLK_CACHE)
+      /* Usually, a new block could be set up without the lock (but     */
+      /* GC_non_gc_bytes is updated with it held).                      */
+      if (limit >= HBLKSIZE && !IS_UNCOLLECTABLE(k)
+          && GC_tl_hblk_malloc_many(lb, k, result)) {
+#       ifdef REMOTE_FREE
+          HDR(*result) -> hb_owner = owner;
+#       endif
+        (void) GC_clear_stack(0);
+        return;
+      }
+#   endif
+#   ifdef FINE_GRAINED_LOCKS
+#     ifdef REMOTE_FREE
+        if (GC_shared_malloc_many(lb, k, batch, owner, result)) {
+#     else
+        if (GC_shared_malloc_many(lb, k, batch, 0, result)) {
+#     endif
+          (void) GC_clear_stack(0);
+          return;
+        }
+#   endif
     LOCK();
     if (!EXPECT(GC_is_initialized, TRUE)) GC_init();
+#   ifdef THREAD_LOCAL_ALLOC
+      if (batch != 0) GC_tl_locked_refills++;
+#   endif
     /* Do our share of marking work */
       if (GC_incremental && !GC_dont_gc) {
         ENTER_GC();
@@ -304,8 +522,16 @@ GC_API void GC_CALL GC_generic_malloc_many(size_t lb, int k, void **result)
         EXIT_GC();
       }
     /* First see if we can reclaim a page of objects waiting to be */
-    /* reclaimed.                                                  */
-    {
+    /* reclaimed.  Without the parallel marking, more pages are    */
+    /* reclaimed (to the same list) if a larger batch is asked.    */
+    /* A batch smaller than a page is taken from the global free   */
+    /* list below instead, leaving the rest of the page there.     */
+    op = 0;
+    /* The blocks of a kind are swept only if its reclaim list exists,  */
+    /* so it is allocated before the first block of the kind.           */
+    if (NULL == ok -> ok_reclaim_list && !GC_alloc_reclaim_list(ok))
+        goto out;
+    if (limit >= HBLKSIZE) {
         struct hblk ** rlh = ok -> ok_reclaim_list;
         struct hblk * hbp;
         hdr * hhdr;
@@ -316,6 +542,9 @@ GC_API void GC_CALL GC_generic_malloc_many(size_t lb, int k, void **result)
             *rlh = hhdr -> hb_next;
             GC_ASSERT(hhdr -> hb_sz == lb);
             hhdr -> hb_last_reclaimed = (unsigned short) GC_gc_no;
+#           ifdef REMOTE_FREE
+              hhdr -> hb_owner = owner;
+#           endif
 #           ifdef PARALLEL_MARK
               if (GC_parallel) {
                   signed_word my_bytes_allocd_tmp =
@@ -336,16 +565,18 @@ GC_API void GC_CALL GC_generic_malloc_many(size_t lb, int k, void **result)
                   GC_release_mark_lock();
               }
 #           endif
-            op = GC_reclaim_generic(hbp, hhdr, lb,
-                                    ok -> ok_init, 0, &my_bytes_allocd);
+            op = GC_reclaim_generic(hbp, hhdr, lb, ok -> ok_init,
+                                    (ptr_t)op, &my_bytes_allocd);
             if (op != 0) {
-              /* We also reclaimed memory, so we need to adjust         */
-              /* that count.                                            */
-              /* This should be atomic, so the results may be           */
-              /* inaccurate.                                            */
-              GC_bytes_found += my_bytes_allocd;
 #             ifdef PARALLEL_MARK
                 if (GC_parallel) {
+                  /* We also reclaimed memory, so we need to adjust     */
+                  /* that count.                                        */
+                  /* This should be atomic, so the results may be       */
+                  /* inaccurate.                                        */
+                  GC_bytes_found += my_bytes_allocd;
+                  GC_CLASS_ALLOCD(k, lg, my_bytes_allocd);
+                  if (IS_UNCOLLECTABLE(k)) GC_non_gc_bytes += my_bytes_allocd;
                   *result = op;
                   (void)AO_fetch_and_add(&GC_bytes_allocd_tmp,
                                          (AO_t)my_bytes_allocd);
@@ -357,8 +588,7 @@ GC_API void GC_CALL GC_generic_malloc_many(size_t lb, int k, void **result)
                   return;
                 }
 #             endif
-              GC_bytes_allocd += my_bytes_allocd;
-              goto out;
+              if ((word)my_bytes_allocd >= limit) break;
             }
 #           ifdef PARALLEL_MARK
               if (GC_parallel) {
@@ -373,31 +603,54 @@ GC_API void GC_CALL GC_generic_malloc_many(size_t lb, int k, void **result)
               }
 #           endif
         }
+        if (op != 0) {
+          GC_bytes_found += my_bytes_allocd;
+          GC_CLASS_ALLOCD(k, lg, my_bytes_allocd);
+          if (IS_UNCOLLECTABLE(k)) GC_non_gc_bytes += my_bytes_allocd;
+          GC_bytes_allocd += my_bytes_allocd;
+          goto out;
+        }
     }
     /* Next try to use prefix of global free list if there is one.      */
     /* We don't refill it, but we need to use it up before allocating   */
-    /* a new block ourselves.                                           */
+    /* a new block ourselves (unless a batch smaller than a block is    */
+    /* asked, in which case a block worth of objects is put to it).     */
       opp = &(GC_obj_kinds[k].ok_freelist[lg]);
+      if (limit < HBLKSIZE && 0 == *opp) {
+        if (ok -> ok_reclaim_list != NULL || GC_alloc_reclaim_list(ok))
+          (void)GC_allocobj(lg, k);
+      }
       if ( (op = *opp) != 0 ) {
         *opp = 0;
         my_bytes_allocd = 0;
         for (p = op; p != 0; p = obj_link(p)) {
           my_bytes_allocd += lb;
-          if ((word)my_bytes_allocd >= HBLKSIZE) {
+          if ((word)my_bytes_allocd >= limit) {
             *opp = obj_link(p);
             obj_link(p) = 0;
             break;
           }
         }
         GC_bytes_allocd += my_bytes_allocd;
+        GC_CLASS_ALLOCD(k, lg, my_bytes_allocd);
+        if (IS_UNCOLLECTABLE(k)) GC_non_gc_bytes += my_bytes_allocd;
         goto out;
       }
     /* Next try to allocate a new block worth of objects of this size.  */
     {
-        struct hblk *h = GC_allochblk(lb, k, 0);
+#       if defined(THREAD_LOCAL_ALLOC) && !defined(NO_TL_HBLK_CACHE)
+          struct hblk *h = GC_tl_allochblk(lb, k);
+#       else
+          struct hblk *h = GC_allochblk(lb, k, 0);
+#       endif
         if (h != 0) {
           if (IS_UNCOLLECTABLE(k)) GC_set_hdr_marks(HDR(h));
+#         ifdef REMOTE_FREE
+            HDR(h) -> hb_owner = owner;
+#         endif
           GC_bytes_allocd += HBLKSIZE - HBLKSIZE % lb;
+          GC_CLASS_ALLOCD(k, lg, HBLKSIZE - HBLKSIZE % lb);
+          if (IS_UNCOLLECTABLE(k)) GC_non_gc_bytes += HBLKSIZE - HBLKSIZE % lb;
 #         ifdef PARALLEL_MARK
             if (GC_parallel) {
               GC_acquire_mark_lock();
@@ -405,8 +658,13 @@ GC_API void GC_CALL GC_generic_malloc_many(size_t lb, int k, void **result)
               UNLOCK();
               GC_release_mark_lock();
 
-              op = GC_build_fl(h, lw,
+#             ifdef USE_ALLOC_SPANS
+                op = GC_tl_build_fl(h, lw,
+                        (ok -> ok_init || GC_debugging_started), result);
+#             else
+                op = GC_build_fl(h, lw,
                         (ok -> ok_init || GC_debugging_started), 0);
+#             endif
 
               *result = op;
               GC_acquire_mark_lock();
@@ -417,15 +675,32 @@ GC_API void GC_CALL GC_generic_malloc_many(size_t lb, int k, void **result)
               return;
             }
 #         endif
-          op = GC_build_fl(h, lw, (ok -> ok_init || GC_debugging_started), 0);
+#         ifdef USE_ALLOC_SPANS
+            op = GC_tl_build_fl(h, lw, (ok -> ok_init || GC_debugging_started),
+                                result);
+#         else
+            op = GC_build_fl(h, lw, (ok -> ok_init || GC_debugging_started),
+                             0);
+#         endif
           goto out;
         }
     }
 
     /* As a last attempt, try allocating a single object.  Note that    */
-    /* this may trigger a collection or expand the heap.                */
-      op = GC_generic_malloc_inner(lb, k);
-      if (0 != op) obj_link(op) = 0;
+    /* this may trigger a collection or expand the heap.  The object    */
+    /* is taken from the free list of exactly lb bytes (the clients     */
+    /* storing something in the last word rely on that), thus not by    */
+    /* GC_generic_malloc_inner (which adds EXTRA_BYTES to lb).          */
+      op = NULL;
+      if (ok -> ok_reclaim_list != NULL || GC_alloc_reclaim_list(ok))
+        op = GC_allocobj(lg, k);
+      if (0 != op) {
+        *opp = obj_link(op);
+        obj_link(op) = 0;
+        GC_bytes_allocd += lb;
+        GC_CLASS_ALLOCD(k, lg, lb);
+        if (IS_UNCOLLECTABLE(k)) GC_non_gc_bytes += lb;
+      }
 
   out:
     *result = op;
@@ -444,6 +719,335 @@ GC_API void * GC_CALL GC_malloc_many(size_t lb)
     return result;
 }
 
+GC_API void GC_CALL GC_set_tl_refill_limits(size_t min_bytes,
+                                            size_t max_bytes)
+{
+#   ifdef THREAD_LOCAL_ALLOC
+      DCL_LOCK_STATE;
+
+      if (min_bytes < GRANULE_BYTES) min_bytes = GRANULE_BYTES;
+      if (max_bytes < min_bytes) max_bytes = min_bytes;
+      LOCK();
+      GC_tl_refill_min = min_bytes;
+      GC_tl_refill_max = max_bytes;
+      UNLOCK();
+#   else
+      (void)min_bytes;
+      (void)max_bytes;
+#   endif
+}
+
+GC_API void GC_CALL GC_get_tl_refill_limits(size_t *pmin_bytes,
+                                            size_t *pmax_bytes)
+{
+#   ifdef THREAD_LOCAL_ALLOC
+      *pmin_bytes = GC_tl_refill_min;
+      *pmax_bytes = GC_tl_refill_max;
+#   else
+      /* The free lists of GC_malloc_many clients hold a block worth.   */
+      *pmin_bytes = HBLKSIZE;
+      *pmax_bytes = HBLKSIZE;
+#   endif
+}
+
+/* Store pointers to n newly allocated objects of size lb and kind k    */
+/* into result[0..n-1].  Unlike GC_generic_malloc_many, the objects are */
+/* not linked, their number is not limited to a block worth, and the    */
+/* size is rounded up as by GC_generic_malloc.  Blocks of fresh objects */
+/* are stored directly without building a free list.  The allocation    */
+/* lock is acquired once.  Returns the number of allocated objects; it  */
+/* is less than n only if we are out of memory.                         */
+GC_API size_t GC_CALL GC_generic_malloc_bulk(size_t lb, int k, size_t n,
+                                             void **result)
+{
+    struct obj_kind * ok = &(GC_obj_kinds[k]);
+    size_t i = 0;
+    DCL_LOCK_STATE;
+
+    if (0 == n) return 0;
+    if (EXPECT(GC_have_errors, FALSE))
+      GC_print_all_errors();
+    GC_INVOKE_FINALIZERS();
+    GC_DBG_COLLECT_AT_MALLOC(lb);
+    LOCK();
+    if (!EXPECT(GC_is_initialized, TRUE)) GC_init();
+    /* Do our share of marking work */
+      if (GC_incremental && !GC_dont_gc) {
+        ENTER_GC();
+        GC_collect_a_little_inner(1);
+        EXIT_GC();
+      }
+    if (SMALL_OBJ(lb)) {
+        size_t lg = GC_size_map[lb];
+        size_t bytes;
+        void **opp;
+
+        if (0 == lg) {
+          GC_extend_size_map(lb);
+          lg = GC_size_map[lb];
+        }
+        /* The sweeper needs the reclaim list for the fresh blocks.     */
+        if (0 == ok -> ok_reclaim_list)
+          (void)GC_alloc_reclaim_list(ok);
+        bytes = GRANULES_TO_BYTES(lg);
+        opp = &(ok -> ok_freelist[lg]);
+        while (i < n && EXPECT(ok -> ok_reclaim_list != 0, TRUE)) {
+          void *op = *opp;
+
+          if (0 == op) {
+            /* If no block of this size waits to be swept and a whole   */
+            /* block worth is still needed, take a fresh block.         */
+            if (n - i >= HBLKSIZE / bytes
+                && 0 == ok -> ok_reclaim_list[lg]) {
+              struct hblk *h = GC_allochblk(bytes, k, 0);
+
+              if (h != 0) {
+                ptr_t p = h -> hb_body;
+                ptr_t lim = (ptr_t)(h + 1) - bytes;
+
+                if (IS_UNCOLLECTABLE(k)) GC_set_hdr_marks(HDR(h));
+                if (ok -> ok_init || GC_debugging_started)
+                  BZERO(h, HBLKSIZE);
+                for (; (word)p <= (word)lim; p += bytes)
+                  result[i++] = p;
+                GC_bytes_allocd += HBLKSIZE - HBLKSIZE % bytes;
+                GC_CLASS_ALLOCD(k, lg, HBLKSIZE - HBLKSIZE % bytes);
+                continue;
+              }
+            }
+            op = GC_allocobj(lg, k);
+            if (0 == op) break;
+          }
+          /* Use up the free list (built or swept by GC_allocobj).     */
+          do {
+            void *next = obj_link(op);
+
+            obj_link(op) = 0;
+            result[i++] = op;
+            GC_bytes_allocd += bytes;
+            GC_CLASS_ALLOCD(k, lg, bytes);
+            op = next;
+          } while (op != 0 && i < n);
+          *opp = op;
+        }
+        if (IS_UNCOLLECTABLE(k)) GC_non_gc_bytes += i * bytes;
+    } else {
+        for (; i < n; i++) {
+          void *op = GC_generic_malloc_inner(lb, k);
+
+          if (0 == op) break;
+          if (IS_UNCOLLECTABLE(k)) {
+            hdr * hhdr = HDR(op);
+
+            set_mark_bit_from_hdr(hhdr, 0); /* Only object. */
+            hhdr -> hb_n_marks = 1;
+            GC_non_gc_bytes += hhdr -> hb_sz;
+          }
+          result[i] = op;
+        }
+    }
+    UNLOCK();
+    if (i < n) BZERO(result + i, (n - i) * sizeof(void *));
+    (void) GC_clear_stack(0);
+    return i;
+}
+
+GC_API size_t GC_CALL GC_malloc_bulk(size_t lb, size_t n, void **result)
+{
+    return GC_generic_malloc_bulk(lb, NORMAL, n, result);
+}
+
+GC_API size_t GC_CALL GC_malloc_atomic_bulk(size_t lb, size_t n,
+                                            void **result)
+{
+    return GC_generic_malloc_bulk(lb, PTRFREE, n, result);
+}
+
+GC_API size_t GC_CALL GC_malloc_uncollectable_bulk(size_t lb, size_t n,
+                                                   void **result)
+{
+    if (SMALL_OBJ(lb) && EXTRA_BYTES != 0 && lb != 0) lb--;
+                /* We don't need the extra byte, since this won't be    */
+                /* collected anyway.                                    */
+    return GC_generic_malloc_bulk(lb, UNCOLLECTABLE, n, result);
+}
+
+GC_INNER GC_bool GC_check_regions = FALSE;
+
+/* A region allocates small NORMAL and PTRFREE objects from its own     */
+/* blocks, using private free lists (indexed by kind and granules).     */
+/* The blocks are marked with REGION_BLK, so that they are not swept    */
+/* (nor are the objects returned to the global free lists by GC_free)   */
+/* until the region ends.  They are linked through hb_next; the list    */
+/* head is hidden, so that the blocks are not kept alive by it.         */
+struct GC_region_s {
+    word rg_blocks;
+    void *rg_freelists[2][MAXOBJGRANULES+1];
+};
+
+GC_API GC_region_t GC_CALL GC_region_begin(void)
+{
+    GC_STATIC_ASSERT(PTRFREE == 0 && NORMAL == 1);
+    return (GC_region_t)GC_malloc_uncollectable(sizeof(struct GC_region_s));
+}
+
+GC_INNER GC_bool GC_collect_or_expand(word needed_blocks,
+                                      GC_bool ignore_off_page,
+                                      GC_bool retry); /* from alloc.c */
+
+/* Allocate a new block of objects of lg granules for the region, and   */
+/* return the list of its objects.                                      */
+STATIC void * GC_region_new_block(GC_region_t r, size_t lg, int k)
+{
+    size_t bytes = GRANULES_TO_BYTES(lg);
+    struct hblk *h;
+    GC_bool retry = FALSE;
+    DCL_LOCK_STATE;
+
+    LOCK();
+    if (GC_incremental && !GC_dont_gc)
+        GC_collect_a_little_inner(1);
+    /* The sweeper needs the reclaim list once the block is handed over. */
+    if (0 == GC_obj_kinds[k].ok_reclaim_list
+        && !GC_alloc_reclaim_list(GC_obj_kinds + k)) {
+        UNLOCK();
+        return 0;
+    }
+    h = GC_allochblk(bytes, k, 0);
+    while (0 == h && GC_collect_or_expand(1, FALSE, retry)) {
+        h = GC_allochblk(bytes, k, 0);
+        retry = TRUE;
+    }
+    if (h != 0) {
+        hdr * hhdr = HDR(h);
+
+        hhdr -> hb_flags |= REGION_BLK;
+        hhdr -> hb_next = r -> rg_blocks != 0 ?
+                (struct hblk *)GC_REVEAL_POINTER(r -> rg_blocks) : 0;
+        r -> rg_blocks = GC_HIDE_POINTER(h);
+        GC_bytes_allocd += HBLKSIZE - HBLKSIZE % bytes;
+        GC_CLASS_ALLOCD(k, lg, HBLKSIZE - HBLKSIZE % bytes);
+    }
+    UNLOCK();
+    if (0 == h) return 0;
+    /* The block is not swept, so we can build the list without lock.  */
+    return GC_build_fl(h, GRANULES_TO_WORDS(lg),
+                       GC_obj_kinds[k].ok_init || GC_debugging_started, 0);
+}
+
+STATIC void * GC_region_generic_malloc(GC_region_t r, size_t lb, int k)
+{
+    void *op;
+    void **flh;
+    size_t lg;
+
+    if (!SMALL_OBJ(lb))
+        return GC_generic_malloc(lb, k); /* Not in the region. */
+    lg = GC_size_map[lb];
+    if (EXPECT(0 == lg, FALSE)) {
+        DCL_LOCK_STATE;
+
+        LOCK();
+        if (!EXPECT(GC_is_initialized, TRUE)) GC_init();
+        if (0 == GC_size_map[lb]) GC_extend_size_map(lb);
+        lg = GC_size_map[lb];
+        UNLOCK();
+    }
+    flh = &(r -> rg_freelists[k][lg]);
+    op = *flh;
+    if (EXPECT(0 == op, FALSE)) {
+        op = GC_region_new_block(r, lg, k);
+        if (0 == op) return (*GC_get_oom_fn())(lb);
+    }
+    *flh = obj_link(op);
+    if (k != PTRFREE) obj_link(op) = 0;
+    return op;
+}
+
+GC_API void * GC_CALL GC_region_malloc(GC_region_t r, size_t lb)
+{
+    return GC_region_generic_malloc(r, lb, NORMAL);
+}
+
+GC_API void * GC_CALL GC_region_malloc_atomic(GC_region_t r, size_t lb)
+{
+    return GC_region_generic_malloc(r, lb, PTRFREE);
+}
+
+/* Run a full collection (the region blocks are not swept) and report   */
+/* the marked objects of the region.  Conservative: a stale pointer on  */
+/* the stack also counts as a reference.  If the collection is not done */
+/* (e.g. the collector is disabled), the mark bits are stale, so the    */
+/* region is assumed to escape.                                         */
+STATIC GC_bool GC_region_escapes(GC_region_t r)
+{
+    struct hblk *h;
+    GC_bool escapes = FALSE;
+    DCL_LOCK_STATE;
+
+    BZERO(r -> rg_freelists, sizeof(r -> rg_freelists));
+    if (!GC_try_to_collect(GC_never_stop_func)) {
+      WARN("Cannot check a region while collection is disabled;"
+           " its blocks are not released\n", 0);
+      return TRUE;
+    }
+    LOCK();
+    h = r -> rg_blocks != 0 ? (struct hblk *)GC_REVEAL_POINTER(r -> rg_blocks)
+                            : 0;
+    for (; h != 0; h = HDR(h) -> hb_next) {
+        hdr * hhdr = HDR(h);
+        size_t sz = hhdr -> hb_sz;
+        word bit_no = 0;
+        ptr_t p;
+
+        for (p = h -> hb_body; (word)p <= (word)h + HBLKSIZE - sz;
+             p += sz, bit_no += MARK_BIT_OFFSET(sz)) {
+          if (mark_bit_from_hdr(hhdr, bit_no)) {
+            if (!escapes)
+              GC_err_printf("Object at %p allocated in region %p is still"
+                            " referenced\n", p, (void *)r);
+            escapes = TRUE;
+          }
+        }
+    }
+    UNLOCK();
+    if (escapes)
+      WARN("Escaping references to a region; its blocks are not released\n",
+           0);
+    return escapes;
+}
+
+GC_API void GC_CALL GC_region_end(GC_region_t r, unsigned flags)
+{
+    struct hblk *h;
+    struct hblk *next;
+    DCL_LOCK_STATE;
+
+    if (0 == r) return;
+    if ((flags & GC_REGION_RELEASE) != 0
+        && ((flags & GC_REGION_CHECK) != 0 || GC_check_regions)
+        && GC_region_escapes(r)) {
+      flags &= ~GC_REGION_RELEASE;
+    }
+    LOCK();
+    h = r -> rg_blocks != 0 ? (struct hblk *)GC_REVEAL_POINTER(r -> rg_blocks)
+                            : 0;
+    for (; h != 0; h = next) {
+        hdr * hhdr = HDR(h);
+
+        next = hhdr -> hb_next;
+        hhdr -> hb_flags &= ~REGION_BLK;
+        if ((flags & GC_REGION_RELEASE) != 0) {
+          GC_bytes_freed += HBLKSIZE - HBLKSIZE % hhdr -> hb_sz;
+          GC_freehblk(h);
+        }
+        /* Otherwise, the block is left to the collector; the unused    */
+        /* objects of it (not marked) are reclaimed by the next sweep.  */
+    }
+    UNLOCK();
+    GC_free(r);
+}
+
 /* Not well tested nor integrated.      */
 /* Debug version is tricky and currently missing.       */
 #include <limits.h>
@@ -455,6 +1059,11 @@ GC_API void * GC_CALL GC_memalign(size_t align, size_t lb)
     ptr_t result;
 
     if (align <= GRANULE_BYTES) return GC_malloc(lb);
+    if ((align & (align - 1)) == 0) {
+        /* The object size is rounded up to a multiple of align, so     */
+        /* the object is aligned naturally.                             */
+        return GC_generic_malloc_aligned(lb, NORMAL, align);
+    }
     if (align >= HBLKSIZE/2 || lb >= HBLKSIZE/2) {
         if (align > HBLKSIZE) {
           return (*GC_get_oom_fn())(LONG_MAX-1024); /* Fail */
@@ -462,8 +1071,7 @@ GC_API void * GC_CALL GC_memalign(size_t align, size_t lb)
         return GC_malloc(lb <= HBLKSIZE? HBLKSIZE : lb);
             /* Will be HBLKSIZE aligned.        */
     }
-    /* We could also try to make sure that the real rounded-up object size */
-    /* is a multiple of align.  That would be correct up to HBLKSIZE.      */
+    /* Not a power of two; over-allocate and return an interior pointer. */
     new_lb = lb + align - 1;
     result = GC_malloc(new_lb);
             /* It is ok not to check result for NULL as in that case    */
@@ -527,6 +1135,7 @@ GC_API int GC_CALL GC_posix_memalign(void **memptr, size_t align, size_t lb)
             *opp = obj_link(op);
             obj_link(op) = 0;
             GC_bytes_allocd += GRANULES_TO_BYTES(lg);
+            GC_CLASS_ALLOCD(AUNCOLLECTABLE, lg, GRANULES_TO_BYTES(lg));
             /* Mark bit was already set while object was on free list. */
             GC_non_gc_bytes += GRANULES_TO_BYTES(lg);
             UNLOCK();
@@ -144,7 +144,7 @@ GC_INNER GC_bool GC_collection_in_progress(void)
 GC_INNER void GC_clear_hdr_marks(hdr *hhdr)
 {
     size_t last_bit = FINAL_MARK_BIT(hhdr -> hb_sz);
-    BZERO(hhdr -> hb_marks, sizeof(hhdr->hb_marks));
+    BZERO(hhdr -> hb_marks, MARK_BITS_SZ * sizeof(hhdr -> hb_marks[0]));
     set_mark_bit_from_hdr(hhdr, last_bit);
     hhdr -> hb_n_marks = 0;
 }
@@ -157,8 +157,13 @@ GC_INNER void GC_set_hdr_marks(hdr *hhdr)
     unsigned n_marks = (unsigned)FINAL_MARK_BIT(sz);
 
 #   ifdef USE_MARK_BYTES
-      for (i = 0; i <= n_marks; i += (unsigned)MARK_BIT_OFFSET(sz)) {
-        hhdr -> hb_marks[i] = 1;
+      if (MARK_BIT_OFFSET(sz) == 1) {
+        /* Objects of a granule, the most numerous ones.        */
+        memset(hhdr -> hb_marks, 1, n_marks + 1);
+      } else {
+        for (i = 0; i <= n_marks; i += (unsigned)MARK_BIT_OFFSET(sz)) {
+          hhdr -> hb_marks[i] = 1;
+        }
       }
 #   else
       for (i = 0; i < divWORDSZ(n_marks + WORDSZ); ++i) {
@@ -172,6 +177,147 @@ GC_INNER void GC_set_hdr_marks(hdr *hhdr)
 #   endif
 }
 
+/* The kernels counting the set mark bits (or bytes) of a block, except */
+/* the one past the end.  Only the mark bits of the object starts are   */
+/* expected to be set (i.e. the block is not an uncollectable one with  */
+/* USE_MARK_BITS).  The generic ones process a word at a time; the      */
+/* others are chosen by GC_init_mark_kernels according to the CPU.      */
+#ifdef USE_MARK_BYTES
+  STATIC unsigned GC_count_hdr_marks_generic(const hdr *hhdr)
+  {
+    const word *p = (const word *)hhdr -> hb_marks;
+    unsigned result = 0;
+    unsigned i = 0;
+
+    /* Each mark byte is 0 or 1.  The words are added up bytewise (at   */
+    /* most 255 of them at a time, so that no byte overflows), then the */
+    /* bytes of the sum are added up.                                   */
+    while (i < MARK_BITS_SZ / sizeof(word)) {
+      unsigned limit = MARK_BITS_SZ / sizeof(word) - i > 255 ? i + 255
+                                : (unsigned)(MARK_BITS_SZ / sizeof(word));
+      word sum = 0;
+
+      for (; i < limit; ++i) {
+        sum += p[i];
+      }
+      sum = (sum & (ONES / 257)) + ((sum >> 8) & (ONES / 257));
+      result += (unsigned)((sum * (ONES / 65535)) >> (CPP_WORDSZ - 16));
+    }
+    for (i *= sizeof(word); i < MARK_BITS_SZ; ++i) {
+      result += (unsigned char)hhdr -> hb_marks[i];
+    }
+    return result - 1;
+  }
+#else
+  STATIC unsigned GC_count_hdr_marks_generic(const hdr *hhdr)
+  {
+    unsigned result = 0;
+    unsigned i;
+
+    for (i = 0; i < MARK_BITS_SZ; ++i) {
+      word m = hhdr -> hb_marks[i];
+
+      /* Count the bits in parallel (the classic SWAR popcount). */
+      m -= (m >> 1) & (ONES / 3);
+      m = (m & (ONES / 5)) + ((m >> 2) & (ONES / 5));
+      m = (m + (m >> 4)) & (ONES / 17);
+      result += (unsigned)((m * (ONES / 255)) >> (CPP_WORDSZ - 8));
+    }
+    return result - 1;
+  }
+#endif /* !USE_MARK_BYTES */
+
+GC_INNER unsigned (*GC_count_hdr_marks)(const hdr *) =
+                                        GC_count_hdr_marks_generic;
+
+#ifdef SIMD_MARK_KERNELS
+# include <immintrin.h>
+
+# ifdef USE_MARK_BYTES
+    /* The mark bytes are summed up 16 (or 32) at a time by psadbw.     */
+    __attribute__((__target__("sse2")))
+    STATIC unsigned GC_count_hdr_marks_sse2(const hdr *hhdr)
+    {
+      const char *marks = hhdr -> hb_marks;
+      __m128i zero = _mm_setzero_si128();
+      __m128i acc = zero;
+      unsigned i;
+      unsigned sum;
+
+      for (i = 0; i + 16 <= MARK_BITS_SZ; i += 16) {
+        acc = _mm_add_epi64(acc, _mm_sad_epu8(
+                        _mm_loadu_si128((const __m128i *)(marks + i)), zero));
+      }
+      sum = (unsigned)_mm_cvtsi128_si32(acc)
+            + (unsigned)_mm_cvtsi128_si32(_mm_unpackhi_epi64(acc, acc));
+      for (; i < MARK_BITS_SZ; ++i) {
+        sum += (unsigned char)marks[i];
+      }
+      GC_ASSERT(sum - 1 == GC_count_hdr_marks_generic(hhdr));
+      return sum - 1;
+    }
+
+    __attribute__((__target__("avx2")))
+    STATIC unsigned GC_count_hdr_marks_avx2(const hdr *hhdr)
+    {
+      const char *marks = hhdr -> hb_marks;
+      __m256i zero = _mm256_setzero_si256();
+      __m256i acc = zero;
+      __m128i acc128;
+      unsigned i;
+      unsigned sum;
+
+      for (i = 0; i + 32 <= MARK_BITS_SZ; i += 32) {
+        acc = _mm256_add_epi64(acc, _mm256_sad_epu8(
+                    _mm256_loadu_si256((const __m256i *)(marks + i)), zero));
+      }
+      acc128 = _mm_add_epi64(_mm256_castsi256_si128(acc),
+                             _mm256_extracti128_si256(acc, 1));
+      sum = (unsigned)_mm_cvtsi128_si32(acc128)
+            + (unsigned)_mm_cvtsi128_si32(_mm_unpackhi_epi64(acc128,
+                                                             acc128));
+      for (; i < MARK_BITS_SZ; ++i) {
+        sum += (unsigned char)marks[i];
+      }
+      GC_ASSERT(sum - 1 == GC_count_hdr_marks_generic(hhdr));
+      return sum - 1;
+    }
+# else
+    __attribute__((__target__("popcnt")))
+    STATIC unsigned GC_count_hdr_marks_popcnt(const hdr *hhdr)
+    {
+      unsigned result = 0;
+      unsigned i;
+
+      for (i = 0; i < MARK_BITS_SZ; ++i) {
+        result += (unsigned)__builtin_popcountll(
+                                (unsigned long long)hhdr -> hb_marks[i]);
+      }
+      GC_ASSERT(result - 1 == GC_count_hdr_marks_generic(hhdr));
+      return result - 1;
+    }
+# endif /* !USE_MARK_BYTES */
+
+  GC_INNER void GC_init_mark_kernels(void)
+  {
+    if (GETENV("GC_NO_SIMD_MARK_KERNELS") != NULL) return;
+    __builtin_cpu_init();
+#   ifdef USE_MARK_BYTES
+      if (__builtin_cpu_supports("avx2")) {
+        GC_count_hdr_marks = GC_count_hdr_marks_avx2;
+      } else if (__builtin_cpu_supports("sse2")) {
+        GC_count_hdr_marks = GC_count_hdr_marks_sse2;
+      }
+#   else
+      if (__builtin_cpu_supports("popcnt"))
+        GC_count_hdr_marks = GC_count_hdr_marks_popcnt;
+#   endif
+    if (GC_print_stats && GC_count_hdr_marks != GC_count_hdr_marks_generic)
+      GC_log_printf("Using SIMD mark bit kernels\n");
+  }
+#endif /* SIMD_MARK_KERNELS */
+
+#ifndef SIDE_MARK_BITS
 /*
  * Clear all mark bits associated with block h.
  */
@@ -185,6 +331,7 @@ static void clear_marks_for_block(struct hblk *h, word dummy GC_ATTR_UNUSED)
         /* the bit is cleared once the object is on the free list.      */
     GC_clear_hdr_marks(hhdr);
 }
+#endif /* !SIDE_MARK_BITS */
 
 /* Slow but general routines for setting/clearing/asking about mark bits */
 GC_API void GC_CALL GC_set_mark_bit(const void *p)
@@ -230,6 +377,144 @@ GC_API int GC_CALL GC_is_marked(const void *p)
     return (int)mark_bit_from_hdr(hhdr, bit_no); /* 0 or 1 */
 }
 
+#ifdef SIDE_MARK_BITS
+  /* The mark bits of each chunk added by GC_add_to_heap are in a side  */
+  /* table, MARK_SLOT_WORDS per block whether it is in use or not, so   */
+  /* that GC_clear_marks clears them with a few memset calls instead of */
+  /* visiting every block header, and the sweep reads them in the       */
+  /* address order.  The table also records the final mark bit of each */
+  /* in-use block (to be set again once the marks are cleared).         */
+# ifdef USE_MARK_BYTES
+#   define MARK_SLOT_WORDS ((MARK_BITS_SZ + sizeof(word) - 1) / sizeof(word))
+# else
+#   define MARK_SLOT_WORDS MARK_BITS_SZ
+# endif
+# define MT_KEEP 0xfffe /* An uncollectable block, its marks are kept.  */
+# define MT_FREE 0xffff /* Not the first block of an in-use one.        */
+
+# ifndef INITIAL_MARK_TABLES
+#   define INITIAL_MARK_TABLES 32
+# endif
+
+  GC_INNER GC_bool GC_add_mark_table(struct hblk *h, size_t bytes)
+  {
+    word n_blocks = divHBLKSZ(bytes);
+    size_t marks_bytes = n_blocks * MARK_SLOT_WORDS * sizeof(word);
+    word *marks;
+    word i, j;
+
+    GC_ASSERT(I_HOLD_LOCK());
+    marks = (word *)GC_scratch_alloc(marks_bytes
+                                     + n_blocks * sizeof(unsigned short));
+    if (EXPECT(NULL == marks, FALSE)) return FALSE;
+    if (GC_n_mark_tables == GC_capacity_mark_tables) {
+      /* Grow the table geometrically, as GC_heap_sects.        */
+      word new_capacity = GC_n_mark_tables > 0 ? GC_n_mark_tables * 2
+                                               : INITIAL_MARK_TABLES;
+      struct MarkTable *new_tables = (struct MarkTable *)GC_scratch_alloc(
+                            (size_t)new_capacity * sizeof(struct MarkTable));
+
+      if (EXPECT(NULL == new_tables, FALSE)) return FALSE;
+      if (GC_n_mark_tables > 0)
+        BCOPY(GC_mark_tables, new_tables,
+              GC_n_mark_tables * sizeof(struct MarkTable));
+      GC_mark_tables = new_tables;
+      GC_capacity_mark_tables = new_capacity;
+    }
+    for (i = GC_n_mark_tables; i > 0; i--) {
+      if ((word)GC_mark_tables[i-1].mt_start < (word)h) break;
+      GC_mark_tables[i] = GC_mark_tables[i-1];
+    }
+    GC_mark_tables[i].mt_start = h;
+    GC_mark_tables[i].mt_n_blocks = n_blocks;
+    GC_mark_tables[i].mt_marks = marks;
+    GC_mark_tables[i].mt_final = (unsigned short *)((ptr_t)marks
+                                                    + marks_bytes);
+    for (j = 0; j < n_blocks; j++)
+      GC_mark_tables[i].mt_final[j] = MT_FREE;
+    GC_n_mark_tables++;
+    if (GC_print_stats == VERBOSE)
+      GC_log_printf("Allocated side mark table of %lu bytes for %p\n",
+                    (unsigned long)marks_bytes, (void *)h);
+    return TRUE;
+  }
+
+  /* The table containing the block, and the index of the latter.      */
+  STATIC struct MarkTable *GC_find_mark_table(struct hblk *h, word *pindex)
+  {
+    word lo = 0;
+    word hi = GC_n_mark_tables;
+
+    while (lo < hi) {
+      word mid = (lo + hi) >> 1;
+      struct MarkTable *t = &GC_mark_tables[mid];
+
+      if ((word)h < (word)t -> mt_start) {
+        hi = mid;
+      } else if ((word)(h - t -> mt_start) >= t -> mt_n_blocks) {
+        lo = mid + 1;
+      } else {
+        *pindex = (word)(h - t -> mt_start);
+        return t;
+      }
+    }
+    ABORT("No side mark table for heap block");
+    return NULL;
+  }
+
+  GC_INNER void GC_bind_side_marks(hdr *hhdr, struct hblk *h)
+  {
+    word i;
+    struct MarkTable *t = GC_find_mark_table(h, &i);
+
+    hhdr -> hb_marks = (void *)(t -> mt_marks + i * MARK_SLOT_WORDS);
+    t -> mt_final[i] = (unsigned short)(IS_UNCOLLECTABLE(hhdr -> hb_obj_kind)
+                                        ? MT_KEEP
+                                        : FINAL_MARK_BIT(hhdr -> hb_sz));
+  }
+
+  GC_INNER void GC_release_side_marks(struct hblk *h)
+  {
+    word i;
+    struct MarkTable *t = GC_find_mark_table(h, &i);
+
+    t -> mt_final[i] = MT_FREE;
+  }
+
+  /* The equivalent of clear_marks_for_block for all the blocks.  The   */
+  /* hb_n_marks counts are left as is (see GC_reclaim_block).           */
+  STATIC void GC_clear_side_marks(void)
+  {
+    word i, j;
+
+    for (i = 0; i < GC_n_mark_tables; i++) {
+      struct MarkTable *t = &GC_mark_tables[i];
+      word run_start = 0;
+
+      /* Clear the runs of blocks between the uncollectable ones.       */
+      for (j = 0; j <= t -> mt_n_blocks; j++) {
+        if (j == t -> mt_n_blocks || MT_KEEP == t -> mt_final[j]) {
+          if (j > run_start)
+            BZERO(t -> mt_marks + run_start * MARK_SLOT_WORDS,
+                  (j - run_start) * MARK_SLOT_WORDS * sizeof(word));
+          run_start = j + 1;
+        }
+      }
+      for (j = 0; j < t -> mt_n_blocks; j++) {
+        unsigned last_bit = t -> mt_final[j];
+        word *marks = t -> mt_marks + j * MARK_SLOT_WORDS;
+
+        if (last_bit >= MT_KEEP) continue;
+#       ifdef USE_MARK_BYTES
+          ((char *)marks)[last_bit] = 1;
+#       else
+          marks[divWORDSZ(last_bit)] |= (word)1 << modWORDSZ(last_bit);
+#       endif
+      }
+    }
+  }
+#endif /* SIDE_MARK_BITS */
+
 /*
  * Clear mark bits in all allocated heap blocks.  This invalidates
  * the marker invariant, and sets GC_mark_state to reflect this.
@@ -237,7 +522,11 @@ GC_API int GC_CALL GC_is_marked(const void *p)
  */
 GC_INNER void GC_clear_marks(void)
 {
-    GC_apply_to_all_blocks(clear_marks_for_block, (word)0);
+#   ifdef SIDE_MARK_BITS
+      GC_clear_side_marks();
+#   else
+      GC_apply_to_all_blocks(clear_marks_for_block, (word)0);
+#   endif
     GC_objects_are_marked = FALSE;
     GC_mark_state = MS_INVALID;
     scan_ptr = 0;
@@ -599,6 +888,42 @@ GC_INNER mse * GC_signal_mark_stack_overflow(mse *msp)
     return(msp - GC_MARK_STACK_DISCARDS);
 }
 
+#ifdef PREFETCH_FIFO
+  GC_INNER unsigned GC_prefetch_fifo_depth = PREFETCH_FIFO_DEPTH;
+
+  /* The objects are pushed on the mark stack as soon as they are       */
+  /* found, and popped (in LIFO order) almost immediately, so the       */
+  /* prefetch of an object as it is pushed has little time to complete. */
+  /* Instead, as in the "prefetch on grey" scheme of Cher et al., the   */
+  /* candidate pointers found by GC_mark_from are prefetched and put in */
+  /* a FIFO, and are marked (i.e. their header and mark bit looked up,  */
+  /* and they are pushed) only when the FIFO holds more than            */
+  /* GC_prefetch_fifo_depth of them, zero meaning to mark them at once. */
+  /* The FIFO is drained before returning.  The source of a candidate   */
+  /* is referenced only by the debugging code of PUSH_CONTENTS (which   */
+  /* drops the argument otherwise).                                     */
+# define FIFO_SOURCE(i) fifo[(i) & (PREFETCH_FIFO_SIZE - 1)].source
+# define MARK_CANDIDATE(cand, from, exit_label) \
+    { \
+      PREFETCH((ptr_t)(cand)); \
+      fifo[fifo_in & (PREFETCH_FIFO_SIZE - 1)].p = (ptr_t)(cand); \
+      fifo[fifo_in & (PREFETCH_FIFO_SIZE - 1)].source = (ptr_t)(from); \
+      fifo_in++; \
+      if (fifo_in - fifo_out > fifo_depth) { \
+        ptr_t fifo_p = fifo[fifo_out++ & (PREFETCH_FIFO_SIZE - 1)].p; \
+        PUSH_CONTENTS(fifo_p, mark_stack_top, mark_stack_limit, \
+                      FIFO_SOURCE(fifo_out - 1), exit_label); \
+      } \
+    }
+#else
+# define MARK_CANDIDATE(cand, from, exit_label) \
+    { \
+      PREFETCH((ptr_t)(cand)); \
+      PUSH_CONTENTS((ptr_t)(cand), mark_stack_top, mark_stack_limit, \
+                    from, exit_label); \
+    }
+#endif /* !PREFETCH_FIFO */
+
 /*
  * Mark objects pointed to by the regions described by
  * mark stack entries between mark_stack and mark_stack_top,
@@ -624,10 +949,22 @@ GC_INNER mse * GC_mark_from(mse *mark_stack_top, mse *mark_stack,
   word descr;
   ptr_t greatest_ha = GC_greatest_plausible_heap_addr;
   ptr_t least_ha = GC_least_plausible_heap_addr;
+# ifdef PREFETCH_FIFO
+    struct {
+      ptr_t p;
+      ptr_t source;
+    } fifo[PREFETCH_FIFO_SIZE]; /* The candidates not marked yet.       */
+    unsigned fifo_in = 0;       /* The number of candidates put in, and */
+    unsigned fifo_out = 0;      /* taken out of, the FIFO.              */
+    unsigned fifo_depth = GC_prefetch_fifo_depth;
+# endif
   DECLARE_HDR_CACHE;
 
 # define SPLIT_RANGE_WORDS 128  /* Must be power of 2.          */
 
+# ifdef PREFETCH_FIFO
+    GC_ASSERT(fifo_depth < PREFETCH_FIFO_SIZE);
+# endif
   GC_objects_are_marked = TRUE;
   INIT_HDR_CACHE;
 # ifdef OS2 /* Use untweaked version to circumvent compiler problem */
@@ -715,15 +1052,13 @@ GC_INNER mse * GC_mark_from(mse *mark_stack_top, mse *mark_stack,
               current = *(word *)current_p;
               FIXUP_POINTER(current);
               if (current >= (word)least_ha && current < (word)greatest_ha) {
-                PREFETCH((ptr_t)current);
 #               ifdef ENABLE_TRACE
                   if (GC_trace_addr == current_p) {
                     GC_log_printf("GC:%u Considering(3) %p -> %p\n",
                                (unsigned)GC_gc_no, current_p, (ptr_t)current);
                   }
 #               endif /* ENABLE_TRACE */
-                PUSH_CONTENTS((ptr_t)current, mark_stack_top,
-                              mark_stack_limit, current_p, exit1);
+                MARK_CANDIDATE(current, current_p, exit1);
               }
             }
             descr <<= 1;
@@ -840,17 +1175,15 @@ GC_INNER mse * GC_mark_from(mse *mark_stack_top, mse *mark_stack,
         FIXUP_POINTER(current);
         PREFETCH(current_p + PREF_DIST*CACHE_LINE_SIZE);
         if (current >= (word)least_ha && current < (word)greatest_ha) {
-          /* Prefetch the contents of the object we just pushed.  It's  */
-          /* likely we will need them soon.                             */
-          PREFETCH((ptr_t)current);
+          /* MARK_CANDIDATE prefetches the contents of the object we    */
+          /* just found.  It's likely we will need them soon.           */
 #         ifdef ENABLE_TRACE
             if (GC_trace_addr == current_p) {
               GC_log_printf("GC:%u Considering(1) %p -> %p\n",
                             (unsigned)GC_gc_no, current_p, (ptr_t)current);
             }
 #         endif /* ENABLE_TRACE */
-          PUSH_CONTENTS((ptr_t)current, mark_stack_top,
-                           mark_stack_limit, current_p, exit2);
+          MARK_CANDIDATE(current, current_p, exit2);
         }
         current_p += ALIGNMENT;
       }
@@ -865,12 +1198,20 @@ GC_INNER mse * GC_mark_from(mse *mark_stack_top, mse *mark_stack,
                             (unsigned)GC_gc_no, current_p, (ptr_t)deferred);
             }
 #       endif /* ENABLE_TRACE */
-        PUSH_CONTENTS((ptr_t)deferred, mark_stack_top,
-                         mark_stack_limit, current_p, exit4);
+        MARK_CANDIDATE(deferred, current_p, exit4);
         next_object:;
 #     endif
     }
   }
+# ifdef PREFETCH_FIFO
+    /* Mark the remaining candidates (this may push more entries).      */
+    while (fifo_out != fifo_in) {
+      ptr_t fifo_p = fifo[fifo_out++ & (PREFETCH_FIFO_SIZE - 1)].p;
+
+      PUSH_CONTENTS(fifo_p, mark_stack_top, mark_stack_limit,
+                    FIFO_SOURCE(fifo_out - 1), exit5);
+    }
+# endif
   return mark_stack_top;
 }
 
@@ -879,12 +1220,13 @@ GC_INNER mse * GC_mark_from(mse *mark_stack_top, mse *mark_stack,
 STATIC GC_bool GC_help_wanted = FALSE;  /* Protected by mark lock       */
 STATIC unsigned GC_helper_count = 0;    /* Number of running helpers.   */
                                         /* Protected by mark lock       */
-STATIC unsigned GC_active_count = 0;    /* Number of active helpers.    */
-                                        /* Protected by mark lock       */
-                                        /* May increase and decrease    */
-                                        /* within each mark cycle.  But */
-                                        /* once it returns to 0, it     */
-                                        /* stays zero for the cycle.    */
+STATIC volatile AO_t GC_active_markers = 0;
+                                        /* Number of helpers having or  */
+                                        /* looking for work.  May       */
+                                        /* increase and decrease within */
+                                        /* each mark cycle.  But once   */
+                                        /* it returns to 0, there is no */
+                                        /* work left for the cycle.     */
 
 GC_INNER word GC_mark_no = 0;
 
@@ -893,24 +1235,107 @@ GC_INNER word GC_mark_no = 0;
         /* we don't overflow half of it in a single call to             */
         /* GC_mark_from.                                                */
 
+#ifndef MARK_DEQUE_SIZE
+# define MARK_DEQUE_SIZE 4096   /* Entries per marker, a power of 2.    */
+#endif
+
+/* Each marker shares the entries it cannot process soon through its    */
+/* work-stealing deque (Chase and Lev).  The owner pushes and pops them */
+/* at bottom, the other markers steal them at top, with no lock.  The   */
+/* entries are kept in a circular buffer of MARK_DEQUE_SIZE ones which  */
+/* is not grown: those which do not fit are returned to the global     */
+/* mark stack instead (under the mark lock).  Indices only increase     */
+/* during a mark cycle (modulo the word size).                          */
+struct mark_deque {
+  volatile AO_t top;    /* Index of the oldest entry; incremented by    */
+                        /* the thieves (and the owner) with CAS.        */
+  char pad[CACHE_LINE_SIZE];
+  volatile AO_t bottom; /* Index past the newest entry; written by the  */
+                        /* owner only.                                  */
+  mse *entries;         /* Allocated with GC_scratch_alloc, so that     */
+                        /* they are not scanned as roots.               */
+# ifdef USE_NUMA
+    int node;           /* The node the owner runs on (as of the last   */
+                        /* mark phase it took part in), or -1.  A hint  */
+                        /* for the thieves only.                        */
+# endif
+};
+
+GC_INNER int GC_max_markers_m1 = 0;
+
+STATIC struct mark_deque *GC_mark_deques = NULL;
+STATIC unsigned GC_n_mark_deques = 0;   /* One per marker of the pool   */
+                                        /* (0 if the allocation failed).*/
+
+/* Allocate the deques of all the markers.  May silently fail.  */
+STATIC void GC_init_mark_deques(void)
+{
+    unsigned n = (unsigned)GC_max_markers_m1 + 1;
+    ptr_t p;
+    unsigned i;
+
+    GC_ASSERT(I_HOLD_LOCK());
+    p = (ptr_t)GC_scratch_alloc(n * (sizeof(struct mark_deque)
+                                     + MARK_DEQUE_SIZE * sizeof(mse))
+                                + CACHE_LINE_SIZE);
+    if (NULL == p) return;
+    p = (ptr_t)(((word)p + CACHE_LINE_SIZE - 1)
+                & ~(word)(CACHE_LINE_SIZE - 1));
+    GC_mark_deques = (struct mark_deque *)p;
+    p += n * sizeof(struct mark_deque);
+    for (i = 0; i < n; ++i) {
+      GC_mark_deques[i].top = 0;
+      GC_mark_deques[i].bottom = 0;
+      GC_mark_deques[i].entries = (mse *)p + i * MARK_DEQUE_SIZE;
+#     ifdef USE_NUMA
+        GC_mark_deques[i].node = -1;
+#     endif
+    }
+    GC_n_mark_deques = n;
+}
+
+
+#ifdef USE_NUMA
+# ifndef NUMA_STEAL_WINDOW
+#   define NUMA_STEAL_WINDOW 16
+# endif
+#endif
 
 /* Steal mark stack entries starting at mse low into mark stack local   */
 /* until we either steal mse high, or we have max entries.              */
 /* Return a pointer to the top of the local mark stack.                 */
 /* *next is replaced by a pointer to the next unscanned mark stack      */
-/* entry.                                                               */
+/* entry.  If node is nonnegative (in the NUMA mode) then the entries   */
+/* for objects on the other nodes are skipped (and left for the         */
+/* markers running there) within the first NUMA_STEAL_WINDOW ones,      */
+/* unless there are no others.                                          */
 STATIC mse * GC_steal_mark_stack(mse * low, mse * high, mse * local,
-                                 unsigned max, mse **next)
+                                 unsigned max, mse **next, int node)
 {
     mse *p;
     mse *top = local - 1;
     unsigned i = 0;
+#   ifdef USE_NUMA
+      mse *skipped = NULL;      /* The first entry left in place.       */
+#   else
+      (void)node;
+#   endif
 
     GC_ASSERT((word)high >= (word)(low - 1)
               && (word)(high - low + 1) <= GC_mark_stack_size);
     for (p = low; (word)p <= (word)high && i <= max; ++p) {
         word descr = (word)AO_load(&p->mse_descr.ao);
         if (descr != 0) {
+#           ifdef USE_NUMA
+              if (node >= 0 && p - low < NUMA_STEAL_WINDOW) {
+                int obj_node = GC_numa_node_of(p -> mse_start);
+
+                if (obj_node >= 0 && obj_node != node) {
+                  if (NULL == skipped) skipped = p;
+                  continue;
+                }
+              }
+#           endif
             /* Must be ordered after read of descr: */
             AO_store_release_write(&p->mse_descr.ao, 0);
             /* More than one thread may get this entry, but that's only */
@@ -927,6 +1352,14 @@ STATIC mse * GC_steal_mark_stack(mse * low, mse * high, mse * local,
             if ((descr & GC_DS_TAGS) == GC_DS_LENGTH) i += (int)(descr >> 8);
         }
     }
+#   ifdef USE_NUMA
+      if (skipped != NULL) {
+        /* The skipped entries should not be lost.      */
+        if (top < local)
+          return GC_steal_mark_stack(skipped, high, local, max, next, -1);
+        p = skipped;
+      }
+#   endif
     *next = p;
     return top;
 }
@@ -961,48 +1394,113 @@ STATIC void GC_return_mark_stack(mse * low, mse * high)
                 /* Ensures visibility of previously written stack contents. */
     }
     GC_release_mark_lock();
-    GC_notify_all_marker();
+}
+
+/* Push the entries low..high (inclusive) of a local mark stack to the  */
+/* deque d of the current marker (if any).  Those which do not fit are  */
+/* returned to the global mark stack.                                   */
+STATIC void GC_push_to_deque(struct mark_deque *d, mse *low, mse *high)
+{
+    if (d != NULL) {
+      AO_t b = d -> bottom;
+      AO_t room = MARK_DEQUE_SIZE - (b - AO_load(&(d -> top)));
+                        /* top could only be greater, thus there is at  */
+                        /* least that much room.                        */
+
+      for (; (word)low <= (word)high && room > 0; ++low, --room) {
+        d -> entries[b++ & (MARK_DEQUE_SIZE - 1)] = *low;
+      }
+      AO_store_release(&(d -> bottom), b);
+                        /* Ensures visibility of the stored entries.    */
+    }
+    GC_return_mark_stack(low, high);
+}
+
+/* Pop the newest entry of the deque of the current marker to *e.       */
+/* Return FALSE if the deque is empty.                                  */
+STATIC GC_bool GC_pop_from_deque(struct mark_deque *d, mse *e)
+{
+    AO_t b = d -> bottom - 1;
+    AO_t t;
+
+    AO_store(&(d -> bottom), b);
+    AO_nop_full(); /* The thieves see the new bottom or we see their top. */
+    t = AO_load(&(d -> top));
+    if ((signed_word)(b - t) < 0) {
+      AO_store(&(d -> bottom), t);
+      return FALSE;
+    }
+    *e = d -> entries[b & (MARK_DEQUE_SIZE - 1)];
+    if (b == t) {
+      /* The last entry; a thief could be taking it concurrently.       */
+      GC_bool taken = AO_compare_and_swap_full(&(d -> top), t, t + 1);
+
+      AO_store(&(d -> bottom), t + 1);
+      return taken;
+    }
+    return TRUE;
+}
+
+/* Steal the oldest entry of the deque of another marker to *e.         */
+/* Return FALSE if the deque is empty or another thread has taken the   */
+/* entry first.  If node is nonnegative (in the NUMA mode) then an      */
+/* entry for an object on another node is left in place (FALSE is       */
+/* returned too).                                                       */
+STATIC GC_bool GC_steal_from_deque(struct mark_deque *d, mse *e, int node)
+{
+    AO_t t = AO_load_acquire(&(d -> top));
+    AO_t b;
+
+    AO_nop_full();
+    b = AO_load_acquire(&(d -> bottom));
+    if ((signed_word)(b - t) <= 0) return FALSE;
+    /* The entry could not be overwritten by the owner unless top is    */
+    /* incremented, which is detected by the CAS.                       */
+    *e = d -> entries[t & (MARK_DEQUE_SIZE - 1)];
+#   ifdef USE_NUMA
+      if (node >= 0) {
+        int obj_node = GC_numa_node_of(e -> mse_start);
+
+        if (obj_node >= 0 && obj_node != node) return FALSE;
+      }
+#   else
+      (void)node;
+#   endif
+    return AO_compare_and_swap_full(&(d -> top), t, t + 1);
 }
 
 /* Mark from the local mark stack.              */
 /* On return, the local mark stack is empty.    */
-/* But this may be achieved by copying the      */
-/* local mark stack back into the global one.   */
-STATIC void GC_do_local_mark(mse *local_mark_stack, mse *local_top)
+/* But this may be achieved by moving a part of */
+/* it to the deque d of the marker (or to the   */
+/* global mark stack).                          */
+STATIC void GC_do_local_mark(mse *local_mark_stack, mse *local_top,
+                             struct mark_deque *d)
 {
-    unsigned n;
-#   define N_LOCAL_ITERS 1
-
 #   ifdef GC_ASSERTIONS
       /* Make sure we don't hold mark lock. */
         GC_acquire_mark_lock();
         GC_release_mark_lock();
 #   endif
     for (;;) {
-        for (n = 0; n < N_LOCAL_ITERS; ++n) {
-            local_top = GC_mark_from(local_top, local_mark_stack,
-                                     local_mark_stack + LOCAL_MARK_STACK_SIZE);
-            if ((word)local_top < (word)local_mark_stack) return;
-            if ((word)(local_top - local_mark_stack)
-                        >= LOCAL_MARK_STACK_SIZE / 2) {
-                GC_return_mark_stack(local_mark_stack, local_top);
-                return;
-            }
-        }
-        if ((word)AO_load((volatile AO_t *)&GC_mark_stack_top)
-            < (word)AO_load(&GC_first_nonempty)
-            && GC_active_count < GC_helper_count
-            && (word)local_top > (word)(local_mark_stack + 1)) {
-            /* Try to share the load, since the main stack is empty,    */
-            /* and helper threads are waiting for a refill.             */
-            /* The entries near the bottom of the stack are likely      */
-            /* to require more work.  Thus we return those, eventhough  */
-            /* it's harder.                                             */
+        local_top = GC_mark_from(local_top, local_mark_stack,
+                                 local_mark_stack + LOCAL_MARK_STACK_SIZE);
+        if ((word)local_top < (word)local_mark_stack) return;
+        if ((word)(local_top - local_mark_stack)
+                >= LOCAL_MARK_STACK_SIZE / 2
+            || ((word)local_top > (word)(local_mark_stack + 1)
+                && AO_load(&GC_active_markers) < (AO_t)GC_helper_count
+                && (NULL == d || AO_load(&(d -> top)) == d -> bottom))) {
+            /* Share the load (or avoid overflowing the local stack),   */
+            /* since other markers are waiting for work and none is     */
+            /* left in our deque.  The entries near the bottom of the   */
+            /* stack are likely to require more work.  Thus we share    */
+            /* those, eventhough it's harder.                           */
             mse * new_bottom = local_mark_stack
                                 + (local_top - local_mark_stack)/2;
             GC_ASSERT((word)new_bottom > (word)local_mark_stack
                       && (word)new_bottom < (word)local_top);
-            GC_return_mark_stack(local_mark_stack, new_bottom - 1);
+            GC_push_to_deque(d, local_mark_stack, new_bottom - 1);
             memmove(local_mark_stack, new_bottom,
                     (local_top - new_bottom + 1) * sizeof(mse));
             local_top -= (new_bottom - local_mark_stack);
@@ -1010,27 +1508,117 @@ STATIC void GC_do_local_mark(mse *local_mark_stack, mse *local_top)
     }
 }
 
+/* Steal an entry from the deque of another marker (starting with the   */
+/* one next to id) to *e.  Return FALSE if there was none.  If node is  */
+/* nonnegative (in the NUMA mode) then the victims are the markers      */
+/* running on the same node first, then the entries for objects on     */
+/* the node in the deques of the others, and only then any entry.       */
+STATIC GC_bool GC_steal_mark_work(unsigned id, mse *e, int node)
+{
+    unsigned i;
+
+#   ifdef USE_NUMA
+      if (node >= 0) {
+        for (i = 1; i < GC_n_mark_deques; ++i) {
+          struct mark_deque *d = &GC_mark_deques[(id + i) % GC_n_mark_deques];
+
+          if (d -> node == node && GC_steal_from_deque(d, e, -1))
+            return TRUE;
+        }
+        for (i = 1; i < GC_n_mark_deques; ++i) {
+          struct mark_deque *d = &GC_mark_deques[(id + i) % GC_n_mark_deques];
+
+          if (d -> node != node && GC_steal_from_deque(d, e, node))
+            return TRUE;
+        }
+      }
+#   else
+      (void)node;
+#   endif
+    for (i = 1; i < GC_n_mark_deques; ++i) {
+      if (GC_steal_from_deque(&GC_mark_deques[(id + i) % GC_n_mark_deques],
+                              e, -1))
+        return TRUE;
+    }
+    return FALSE;
+}
+
+/* Is there any work (possibly already taken) for an idle marker?      */
+STATIC GC_bool GC_mark_work_visible(void)
+{
+    unsigned i;
+
+    if ((word)AO_load(&GC_first_nonempty)
+        <= (word)AO_load((volatile AO_t *)&GC_mark_stack_top))
+      return TRUE;
+    for (i = 0; i < GC_n_mark_deques; ++i) {
+      struct mark_deque *d = &GC_mark_deques[i];
+
+      if ((signed_word)(AO_load(&(d -> bottom)) - AO_load(&(d -> top))) > 0)
+        return TRUE;
+    }
+    return FALSE;
+}
+
+#ifndef MARKER_IDLE_SPINS
+# define MARKER_IDLE_SPINS 64
+#endif
+
+/* Called by a marker which has found no work.  Wait until some work    */
+/* appears (and return TRUE, the marker being active again), or until   */
+/* all the markers are idle (and return FALSE, the mark phase being     */
+/* complete).  An active marker may be the only one to create work.     */
+/* The idle markers only take it, and do that only after becoming       */
+/* active again, so there is no work left once no marker is active.     */
+STATIC GC_bool GC_wait_for_mark_work(void)
+{
+    unsigned i;
+
+    (void)AO_fetch_and_add_full(&GC_active_markers, (AO_t)(-1));
+    for (i = 0; ; ++i) {
+      if (0 == AO_load(&GC_active_markers)) return FALSE;
+      if (GC_mark_work_visible()) {
+        (void)AO_fetch_and_add_full(&GC_active_markers, 1);
+        return TRUE;
+      }
+      if (i < MARKER_IDLE_SPINS) {
+        GC_noop1(i);
+      } else {
+        GC_marker_yield();
+      }
+    }
+}
+
 #define ENTRIES_TO_GET 5
 
-/* Mark using the local mark stack until the global mark stack is empty */
-/* and there are no active workers. Update GC_first_nonempty to reflect */
-/* progress.                                                            */
+/* Mark using the local mark stack until the global mark stack and the */
+/* deques of all the markers are empty, and there are no active         */
+/* markers.  Update GC_first_nonempty to reflect progress.              */
 /* Caller does not hold mark lock.                                      */
 /* Caller has already incremented GC_helper_count.  We decrement it,    */
-/* and maintain GC_active_count.                                        */
+/* and maintain GC_active_markers.                                      */
 STATIC void GC_mark_local(mse *local_mark_stack, int id)
 {
     mse * my_first_nonempty;
+    struct mark_deque *d = (unsigned)id < GC_n_mark_deques
+                                ? &GC_mark_deques[id] : NULL;
+    GC_bool need_to_notify = FALSE;
+#   ifdef USE_NUMA
+      int node = GC_numa_nodes > 1 ? GC_numa_current_node() : -1;
+#   else
+      int node = -1;
+#   endif
 
-    GC_acquire_mark_lock();
-    GC_active_count++;
+#   ifdef USE_NUMA
+      if (d != NULL) d -> node = node;
+#   endif
+    (void)AO_fetch_and_add_full(&GC_active_markers, 1);
     my_first_nonempty = (mse *)AO_load(&GC_first_nonempty);
     GC_ASSERT((word)AO_load(&GC_first_nonempty) >= (word)GC_mark_stack &&
         (word)AO_load(&GC_first_nonempty) <=
             (word)AO_load((volatile AO_t *)&GC_mark_stack_top) + sizeof(mse));
     if (GC_print_stats == VERBOSE)
         GC_log_printf("Starting mark helper %lu\n", (unsigned long)id);
-    GC_release_mark_lock();
     for (;;) {
         size_t n_on_stack;
         unsigned n_to_get;
@@ -1059,66 +1647,41 @@ STATIC void GC_mark_local(mse *local_mark_stack, int id)
         /* is less.  But that would require using atomic updates. */
         my_top = (mse *)AO_load_acquire((volatile AO_t *)(&GC_mark_stack_top));
         n_on_stack = my_top - my_first_nonempty + 1;
-        if (0 == n_on_stack) {
-            GC_acquire_mark_lock();
-            my_top = GC_mark_stack_top;
-                /* Asynchronous modification impossible here,   */
-                /* since we hold mark lock.                     */
-            n_on_stack = my_top - my_first_nonempty + 1;
-            if (0 == n_on_stack) {
-                GC_active_count--;
-                GC_ASSERT(GC_active_count <= GC_helper_count);
-                /* Other markers may redeposit objects  */
-                /* on the stack.                                */
-                if (0 == GC_active_count) GC_notify_all_marker();
-                while (GC_active_count > 0
-                       && (word)AO_load(&GC_first_nonempty)
-                                > (word)GC_mark_stack_top) {
-                    /* We will be notified if either GC_active_count    */
-                    /* reaches zero, or if more objects are pushed on   */
-                    /* the global mark stack.                           */
-                    GC_wait_marker();
-                }
-                if (GC_active_count == 0
-                    && (word)AO_load(&GC_first_nonempty)
-                        > (word)GC_mark_stack_top) {
-                    GC_bool need_to_notify = FALSE;
-                    /* The above conditions can't be falsified while we */
-                    /* hold the mark lock, since neither                */
-                    /* GC_active_count nor GC_mark_stack_top can        */
-                    /* change.  GC_first_nonempty can only be           */
-                    /* incremented asynchronously.  Thus we know that   */
-                    /* both conditions actually held simultaneously.    */
-                    GC_helper_count--;
-                    if (0 == GC_helper_count) need_to_notify = TRUE;
-                    if (GC_print_stats == VERBOSE)
-                      GC_log_printf("Finished mark helper %lu\n",
-                                    (unsigned long)id);
-                    GC_release_mark_lock();
-                    if (need_to_notify) GC_notify_all_marker();
-                    return;
-                }
-                /* else there's something on the stack again, or        */
-                /* another helper may push something.                   */
-                GC_active_count++;
-                GC_ASSERT(GC_active_count > 0);
-                GC_release_mark_lock();
-                continue;
-            } else {
-                GC_release_mark_lock();
-            }
-        }
-        n_to_get = ENTRIES_TO_GET;
-        if (n_on_stack < 2 * ENTRIES_TO_GET) n_to_get = 1;
-        local_top = GC_steal_mark_stack(my_first_nonempty, my_top,
-                                        local_mark_stack, n_to_get,
-                                        &my_first_nonempty);
-        GC_ASSERT((word)my_first_nonempty >= (word)GC_mark_stack &&
-                  (word)my_first_nonempty <=
+        if (n_on_stack != 0) {
+            /* The global mark stack (which only grows during the mark  */
+            /* phase) is used up first.                                 */
+            n_to_get = ENTRIES_TO_GET;
+            if (n_on_stack < 2 * ENTRIES_TO_GET) n_to_get = 1;
+            local_top = GC_steal_mark_stack(my_first_nonempty, my_top,
+                                            local_mark_stack, n_to_get,
+                                            &my_first_nonempty, node);
+            GC_ASSERT((word)my_first_nonempty >= (word)GC_mark_stack &&
+                      (word)my_first_nonempty <=
                         (word)AO_load((volatile AO_t *)&GC_mark_stack_top)
                         + sizeof(mse));
-        GC_do_local_mark(local_mark_stack, local_top);
+            GC_do_local_mark(local_mark_stack, local_top, d);
+            continue;
+        }
+        if ((word)AO_load(&GC_first_nonempty) <= (word)my_top) {
+            /* GC_first_nonempty is behind our view of the stack; it    */
+            /* should be updated before we could become idle.           */
+            continue;
+        }
+        if ((d != NULL && GC_pop_from_deque(d, local_mark_stack))
+            || GC_steal_mark_work((unsigned)id, local_mark_stack, node)) {
+            GC_do_local_mark(local_mark_stack, local_mark_stack, d);
+            continue;
+        }
+        if (!GC_wait_for_mark_work()) break;
     }
+
+    GC_acquire_mark_lock();
+    GC_helper_count--;
+    if (0 == GC_helper_count) need_to_notify = TRUE;
+    if (GC_print_stats == VERBOSE)
+      GC_log_printf("Finished mark helper %lu\n", (unsigned long)id);
+    GC_release_mark_lock();
+    if (need_to_notify) GC_notify_all_marker();
 }
 
 /* Perform Parallel mark.                       */
@@ -1129,29 +1692,40 @@ STATIC void GC_do_parallel_mark(void)
 {
     mse local_mark_stack[LOCAL_MARK_STACK_SIZE];
                 /* Note: local_mark_stack is quite big (up to 128 KiB). */
+    unsigned i;
 
-    GC_acquire_mark_lock();
     GC_ASSERT(I_HOLD_LOCK());
+    if (NULL == GC_mark_deques) GC_init_mark_deques();
+    GC_acquire_mark_lock();
     /* This could be a GC_ASSERT, but it seems safer to keep it on      */
     /* all the time, especially since it's cheap.                       */
-    if (GC_help_wanted || GC_active_count != 0 || GC_helper_count != 0)
+    if (GC_help_wanted || GC_active_markers != 0 || GC_helper_count != 0)
         ABORT("Tried to start parallel mark in bad state");
     if (GC_print_stats == VERBOSE)
         GC_log_printf("Starting marking for mark phase number %lu\n",
                       (unsigned long)GC_mark_no);
+    for (i = 0; i < GC_n_mark_deques; ++i) {
+      GC_mark_deques[i].top = 0;
+      GC_mark_deques[i].bottom = 0;
+    }
     GC_first_nonempty = (AO_t)GC_mark_stack;
-    GC_active_count = 0;
     GC_helper_count = 1;
     GC_help_wanted = TRUE;
-    GC_release_mark_lock();
-    GC_notify_all_marker();
+    GC_notify_all_helpers();
         /* Wake up potential helpers.   */
+    GC_release_mark_lock();
     GC_mark_local(local_mark_stack, 0);
     GC_acquire_mark_lock();
     GC_help_wanted = FALSE;
     /* Done; clean up.  */
     while (GC_helper_count > 0) GC_wait_marker();
     /* GC_helper_count cannot be incremented while GC_help_wanted == FALSE */
+    GC_ASSERT(0 == GC_active_markers);
+#   ifdef GC_ASSERTIONS
+      for (i = 0; i < GC_n_mark_deques; ++i) {
+        GC_ASSERT(GC_mark_deques[i].top == GC_mark_deques[i].bottom);
+      }
+#   endif
     if (GC_print_stats == VERBOSE)
         GC_log_printf("Finished marking for mark phase number %lu\n",
                       (unsigned long)GC_mark_no);
@@ -1174,7 +1748,7 @@ GC_INNER void GC_help_marker(word my_mark_no)
     GC_acquire_mark_lock();
     while (GC_mark_no < my_mark_no
            || (!GC_help_wanted && GC_mark_no == my_mark_no)) {
-      GC_wait_marker();
+      GC_park_marker();
     }
     my_id = GC_helper_count;
     if (GC_mark_no != my_mark_no || my_id > (unsigned)GC_markers_m1) {
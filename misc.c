@@ -194,6 +194,58 @@ GC_API void GC_CALL GC_set_handle_fork(int value GC_ATTR_UNUSED)
 # endif
 }
 
+STATIC size_t GC_size_classes[MAX_SIZE_CLASSES] = { 0 };
+                        /* The custom size classes (the largest request */
+                        /* sizes in bytes, ascending) set by the client. */
+STATIC unsigned GC_n_size_classes = 0;
+
+/* The requests up to this size get the exact number of granules, so    */
+/* the custom size classes below it are ignored.                        */
+#define TINY_SIZE_LIMIT (GRANULES_TO_BYTES(TINY_FREELISTS-1) - EXTRA_BYTES)
+
+GC_API int GC_CALL GC_set_size_classes(const size_t *sizes, unsigned n)
+{
+    unsigned i;
+
+    if (GC_is_initialized || n > MAX_SIZE_CLASSES) return -1;
+    for (i = 0; i < n; i++) {
+      if (sizes[i] == 0 || sizes[i] > MAXOBJBYTES - MAX_EXTRA_BYTES
+          || (i > 0 && sizes[i] <= sizes[i-1]))
+        return -1;
+    }
+    for (i = 0; i < n; i++) GC_size_classes[i] = sizes[i];
+    GC_n_size_classes = n;
+    return 0;
+}
+
+/* Return the object size (in granules) of the size class for the       */
+/* requests of up to lb bytes.  As in GC_extend_size_map, we use the    */
+/* largest size fitting the same number of objects in a block.          */
+STATIC size_t GC_size_class_granules(size_t lb)
+{
+    size_t granule_sz = ROUNDED_UP_GRANULES(lb);
+
+    return HBLK_GRANULES / (HBLK_GRANULES / granule_sz);
+}
+
+/* Fill in GC_size_map above TINY_SIZE_LIMIT according to the custom    */
+/* size classes.  The rest of the array is filled in on demand.         */
+STATIC void GC_apply_size_classes(void)
+{
+    size_t low_limit = TINY_SIZE_LIMIT + 1;
+    unsigned i;
+
+    for (i = 0; i < GC_n_size_classes; i++) {
+      size_t granule_sz, byte_sz, j;
+
+      if (GC_size_classes[i] < low_limit) continue;
+      granule_sz = GC_size_class_granules(GC_size_classes[i]);
+      byte_sz = GRANULES_TO_BYTES(granule_sz) - EXTRA_BYTES;
+      for (j = low_limit; j <= byte_sz; j++) GC_size_map[j] = granule_sz;
+      low_limit = byte_sz + 1;
+    }
+}
+
 /* Set things up so that GC_size_map[i] >= granules(i),                 */
 /* but not too much bigger                                              */
 /* and so that size_map contains relatively few distinct entries        */
@@ -214,6 +266,7 @@ STATIC void GC_init_size_map(void)
 #       endif
     }
     /* We leave the rest of the array to be filled in on demand. */
+    if (GC_n_size_classes > 0) GC_apply_size_classes();
 }
 
 /* Fill in additional entries in GC_size_map, including the ith one */
@@ -267,6 +320,452 @@ GC_INNER void GC_extend_size_map(size_t i)
     for (j = low_limit; j <= byte_sz; j++) GC_size_map[j] = granule_sz;
 }
 
+GC_INNER word *GC_size_histogram = NULL;
+
+GC_API void GC_CALL GC_start_size_profiling(void)
+{
+    DCL_LOCK_STATE;
+
+    if (!EXPECT(GC_is_initialized, TRUE)) GC_init();
+    LOCK();
+    if (NULL == GC_size_histogram) {
+      word *histogram = (word *)GC_scratch_alloc((MAXOBJBYTES + 1)
+                                                 * sizeof(word));
+
+      if (histogram != NULL) {
+        BZERO(histogram, (MAXOBJBYTES + 1) * sizeof(word));
+        GC_size_histogram = histogram;
+      }
+    }
+    UNLOCK();
+    if (NULL == GC_size_histogram)
+      WARN("Failed to allocate size histogram\n", 0);
+}
+
+#ifndef SUGGESTED_SIZE_CLASSES
+# define SUGGESTED_SIZE_CLASSES 8
+#endif
+
+/* Choose (by dynamic programming) up to SUGGESTED_SIZE_CLASSES size    */
+/* classes for the recorded requests above TINY_SIZE_LIMIT minimizing   */
+/* the bytes lost to rounding, store their largest request sizes to     */
+/* classes and return their number.  Also compute the number of the     */
+/* requests and the bytes allocated and lost with the current size map  */
+/* and the suggested classes.  Called with the lock held.               */
+STATIC unsigned GC_suggest_size_classes(size_t *classes, word *pcount,
+                                        double *pbytes, double *pwaste,
+                                        double *psuggested_waste)
+{
+    size_t sizes[MAXOBJGRANULES + 1];   /* the requested object sizes   */
+                                        /* (in granules), ascending     */
+    double counts[MAXOBJGRANULES + 2];  /* the requests and the bytes   */
+    double req_bytes[MAXOBJGRANULES + 2]; /* requested in sizes[0..j-1] */
+    double cost[2][MAXOBJGRANULES + 1];
+    unsigned short first[SUGGESTED_SIZE_CLASSES][MAXOBJGRANULES + 1];
+                        /* first[k][j] is the index of the lowest size  */
+                        /* in the last of k+1 classes optimally         */
+                        /* covering sizes[0..j].                        */
+    unsigned m = 0, n_classes, i, j, k;
+    size_t lb;
+
+    *pcount = 0;
+    *pbytes = *pwaste = *psuggested_waste = 0;
+    counts[0] = req_bytes[0] = 0;
+    for (lb = TINY_SIZE_LIMIT + 1; lb <= MAXOBJBYTES - EXTRA_BYTES; lb++) {
+      word cnt = GC_size_histogram[lb];
+      size_t granule_sz;
+
+      if (0 == cnt) continue;
+      granule_sz = ROUNDED_UP_GRANULES(lb);
+      if (0 == m || sizes[m - 1] != granule_sz) {
+        sizes[m++] = granule_sz;
+        counts[m] = counts[m - 1];
+        req_bytes[m] = req_bytes[m - 1];
+      }
+      counts[m] += (double)cnt;
+      req_bytes[m] += (double)cnt * (double)lb;
+      *pcount += cnt;
+      *pbytes += (double)cnt * (double)lb;
+      if (GC_size_map[lb] != 0)
+        *pwaste += (double)cnt
+                   * (double)(GRANULES_TO_BYTES(GC_size_map[lb]) - lb);
+    }
+    if (0 == m) return 0;
+
+    /* The bytes lost if sizes[i..j] form a class.      */
+#   define CLASS_COST(i, j) \
+        ((counts[(j) + 1] - counts[i]) \
+         * (double)GRANULES_TO_BYTES(GC_size_class_granules( \
+                        GRANULES_TO_BYTES(sizes[j]) - EXTRA_BYTES)) \
+         - (req_bytes[(j) + 1] - req_bytes[i]))
+    n_classes = m < SUGGESTED_SIZE_CLASSES ? m : SUGGESTED_SIZE_CLASSES;
+    for (j = 0; j < m; j++) {
+      cost[0][j] = CLASS_COST(0, j);
+      first[0][j] = 0;
+    }
+    for (k = 1; k < n_classes; k++) {
+      double *cur = cost[k & 1];
+      double *prev = cost[(k - 1) & 1];
+
+      for (j = k; j < m; j++) {
+        cur[j] = -1;
+        for (i = k; i <= j; i++) {
+          double c = prev[i - 1] + CLASS_COST(i, j);
+
+          if (cur[j] < 0 || c < cur[j]) {
+            cur[j] = c;
+            first[k][j] = (unsigned short)i;
+          }
+        }
+      }
+    }
+#   undef CLASS_COST
+    *psuggested_waste = cost[(n_classes - 1) & 1][m - 1];
+
+    /* Recover the classes from the last one down.      */
+    for (j = m - 1, k = n_classes; k > 0; k--) {
+      classes[k - 1] = GRANULES_TO_BYTES(GC_size_class_granules(
+                                GRANULES_TO_BYTES(sizes[j]) - EXTRA_BYTES))
+                        - EXTRA_BYTES;
+      if (k > 1) j = first[k - 1][j] - 1;
+    }
+    /* Drop the classes covered entirely by the previous one.   */
+    for (i = 1, k = 1; i < n_classes; i++) {
+      if (classes[i] > classes[k - 1]) classes[k++] = classes[i];
+    }
+    return k;
+}
+
+GC_API void GC_CALL GC_print_size_profile(void)
+{
+    size_t classes[SUGGESTED_SIZE_CLASSES];
+    unsigned n, i;
+    word count;
+    double bytes, waste, suggested_waste;
+    DCL_LOCK_STATE;
+
+    if (NULL == GC_size_histogram) return;
+    LOCK();
+    n = GC_suggest_size_classes(classes, &count, &bytes, &waste,
+                                &suggested_waste);
+    UNLOCK();
+    GC_printf("Size profile: %lu requests of %lu..%lu bytes"
+              " (%lu%% lost to size class rounding)\n",
+              (unsigned long)count, (unsigned long)TINY_SIZE_LIMIT + 1,
+              (unsigned long)(MAXOBJBYTES - EXTRA_BYTES),
+              (unsigned long)(bytes > 0 ? waste * 100 / (bytes + waste) : 0));
+    if (0 == n) return;
+    GC_printf("Suggested GC_SIZE_CLASSES=");
+    for (i = 0; i < n; i++)
+      GC_printf(i > 0 ? ",%lu" : "%lu", (unsigned long)classes[i]);
+    GC_printf(" (%lu%% lost)\n",
+              (unsigned long)(suggested_waste * 100
+                              / (bytes + suggested_waste)));
+}
+
+STATIC void GC_size_profile_at_exit(void)
+{
+    GC_print_size_profile();
+}
+
+#ifdef HEAP_PROFILE
+# include <execinfo.h>
+
+# ifndef HEAP_PROFILE_FRAMES
+#   define HEAP_PROFILE_FRAMES 24       /* The deepest recorded stack.  */
+# endif
+# ifndef HEAP_PROFILE_BUCKETS
+#   define HEAP_PROFILE_BUCKETS 2048    /* Max distinct stacks (a power */
+                                        /* of two).                     */
+# endif
+# ifndef HEAP_PROFILE_SAMPLES
+#   define HEAP_PROFILE_SAMPLES 32768   /* Max samples tracked for the  */
+                                        /* live profile.                */
+# endif
+# define HEAP_PROFILE_RECHECK (1 << 16)
+                /* The countdown set while the profiling is off, so     */
+                /* that the threads notice it is started later.         */
+
+  /* The allocations sharing a stack.   */
+  struct GC_heap_prof_bucket {
+    word hpb_hash;              /* 0 if the bucket is unused.   */
+    word hpb_alloc_count;       /* The samples taken with the   */
+    word hpb_alloc_bytes;       /* stack so far...              */
+    word hpb_live_count;        /* ... and those surviving the  */
+    word hpb_live_bytes;        /* last collection.             */
+    unsigned hpb_npcs;
+    void *hpb_pcs[HEAP_PROFILE_FRAMES];
+  };
+
+  /* A sampled object not yet found unreachable.        */
+  struct GC_heap_prof_sample {
+    word hps_obj;               /* The hidden object pointer.   */
+    word hps_bytes;             /* The requested size.          */
+    struct GC_heap_prof_bucket *hps_bucket;
+  };
+
+  /* The following are protected by the allocation lock.        */
+  GC_INNER signed_word GC_heap_sample_countdown =
+                                (signed_word)(~(word)0 >> 1);
+  STATIC word GC_heap_sample_interval = 0;  /* 0 if profiling is off.  */
+  STATIC word GC_heap_sample_seed = 0;
+  STATIC struct GC_heap_prof_bucket *GC_heap_prof_buckets = NULL;
+  STATIC unsigned GC_heap_prof_n_buckets = 0;
+  STATIC struct GC_heap_prof_sample *GC_heap_prof_samples = NULL;
+  STATIC unsigned GC_heap_prof_n_samples = 0;
+  STATIC word GC_heap_prof_dropped = 0; /* Samples lost to full tables. */
+
+  GC_INNER signed_word GC_next_heap_sample(void)
+  {
+    word r, e, log2_r;
+
+    GC_ASSERT(I_HOLD_LOCK());
+    if (0 == GC_heap_sample_interval) return HEAP_PROFILE_RECHECK;
+    /* xorshift64 (xorshift32 on 32-bit targets).       */
+    r = GC_heap_sample_seed;
+#   if CPP_WORDSZ == 64
+      r ^= r << 13;
+      r ^= r >> 7;
+      r ^= r << 17;
+#   else
+      r ^= r << 13;
+      r ^= r >> 17;
+      r ^= r << 5;
+#   endif
+    GC_heap_sample_seed = r;
+    /* The distance is -ln(u) * interval for u uniform in (0, 1].  We   */
+    /* take u = r / 2**26 and approximate log2(r) (in 16.16 fixed       */
+    /* point) linearly between the powers of two, as the exact          */
+    /* distribution is not important.                                   */
+    r = (r >> (CPP_WORDSZ - 26)) + 1;
+    for (e = 0; (r >> (e + 1)) != 0; e++) {}
+    log2_r = (e << 16) + ((e >= 16 ? r >> (e - 16) : r << (16 - e))
+                          & 0xffff);
+    return (signed_word)((double)(((word)26 << 16) - log2_r)
+                         * (0.6931472 / 65536)
+                         * (double)GC_heap_sample_interval) + 1;
+  }
+
+  /* Find or create the bucket for the stack.  Called with the lock     */
+  /* held.  Returns NULL if the table is full.                          */
+  STATIC struct GC_heap_prof_bucket *GC_heap_prof_bucket(void **pcs,
+                                                         unsigned npcs)
+  {
+    word hash = 0;
+    unsigned i, j;
+
+    for (i = 0; i < npcs; i++) {
+      hash += (word)pcs[i];
+      hash ^= hash >> 7;
+      hash *= 0x9e3779b1;
+    }
+    if (0 == hash) hash = 1;
+    for (i = (unsigned)(hash ^ (hash >> 16)) & (HEAP_PROFILE_BUCKETS - 1);;
+         i = (i + 1) & (HEAP_PROFILE_BUCKETS - 1)) {
+      struct GC_heap_prof_bucket *b = &GC_heap_prof_buckets[i];
+
+      if (0 == b -> hpb_hash) {
+        if (GC_heap_prof_n_buckets >= HEAP_PROFILE_BUCKETS / 4 * 3)
+          return NULL;
+        GC_heap_prof_n_buckets++;
+        b -> hpb_hash = hash;
+        b -> hpb_npcs = npcs;
+        for (j = 0; j < npcs; j++) b -> hpb_pcs[j] = pcs[j];
+        return b;
+      }
+      if (b -> hpb_hash == hash && b -> hpb_npcs == npcs) {
+        for (j = 0; j < npcs && b -> hpb_pcs[j] == pcs[j]; j++) {}
+        if (j == npcs) return b;
+      }
+    }
+  }
+
+  GC_INNER void GC_sample_alloc(void *op, size_t lb,
+                                signed_word *countdown)
+  {
+    void *pcs[HEAP_PROFILE_FRAMES + 1];
+    int npcs = 0;
+    DCL_LOCK_STATE;
+
+    /* The stack is taken without the lock, checking whether the        */
+    /* profiling is on without it is harmless.                          */
+    if (0 == GC_heap_sample_interval) {
+      /* Just the thread-local countdown to restart.    */
+      if (countdown != NULL) *countdown = HEAP_PROFILE_RECHECK;
+      return;
+    }
+    if (op != NULL)
+      npcs = backtrace(pcs, HEAP_PROFILE_FRAMES + 1);
+    LOCK();
+    if (countdown != NULL) *countdown = GC_next_heap_sample();
+    if (npcs > 1 && GC_heap_prof_buckets != NULL) {
+      /* Omit our own frame.    */
+      struct GC_heap_prof_bucket *b =
+                        GC_heap_prof_bucket(pcs + 1, (unsigned)npcs - 1);
+
+      if (NULL == b) {
+        GC_heap_prof_dropped++;
+      } else {
+        b -> hpb_alloc_count++;
+        b -> hpb_alloc_bytes += lb;
+        if (GC_heap_prof_n_samples < HEAP_PROFILE_SAMPLES) {
+          struct GC_heap_prof_sample *s =
+                        &GC_heap_prof_samples[GC_heap_prof_n_samples++];
+
+          s -> hps_obj = GC_HIDE_POINTER(op);
+          s -> hps_bytes = lb;
+          s -> hps_bucket = b;
+          b -> hpb_live_count++;
+          b -> hpb_live_bytes += lb;
+        } else {
+          GC_heap_prof_dropped++;
+        }
+      }
+    }
+    UNLOCK();
+  }
+
+  GC_INNER void GC_heap_profile_update_live(void)
+  {
+    unsigned i, n = 0;
+
+    GC_ASSERT(I_HOLD_LOCK());
+    for (i = 0; i < GC_heap_prof_n_samples; i++) {
+      struct GC_heap_prof_sample *s = &GC_heap_prof_samples[i];
+      ptr_t p = (ptr_t)GC_REVEAL_POINTER(s -> hps_obj);
+      hdr *hhdr = HDR(p);
+
+      /* The object might have been explicitly deallocated (and its     */
+      /* block reused) since it was sampled.                            */
+      if (hhdr != NULL && !HBLK_IS_FREE(hhdr) && GC_base(p) == p
+          && GC_is_marked(p)) {
+        GC_heap_prof_samples[n++] = *s;
+      } else {
+        s -> hps_bucket -> hpb_live_count--;
+        s -> hps_bucket -> hpb_live_bytes -= s -> hps_bytes;
+      }
+    }
+    GC_heap_prof_n_samples = n;
+  }
+#endif /* HEAP_PROFILE */
+
+GC_API int GC_CALL GC_start_heap_profiling(size_t sample_interval)
+{
+# ifdef HEAP_PROFILE
+    int result = GC_SUCCESS;
+    DCL_LOCK_STATE;
+
+    if (!EXPECT(GC_is_initialized, TRUE)) GC_init();
+    if (0 == sample_interval) sample_interval = 512 * 1024;
+    LOCK();
+    if (NULL == GC_heap_prof_buckets) {
+      GC_heap_prof_buckets = (struct GC_heap_prof_bucket *)GC_scratch_alloc(
+                HEAP_PROFILE_BUCKETS * sizeof(struct GC_heap_prof_bucket));
+      GC_heap_prof_samples = (struct GC_heap_prof_sample *)GC_scratch_alloc(
+                HEAP_PROFILE_SAMPLES * sizeof(struct GC_heap_prof_sample));
+      if (NULL == GC_heap_prof_buckets || NULL == GC_heap_prof_samples) {
+        GC_heap_prof_buckets = NULL;
+        result = GC_NO_MEMORY;
+      } else {
+        BZERO(GC_heap_prof_buckets,
+              HEAP_PROFILE_BUCKETS * sizeof(struct GC_heap_prof_bucket));
+      }
+    }
+    if (GC_SUCCESS == result) {
+      if (0 == GC_heap_sample_seed)
+        GC_heap_sample_seed = ((word)&result ^ (word)GC_heap_prof_buckets
+                               ^ 0x2545f491) | 1;
+      GC_heap_sample_interval = (word)sample_interval;
+      GC_heap_sample_countdown = GC_next_heap_sample();
+    }
+    UNLOCK();
+    return result;
+# else
+    (void)sample_interval;
+    return GC_UNIMPLEMENTED;
+# endif
+}
+
+GC_API int GC_CALL GC_dump_heap_profile(const char *file_name)
+{
+# ifdef HEAP_PROFILE
+    FILE *f;
+    word live_count = 0, live_bytes = 0, alloc_count = 0, alloc_bytes = 0;
+    unsigned i, j;
+    int res;
+    DCL_LOCK_STATE;
+
+    if (NULL == GC_heap_prof_buckets) return GC_NOT_FOUND;
+    f = fopen(file_name, "w");
+    if (NULL == f) return -1;
+    LOCK();
+    for (i = 0; i < HEAP_PROFILE_BUCKETS; i++) {
+      struct GC_heap_prof_bucket *b = &GC_heap_prof_buckets[i];
+
+      live_count += b -> hpb_live_count;
+      live_bytes += b -> hpb_live_bytes;
+      alloc_count += b -> hpb_alloc_count;
+      alloc_bytes += b -> hpb_alloc_bytes;
+    }
+    /* The legacy text format of the pprof tools; the counts are those  */
+    /* of the samples, the tools scale them up by the interval.         */
+    fprintf(f, "heap profile: %lu: %lu [%lu: %lu] @ heap_v2/%lu\n",
+            (unsigned long)live_count, (unsigned long)live_bytes,
+            (unsigned long)alloc_count, (unsigned long)alloc_bytes,
+            (unsigned long)GC_heap_sample_interval);
+    for (i = 0; i < HEAP_PROFILE_BUCKETS; i++) {
+      struct GC_heap_prof_bucket *b = &GC_heap_prof_buckets[i];
+
+      if (0 == b -> hpb_alloc_count) continue;
+      fprintf(f, "%lu: %lu [%lu: %lu] @",
+              (unsigned long)b -> hpb_live_count,
+              (unsigned long)b -> hpb_live_bytes,
+              (unsigned long)b -> hpb_alloc_count,
+              (unsigned long)b -> hpb_alloc_bytes);
+      for (j = 0; j < b -> hpb_npcs; j++)
+        fprintf(f, " %p", b -> hpb_pcs[j]);
+      fprintf(f, "\n");
+    }
+    UNLOCK();
+    if (GC_heap_prof_dropped > 0)
+      WARN("Heap profile lacks %" WARN_PRIdPTR " samples (tables full)\n",
+           (signed_word)GC_heap_prof_dropped);
+#   ifdef LINUX
+      /* Let the tools map the addresses to the symbols.        */
+      {
+        FILE *maps = fopen("/proc/self/maps", "r");
+
+        fprintf(f, "\nMAPPED_LIBRARIES:\n");
+        if (maps != NULL) {
+          char buf[4096];
+          size_t len;
+
+          while ((len = fread(buf, 1, sizeof(buf), maps)) > 0)
+            (void)fwrite(buf, 1, len, f);
+          fclose(maps);
+        }
+      }
+#   endif
+    res = ferror(f) ? -1 : GC_SUCCESS;
+    if (fclose(f) != 0) res = -1;
+    return res;
+# else
+    (void)file_name;
+    return GC_UNIMPLEMENTED;
+# endif
+}
+
+#ifdef HEAP_PROFILE
+  STATIC void GC_heap_profile_at_exit(void)
+  {
+    char *file_name = GETENV("GC_HEAP_PROFILE_FILE");
+
+    if (GC_dump_heap_profile(file_name != NULL ? file_name
+                                               : "gc-heap.prof") != 0)
+      WARN("Failed to write heap profile\n", 0);
+  }
+#endif
+
 
 /*
  * The following is a gross hack to deal with a problem that can occur
@@ -474,6 +973,36 @@ GC_API size_t GC_CALL GC_get_unmapped_bytes(void)
     return (size_t)GC_unmapped_bytes;
 }
 
+GC_API int GC_CALL GC_start_scavenger(unsigned interval_ms, unsigned age,
+                                      GC_word target_rss)
+{
+#   ifdef CAN_START_SCAVENGER
+      int code;
+      DCL_LOCK_STATE;
+
+      if (!EXPECT(GC_is_initialized, TRUE)) GC_init();
+      GC_need_to_lock = TRUE; /* the scavenger competes for the lock */
+      LOCK();
+      code = GC_start_scavenger_inner(interval_ms, age, (word)target_rss);
+      UNLOCK();
+      return code;
+#   else
+      (void)interval_ms;
+      (void)age;
+      (void)target_rss;
+      return -1; /* not supported */
+#   endif
+}
+
+GC_API GC_word GC_CALL GC_get_scavenged_bytes(void)
+{
+#   ifdef USE_MUNMAP
+      return GC_scavenged_bytes;
+#   else
+      return 0;
+#   endif
+}
+
 GC_API size_t GC_CALL GC_get_bytes_since_gc(void)
 {
     return (size_t)GC_bytes_allocd;
@@ -529,6 +1058,25 @@ GC_API void GC_CALL GC_get_heap_usage_safe(GC_word *pheap_size,
     pstats->bytes_reclaimed_since_gc = GC_bytes_found > 0 ?
                                         (word)GC_bytes_found : 0;
     pstats->reclaimed_bytes_before_gc = GC_reclaimed_bytes_before_gc;
+#   ifdef USE_MUNMAP
+      pstats->scavenged_bytes = GC_scavenged_bytes;
+#   else
+      pstats->scavenged_bytes = 0;
+#   endif
+#   ifdef USE_MREMAP_REALLOC
+      pstats->realloc_moved_bytes = GC_realloc_moved_bytes;
+#   else
+      pstats->realloc_moved_bytes = 0;
+#   endif
+#   ifdef THREAD_LOCAL_ALLOC
+      pstats->tl_refills = GC_tl_locked_refills + GC_tl_lockless_refills;
+      pstats->tl_locked_refills = GC_tl_locked_refills;
+      pstats->tl_stranded_bytes = GC_tl_stranded_bytes;
+#   else
+      pstats->tl_refills = 0;
+      pstats->tl_locked_refills = 0;
+      pstats->tl_stranded_bytes = 0;
+#   endif
   }
 
 # include <string.h> /* for memset() */
@@ -579,6 +1127,106 @@ GC_API void GC_CALL GC_get_heap_usage_safe(GC_word *pheap_size,
 
 #endif /* !GC_GET_HEAP_USAGE_NOT_NEEDED */
 
+#ifndef SMALL_CONFIG
+# include <string.h> /* for memset() */
+
+  /* Fill in the statistics of a size class.  Called with the lock held. */
+  static void fill_class_stats(unsigned kind, size_t lg,
+                               struct GC_size_class_stats_s *pstats)
+  {
+    struct GC_class_stats_s *cs = &GC_class_stats[kind][lg];
+    word n = 0;
+
+    pstats -> bytes_allocd_since_gc = cs -> cs_bytes_allocd;
+    pstats -> live_bytes = cs -> cs_live_bytes;
+    pstats -> blocks = cs -> cs_blocks;
+    if (lg > 0) {
+      ptr_t q = (ptr_t)GC_obj_kinds[kind].ok_freelist[lg];
+
+      for (; q != NULL; q = (ptr_t)obj_link(q)) n++;
+    }
+    pstats -> free_list_len = n;
+    pstats -> nearly_full_blocks = cs -> cs_nearly_full_blocks;
+  }
+#endif /* !SMALL_CONFIG */
+
+GC_API size_t GC_CALL GC_get_size_class_stats(int kind, size_t granules,
+                                        struct GC_size_class_stats_s *pstats,
+                                        size_t stats_sz)
+{
+# ifndef SMALL_CONFIG
+    struct GC_size_class_stats_s stats;
+    DCL_LOCK_STATE;
+
+    LOCK();
+    if (kind < 0 || (unsigned)kind >= GC_n_kinds
+        || granules > MAXOBJGRANULES) {
+      UNLOCK();
+      return 0;
+    }
+    fill_class_stats((unsigned)kind, granules, &stats);
+    UNLOCK();
+
+    if (stats_sz >= sizeof(stats)) {
+      BCOPY(&stats, pstats, sizeof(stats));
+      if (stats_sz > sizeof(stats))
+        memset((char *)pstats + sizeof(stats), 0xff,
+               stats_sz - sizeof(stats));
+      return sizeof(stats);
+    } else {
+      BCOPY(&stats, pstats, stats_sz);
+      return stats_sz;
+    }
+# else
+    (void)kind;
+    (void)granules;
+    (void)pstats;
+    (void)stats_sz;
+    return 0;
+# endif
+}
+
+#ifndef SMALL_CONFIG
+  /* Print the statistics of the size classes in use.  Called with the  */
+  /* lock held.                                                         */
+  STATIC void GC_print_class_stats_inner(void)
+  {
+    unsigned kind;
+    size_t lg;
+
+    GC_printf("(kind:size_in_bytes, bytes_allocd, live_bytes, blocks,"
+              " free_list_len, nearly_full_blocks; size 0 for large)\n");
+    for (kind = 0; kind < GC_n_kinds; kind++) {
+      for (lg = 0; lg <= MAXOBJGRANULES; lg++) {
+        struct GC_size_class_stats_s stats;
+
+        fill_class_stats(kind, lg, &stats);
+        if (0 == stats.blocks && 0 == stats.bytes_allocd_since_gc
+            && 0 == stats.free_list_len)
+          continue;
+        GC_printf("%u:%lu, %lu, %lu, %lu, %lu, %lu\n", kind,
+                  (unsigned long)GRANULES_TO_BYTES(lg),
+                  (unsigned long)stats.bytes_allocd_since_gc,
+                  (unsigned long)stats.live_bytes,
+                  (unsigned long)stats.blocks,
+                  (unsigned long)stats.free_list_len,
+                  (unsigned long)stats.nearly_full_blocks);
+      }
+    }
+  }
+#endif /* !SMALL_CONFIG */
+
+GC_API void GC_CALL GC_print_size_class_stats(void)
+{
+# ifndef SMALL_CONFIG
+    DCL_LOCK_STATE;
+
+    LOCK();
+    GC_print_class_stats_inner();
+    UNLOCK();
+# endif
+}
+
 #if defined(GC_DARWIN_THREADS) || defined(GC_OPENBSD_THREADS) \
     || defined(GC_WIN32_THREADS) || (defined(NACL) && defined(THREADS))
   /* GC does not use signals to suspend and restart threads.    */
@@ -929,6 +1577,9 @@ GC_API void GC_CALL GC_init(void)
     if (0 != GETENV("GC_DONT_GC")) {
       GC_dont_gc = 1;
     }
+    if (0 != GETENV("GC_CHECK_REGIONS")) {
+      GC_check_regions = TRUE;
+    }
     if (0 != GETENV("GC_PRINT_BACK_HEIGHT")) {
       GC_print_back_height = TRUE;
     }
@@ -1002,6 +1653,20 @@ GC_API void GC_CALL GC_init(void)
             GC_free_space_divisor = (GC_word)space_divisor;
         }
     }
+#   ifdef PREFETCH_FIFO
+      {
+        char * string = GETENV("GC_PREFETCH_FIFO_DEPTH");
+        if (string != NULL) {
+          int depth = atoi(string);
+          if (depth < 0 || depth >= PREFETCH_FIFO_SIZE) {
+            WARN("GC_PREFETCH_FIFO_DEPTH environment variable has "
+                 "bad value: Ignoring\n", 0);
+          } else {
+            GC_prefetch_fifo_depth = (unsigned)depth;
+          }
+        }
+      }
+#   endif
 #   ifdef USE_MUNMAP
       {
         char * string = GETENV("GC_UNMAP_THRESHOLD");
@@ -1027,6 +1692,13 @@ GC_API void GC_CALL GC_init(void)
           }
         }
       }
+#     ifdef USE_MADVISE_UNMAP
+        {
+          char * string = GETENV("GC_MADV_FREE");
+          if (string != NULL)
+            GC_madv_free = (*string != '0' || *(string + 1) != '\0');
+        }
+#     endif
       {
         char * string = GETENV("GC_USE_ENTIRE_HEAP");
         if (string != NULL) {
@@ -1038,6 +1710,28 @@ GC_API void GC_CALL GC_init(void)
           }
         }
       }
+#   endif
+#   ifdef USE_HUGE_PAGES
+      {
+        char * string = GETENV("GC_HUGE_PAGES");
+        if (string != NULL) {
+          int mode = atoi(string);
+          if (mode >= 0 && mode <= 2)
+            GC_huge_pages = mode;
+        }
+      }
+#   endif
+#   ifdef USE_NUMA
+      {
+        char * string = GETENV("GC_NUMA");
+        if (NULL == string || atoi(string) != 0)
+          GC_numa_init();
+      }
+#   endif
+#   ifdef PER_CPU_ALLOC
+      if (0 != GETENV("GC_NO_PER_CPU_ALLOC")) {
+        GC_no_per_cpu_alloc = TRUE;
+      }
 #   endif
     maybe_install_looping_handler();
     /* Adjust normal object descriptor for extra allocation.    */
@@ -1146,7 +1840,31 @@ GC_API void GC_CALL GC_init(void)
         GC_register_displacement_inner(sizeof(void *));
       }
 #   endif
+    {
+      char * sc_string = GETENV("GC_SIZE_CLASSES");
+
+      if (sc_string != NULL) {
+        size_t sizes[MAX_SIZE_CLASSES];
+        unsigned n = 0;
+        const char *p = sc_string;
+
+        while (*p >= '0' && *p <= '9' && n < MAX_SIZE_CLASSES) {
+          size_t lb = 0;
+
+          do {
+            lb = lb * 10 + (size_t)(*p++ - '0');
+          } while (*p >= '0' && *p <= '9' && lb <= MAXOBJBYTES);
+          sizes[n++] = lb;
+          if (*p == ',') p++;
+        }
+        if (*p != '\0' || GC_set_size_classes(sizes, n) != 0)
+          WARN("Bad size classes %s - ignoring them.\n", sc_string);
+      }
+    }
     GC_init_size_map();
+#   ifdef SIMD_MARK_KERNELS
+      GC_init_mark_kernels();
+#   endif
 #   ifdef PCR
       if (PCR_IL_Lock(PCR_Bool_false, PCR_allSigsBlocked, PCR_waitForever)
           != PCR_ERes_okay) {
@@ -1182,6 +1900,48 @@ GC_API void GC_CALL GC_init(void)
         GC_init_parallel();
 #   endif /* PARALLEL_MARK || THREAD_LOCAL_ALLOC */
 
+#   ifdef CAN_START_SCAVENGER
+      {
+        char * string = GETENV("GC_SCAVENGE_INTERVAL");
+        if (string != NULL) {
+          int interval_ms = atoi(string);
+          unsigned age = (unsigned)GC_unmap_threshold;
+          word target_rss = 0;
+
+          string = GETENV("GC_SCAVENGE_AGE");
+          if (string != NULL) age = (unsigned)atoi(string);
+          string = GETENV("GC_SCAVENGE_TARGET_RSS");
+          if (string != NULL) target_rss = GC_parse_mem_size_arg(string);
+          /* GC_init may be called with the allocation lock held (but  */
+          /* not really acquired yet), thus GC_start_scavenger is not   */
+          /* used.  Until another thread is created, the scavenger      */
+          /* passes are done by the block allocations.                  */
+          if (interval_ms > 0
+              && GC_start_scavenger_inner((unsigned)interval_ms, age,
+                                          target_rss) != 0)
+            WARN("Failed to start scavenger thread\n", 0);
+        }
+      }
+#   endif
+    if (0 != GETENV("GC_PROFILE_SIZES")) {
+      GC_start_size_profiling();
+      atexit(GC_size_profile_at_exit);
+    }
+#   ifdef HEAP_PROFILE
+      {
+        char *string = GETENV("GC_HEAP_PROFILE");
+
+        if (string != NULL) {
+          if (GC_start_heap_profiling((size_t)GC_parse_mem_size_arg(string))
+              == GC_SUCCESS) {
+            atexit(GC_heap_profile_at_exit);
+          } else {
+            WARN("Failed to start heap profiling\n", 0);
+          }
+        }
+      }
+#   endif
+
 #   if defined(DYNAMIC_LOADING) && defined(DARWIN)
         /* This must be called WITHOUT the allocation lock held */
         /* and before any threads are created.                  */
@@ -1829,6 +2589,10 @@ GC_API void * GC_CALL GC_do_blocking(GC_fn_type fn, void * client_data)
     GC_print_hblkfreelist();
     GC_printf("\n***Blocks in use:\n");
     GC_print_block_list();
+#   ifndef SMALL_CONFIG
+      GC_printf("\n***Size classes:\n");
+      GC_print_class_stats_inner();
+#   endif
   }
 #endif /* !NO_DEBUGGING */
 
@@ -1848,6 +2612,15 @@ GC_API GC_word GC_CALL GC_get_gc_no(void)
     /* GC_parallel is initialized at start-up.  */
     return GC_parallel;
   }
+
+# if !defined(PARALLEL_MARK) || !defined(GC_PTHREADS) \
+     || defined(GC_WIN32_THREADS)
+    /* The marker pool is not resizable (see pthread_support.c).        */
+    GC_API int GC_CALL GC_set_markers_count(int markers GC_ATTR_UNUSED)
+    {
+      return GC_parallel + 1;
+    }
+# endif
 #endif
 
 /* Setter and getter functions for the public R/W function variables.   */
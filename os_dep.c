@@ -703,6 +703,10 @@ struct o32_obj {
 /* Find the page size */
 GC_INNER word GC_page_size = 0;
 
+#ifdef USE_HUGE_PAGES
+  GC_INNER int GC_huge_pages = 1;
+#endif
+
 #if defined(MSWIN32) || defined(MSWINCE) || defined(CYGWIN32)
 # ifndef VER_PLATFORM_WIN32_CE
 #   define VER_PLATFORM_WIN32_CE 3
@@ -2075,6 +2079,63 @@ void GC_register_data_segments(void)
   extern char* GC_get_private_path_and_zero_file(void);
 #endif
 
+#ifdef USE_HUGE_PAGES
+  /* Advise the kernel to back the given range with transparent huge    */
+  /* pages.  Failure is not fatal, e.g. THP may be disabled.            */
+  GC_INLINE void GC_advise_huge_pages(ptr_t start, size_t len)
+  {
+#   ifdef MADV_HUGEPAGE
+      if (madvise(start, len, MADV_HUGEPAGE) != 0 && GC_print_stats)
+        GC_log_printf("madvise(MADV_HUGEPAGE) failed at %p with errno %d\n",
+                      start, errno);
+#   endif
+  }
+
+  /* Get a HUGE_PAGE_SIZE-aligned chunk of memory of the given size     */
+  /* (which is a multiple of HUGE_PAGE_SIZE).  MAP_HUGETLB is tried     */
+  /* first if requested; it needs huge pages reserved by the admin.     */
+  STATIC ptr_t GC_unix_mmap_get_huge_mem(word bytes)
+  {
+    static ptr_t last_addr = HEAP_START;
+    ptr_t result;
+    ptr_t aligned;
+    word slop;
+
+#   ifdef MAP_HUGETLB
+      if (GC_huge_pages > 1) {
+        void *p = mmap(last_addr, bytes, (PROT_READ | PROT_WRITE)
+                                    | (GC_pages_executable ? PROT_EXEC : 0),
+                       MAP_PRIVATE | OPT_MAP_ANON | MAP_HUGETLB,
+                       zero_fd, 0/* offset */);
+
+        if (p != MAP_FAILED) {
+          GC_ASSERT(((word)p & (HUGE_PAGE_SIZE - 1)) == 0);
+          last_addr = (ptr_t)p + bytes;
+          return (ptr_t)p;
+        }
+        if (GC_print_stats)
+          GC_log_printf("mmap(MAP_HUGETLB) failed, using THP instead\n");
+        GC_huge_pages = 1; /* don't try again */
+      }
+#   endif
+    /* Over-allocate by a huge page, and trim both ends.  */
+    result = mmap(last_addr, bytes + HUGE_PAGE_SIZE, (PROT_READ | PROT_WRITE)
+                                    | (GC_pages_executable ? PROT_EXEC : 0),
+                  MAP_PRIVATE | OPT_MAP_ANON, zero_fd, 0/* offset */);
+    if (result == MAP_FAILED) return(0);
+    aligned = (ptr_t)(((word)result + HUGE_PAGE_SIZE - 1)
+                      & ~(word)(HUGE_PAGE_SIZE - 1));
+    slop = (word)(aligned - result);
+    if (slop != 0)
+      (void)munmap(result, slop);
+    if (slop != HUGE_PAGE_SIZE)
+      (void)munmap(aligned + bytes, HUGE_PAGE_SIZE - slop);
+    GC_advise_huge_pages(aligned, bytes);
+    last_addr = aligned + bytes;
+    return aligned;
+  }
+#endif /* USE_HUGE_PAGES */
+
 STATIC ptr_t GC_unix_mmap_get_mem(word bytes)
 {
     void *result;
@@ -2100,6 +2161,13 @@ STATIC ptr_t GC_unix_mmap_get_mem(word bytes)
 #   endif
 
     if (bytes & (GC_page_size - 1)) ABORT("Bad GET_MEM arg");
+#   ifdef USE_HUGE_PAGES
+      /* Heap sections (but not the small chunks requested by      */
+      /* GC_scratch_alloc) are rounded to HUGE_PAGE_SIZE.  Reserve  */
+      /* them aligned, so that they could be backed by huge pages.  */
+      if (GC_huge_pages != 0 && (bytes & (HUGE_PAGE_SIZE - 1)) == 0)
+        return GC_unix_mmap_get_huge_mem(bytes);
+#   endif
     result = mmap(last_addr, bytes, (PROT_READ | PROT_WRITE)
                                     | (GC_pages_executable ? PROT_EXEC : 0),
                   GC_MMAP_FLAGS | OPT_MAP_ANON, zero_fd, 0/* offset */);
@@ -2126,6 +2194,80 @@ STATIC ptr_t GC_unix_mmap_get_mem(word bytes)
     return((ptr_t)result);
 }
 
+#ifdef FLAT_HDR_TABLE
+# ifndef MAP_NORESERVE
+#   define MAP_NORESERVE 0
+# endif
+# ifdef MAP_ANONYMOUS
+#   define RESERVE_MAP_ANON MAP_ANONYMOUS
+# else
+#   define RESERVE_MAP_ANON MAP_ANON
+# endif
+
+  GC_INNER ptr_t GC_unix_reserve_mem(word bytes)
+  {
+    void *result = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | RESERVE_MAP_ANON | MAP_NORESERVE,
+                        -1, 0/* offset */);
+
+    if (result == MAP_FAILED) {
+      if (GC_print_stats)
+        GC_log_printf("Could not reserve %lu bytes: errno= %d\n",
+                      (unsigned long)bytes, errno);
+      return(0);
+    }
+    return((ptr_t)result);
+  }
+#endif /* FLAT_HDR_TABLE */
+
+#ifdef USE_MREMAP_REALLOC
+# ifndef MREMAP_DONTUNMAP
+#   define MREMAP_DONTUNMAP 4
+# endif
+
+  STATIC GC_bool GC_mremap_swap_failed = FALSE;
+
+  /* Exchange the pages of [src, src + bytes) and [dest, dest + bytes)  */
+  /* without copying them.  All the arguments are multiples of the page */
+  /* size.  MREMAP_DONTUNMAP (Linux 5.7+) keeps both ranges mapped all  */
+  /* the time, so that no other mmap() can land in a hole left by us.   */
+  /* The pages of dest are first moved to a reserved range (some        */
+  /* kernels accept MREMAP_DONTUNMAP only along with MREMAP_FIXED).     */
+  /* Return FALSE if the kernel refuses; the contents of dest are then  */
+  /* unspecified (but src is intact).                                   */
+  GC_INNER GC_bool GC_move_pages(ptr_t dest, ptr_t src, size_t bytes)
+  {
+    void *tmp;
+
+    if (GC_mremap_swap_failed) return FALSE;
+    tmp = mmap(NULL, bytes, PROT_NONE,
+               MAP_PRIVATE | OPT_MAP_ANON | MAP_NORESERVE, zero_fd, 0);
+    if (tmp == MAP_FAILED) return FALSE;
+    if (mremap(dest, bytes, bytes,
+               MREMAP_MAYMOVE | MREMAP_FIXED | MREMAP_DONTUNMAP, tmp)
+        == MAP_FAILED) {
+      if (GC_print_stats)
+        GC_log_printf("mremap(MREMAP_DONTUNMAP) failed with errno %d\n",
+                      errno);
+      if (errno == EINVAL) GC_mremap_swap_failed = TRUE;
+      (void)munmap(tmp, bytes);
+      return FALSE;
+    }
+    if (mremap(src, bytes, bytes,
+               MREMAP_MAYMOVE | MREMAP_FIXED | MREMAP_DONTUNMAP, dest)
+        == MAP_FAILED) {
+      (void)munmap(tmp, bytes);
+      return FALSE;
+    }
+    /* Give the old pages of dest to src; src is left with zero pages   */
+    /* if this fails, which is fine as the caller is about to free it.  */
+    if (mremap(tmp, bytes, bytes, MREMAP_MAYMOVE | MREMAP_FIXED, src)
+        == MAP_FAILED)
+      (void)munmap(tmp, bytes);
+    return TRUE;
+  }
+#endif /* USE_MREMAP_REALLOC */
+
 # endif  /* MMAP_SUPPORTED */
 
 #if defined(USE_MMAP)
@@ -2376,6 +2518,128 @@ void * os2_alloc(size_t bytes)
 # undef GC_AMIGA_AM
 #endif
 
+#ifdef USE_NUMA
+# include <errno.h>
+# include <sys/syscall.h>
+# include <unistd.h>
+
+# include <sched.h>
+
+# ifndef MPOL_PREFERRED
+#   define MPOL_PREFERRED 1
+# endif
+# ifndef NUMA_MAX_CPUS
+#   define NUMA_MAX_CPUS 1024
+# endif
+
+  GC_INNER int GC_numa_nodes = 1;
+
+  /* The node of each CPU, so that the node of the current thread is    */
+  /* found with sched_getcpu() (served by the vDSO) rather than with a  */
+  /* getcpu system call.                                                */
+  STATIC unsigned char GC_numa_cpu_node[NUMA_MAX_CPUS];
+
+  /* Record node for the CPUs of the list (e.g. "0-3,8-11") in buf.     */
+  static void numa_set_cpus_node(const char *buf, ssize_t len, int node)
+  {
+    ssize_t i;
+    unsigned first = 0;
+    unsigned cpu = 0;
+    GC_bool range = FALSE;
+
+    for (i = 0; i <= len; i++) {
+      if (i < len && buf[i] >= '0' && buf[i] <= '9') {
+        cpu = cpu * 10 + (unsigned)(buf[i] - '0');
+      } else if (i < len && buf[i] == '-') {
+        first = cpu;
+        cpu = 0;
+        range = TRUE;
+      } else {
+        if (!range) first = cpu;
+        if (i > 0 && buf[i - 1] >= '0' && buf[i - 1] <= '9') {
+          for (; first <= cpu && first < NUMA_MAX_CPUS; first++)
+            GC_numa_cpu_node[first] = (unsigned char)node;
+        }
+        cpu = 0;
+        range = FALSE;
+      }
+    }
+  }
+
+  /* Set GC_numa_nodes from the list of the online nodes (e.g. "0-1").  */
+  /* Leave it 1 (i.e. the NUMA mode off) if there is a single node or   */
+  /* the list cannot be read.                                           */
+  GC_INNER void GC_numa_init(void)
+  {
+    char buf[512];
+    int f = open("/sys/devices/system/node/online", O_RDONLY);
+    ssize_t len;
+    ssize_t i;
+    int node = 0;
+    int max_node = 0;
+
+    if (f < 0) return;
+    len = read(f, buf, sizeof(buf) - 1);
+    close(f);
+    for (i = 0; i < len; i++) {
+      if (buf[i] >= '0' && buf[i] <= '9') {
+        node = node * 10 + (buf[i] - '0');
+        if (node > max_node) max_node = node;
+      } else {
+        node = 0;
+      }
+    }
+    GC_numa_nodes = max_node < MAX_NUMA_NODES ? max_node + 1
+                                              : MAX_NUMA_NODES;
+    for (node = 1; node < GC_numa_nodes; node++) {
+      char path[64];
+
+      (void)sprintf(path, "/sys/devices/system/node/node%d/cpulist", node);
+      f = open(path, O_RDONLY);
+      if (f < 0) continue;
+      len = read(f, buf, sizeof(buf) - 1);
+      close(f);
+      if (len > 0) numa_set_cpus_node(buf, len, node);
+    }
+    if (GC_print_stats && GC_numa_nodes > 1)
+      GC_log_printf("NUMA mode: %d nodes\n", GC_numa_nodes);
+  }
+
+  GC_INNER int GC_numa_current_node(void)
+  {
+    int cpu = sched_getcpu();
+    unsigned node;
+
+    if (cpu >= 0 && cpu < NUMA_MAX_CPUS)
+      return GC_numa_cpu_node[cpu];
+    /* A CPU past the table (or sched_getcpu is unsupported).   */
+    if (syscall(SYS_getcpu, NULL, &node, NULL) != 0
+        || node >= (unsigned)GC_numa_nodes)
+      return 0;
+    return (int)node;
+  }
+
+  GC_INNER void GC_numa_bind(ptr_t start, size_t bytes, int node)
+  {
+    unsigned long nodemask = 1UL << node;
+    ptr_t start_addr = (ptr_t)(((word)start + GC_page_size - 1)
+                               & ~(GC_page_size - 1));
+    ptr_t end_addr = (ptr_t)((word)(start + bytes) & ~(GC_page_size - 1));
+
+    if ((word)end_addr <= (word)start_addr) return;
+    /* MPOL_PREFERRED (unlike MPOL_BIND) falls back to the other nodes  */
+    /* if the preferred one runs out of memory.                         */
+    if (syscall(SYS_mbind, start_addr, (size_t)(end_addr - start_addr),
+                MPOL_PREFERRED, &nodemask,
+                (unsigned long)(sizeof(nodemask) * 8), 0) != 0) {
+      if (GC_print_stats)
+        GC_log_printf("mbind(%p, %lu, node %d) failed with errno %d\n",
+                      start_addr, (unsigned long)(end_addr - start_addr),
+                      node, errno);
+    }
+  }
+#endif /* USE_NUMA */
+
 #ifdef USE_MUNMAP
 
 /* For now, this only works on Win32/WinCE and some Unix-like   */
@@ -2392,12 +2656,15 @@ void * os2_alloc(size_t bytes)
 /* Compute a page aligned starting address for the unmap        */
 /* operation on a block of size bytes starting at start.        */
 /* Return 0 if the block is too small to make this feasible.    */
+/* In the huge page mode, we operate on whole huge pages only.  */
 STATIC ptr_t GC_unmap_start(ptr_t start, size_t bytes)
 {
     ptr_t result;
+    word granule = HEAP_SECT_GRANULE;
+
     /* Round start to next page boundary.       */
-    result = (ptr_t)((word)(start + GC_page_size - 1) & ~(GC_page_size - 1));
-    if ((word)(result + GC_page_size) > (word)(start + bytes)) return 0;
+    result = (ptr_t)((word)(start + granule - 1) & ~(granule - 1));
+    if ((word)(result + granule) > (word)(start + bytes)) return 0;
     return result;
 }
 
@@ -2405,9 +2672,62 @@ STATIC ptr_t GC_unmap_start(ptr_t start, size_t bytes)
 /* block.                                                       */
 STATIC ptr_t GC_unmap_end(ptr_t start, size_t bytes)
 {
-    return (ptr_t)((word)(start + bytes) & ~(GC_page_size - 1));
+    return (ptr_t)((word)(start + bytes) & ~(HEAP_SECT_GRANULE - 1));
 }
 
+#ifdef USE_MADVISE_UNMAP
+  GC_INNER GC_bool GC_madv_free = TRUE;
+
+  /* Let the kernel reclaim the pages, leaving the mapping (and its     */
+  /* protection) intact.  Unlike the remapping with PROT_NONE, this     */
+  /* neither splits the mapping nor needs another call to reuse pages.  */
+  STATIC void GC_release_pages(ptr_t start, word len)
+  {
+#   ifdef MADV_FREE
+      if (GC_madv_free) {
+        if (madvise(start, len, MADV_FREE) == 0) return;
+        /* Probably, not supported by the kernel; use MADV_DONTNEED.    */
+        GC_madv_free = FALSE;
+      }
+#   endif
+    if (madvise(start, len, MADV_DONTNEED) != 0) {
+      if (GC_print_stats)
+        GC_log_printf("madvise(MADV_DONTNEED) failed at %p (length %lu)"
+                      " with errno %d\n", start, (unsigned long)len, errno);
+      ABORT("madvise(MADV_DONTNEED) failed");
+    }
+  }
+#endif /* USE_MADVISE_UNMAP */
+
+#if defined(LINUX) && defined(THREADS)
+  /* Return the resident set size of the process (in bytes), or 0 if    */
+  /* it could not be determined.                                        */
+  GC_INNER word GC_get_rss(void)
+  {
+    char buf[64];
+    int f = open("/proc/self/statm", O_RDONLY);
+    ssize_t len;
+    ssize_t i = 0;
+    word pages = 0;
+
+    if (f < 0) return 0;
+    len = read(f, buf, sizeof(buf) - 1);
+    close(f);
+    if (len <= 0) return 0;
+    /* The second field is the number of resident pages.        */
+    while (i < len && buf[i] != ' ') i++;
+    for (i++; i < len && buf[i] >= '0' && buf[i] <= '9'; i++) {
+      pages = pages * 10 + (word)(buf[i] - '0');
+    }
+    return pages * GC_page_size;
+  }
+#else
+  GC_INNER word GC_get_rss(void)
+  {
+    return 0;
+  }
+#endif
+
 /* Under Win32/WinCE we commit (map) and decommit (unmap)       */
 /* memory using VirtualAlloc and VirtualFree.  These functions  */
 /* work on individual allocations of virtual memory, made       */
@@ -2441,6 +2761,9 @@ GC_INNER void GC_unmap(ptr_t start, size_t bytes)
           start_addr += free_len;
           len -= free_len;
       }
+#   elif defined(USE_MADVISE_UNMAP)
+      GC_release_pages(start_addr, len);
+      GC_unmapped_bytes += len;
 #   else
       /* We immediately remap it to prevent an intervening mmap from    */
       /* accidentally grabbing the same address space.                  */
@@ -2490,6 +2813,10 @@ GC_INNER void GC_remap(ptr_t start, size_t bytes)
           start_addr += alloc_len;
           len -= alloc_len;
       }
+#   elif defined(USE_MADVISE_UNMAP)
+      /* The pages are still accessible; they are populated again (with */
+      /* zeros, unless MADV_FREE has not taken effect yet) on demand.    */
+      GC_unmapped_bytes -= len;
 #   else
       /* It was already remapped with PROT_NONE. */
       {
@@ -2511,6 +2838,11 @@ GC_INNER void GC_remap(ptr_t start, size_t bytes)
             ABORT("mprotect remapping failed");
           }
 #       endif /* !NACL */
+#       ifdef USE_HUGE_PAGES
+          /* The advice was lost when the range was unmapped.   */
+          if (GC_huge_pages != 0)
+            GC_advise_huge_pages(start_addr, len);
+#       endif
       }
 #     undef IGNORE_PAGES_EXECUTABLE
       GC_unmapped_bytes -= len;
@@ -2551,6 +2883,10 @@ GC_INNER void GC_unmap_gap(ptr_t start1, size_t bytes1, ptr_t start2,
           start_addr += free_len;
           len -= free_len;
       }
+#   elif defined(USE_MADVISE_UNMAP)
+      if (len != 0)
+        GC_release_pages(start_addr, len);
+      GC_unmapped_bytes += len;
 #   else
       if (len != 0) {
         /* Immediately remap as above. */
@@ -289,16 +289,51 @@ STATIC int GC_nprocs = 1;
     int i;
     GC_thread p;
 
+    GC_tl_stranded_bytes = 0;
     for (i = 0; i < THREAD_TABLE_SZ; ++i) {
       for (p = GC_threads[i]; 0 != p; p = p -> next) {
         if (!(p -> flags & FINISHED))
           GC_mark_thread_local_fls_for(&(p->tlfs));
       }
     }
+#   ifdef REMOTE_FREE
+      GC_mark_remote_free_queues();
+#   endif
+#   ifdef PER_CPU_ALLOC
+      GC_mark_cpu_freelists();
+#   endif
   }
 
+# ifndef NO_TL_HBLK_CACHE
+    GC_INNER void GC_flush_thread_local_hblks(void)
+    {
+      int i;
+      GC_thread p;
+
+      GC_ASSERT(I_HOLD_LOCK());
+#     ifdef LOCK_FREE_HBLK_CACHE
+        AO_store(&GC_tl_hblk_flushing, TRUE);
+        AO_nop_full();
+        while (AO_load(&GC_tl_hblk_users) != 0)
+          sched_yield();
+#     endif
+      for (i = 0; i < THREAD_TABLE_SZ; ++i) {
+        for (p = GC_threads[i]; 0 != p; p = p -> next) {
+          if (!(p -> flags & FINISHED))
+            GC_flush_tl_hblk_cache(&(p->tlfs));
+        }
+      }
+#     ifdef LOCK_FREE_HBLK_CACHE
+        AO_store(&GC_tl_hblk_flushing, FALSE);
+#     endif
+    }
+# endif
+
 # if defined(GC_ASSERTIONS)
     void GC_check_tls_for(GC_tlfs p);
+#   ifdef PER_CPU_ALLOC
+      void GC_check_cpu_freelists(void);
+#   endif
 #   if defined(USE_CUSTOM_SPECIFIC)
       void GC_check_tsd_marks(tsd *key);
 #   endif
@@ -316,6 +351,9 @@ STATIC int GC_nprocs = 1;
               GC_check_tls_for(&(p->tlfs));
           }
         }
+#       ifdef PER_CPU_ALLOC
+          GC_check_cpu_freelists();
+#       endif
 #       if defined(USE_CUSTOM_SPECIFIC)
           if (GC_thread_key != 0)
             GC_check_tsd_marks(GC_thread_key);
@@ -328,29 +366,95 @@ STATIC int GC_nprocs = 1;
 #ifdef PARALLEL_MARK
 
 # ifndef MAX_MARKERS
-#   define MAX_MARKERS 16
+#   define MAX_MARKERS 1024 /* Just a sanity limit; the marker pool is */
+                            /* allocated for the actual number.        */
 # endif
 
-static ptr_t marker_sp[MAX_MARKERS - 1] = {0};
-#ifdef IA64
-  static ptr_t marker_bsp[MAX_MARKERS - 1] = {0};
-#endif
+/* The marker pool.  The helper threads are created on demand (by     */
+/* GC_thr_init and GC_set_markers_count), up to GC_max_markers_m1 of  */
+/* them, and never exit.  Those of them beyond the first              */
+/* GC_markers_m1 ones are retired: they do not take part in the mark  */
+/* phase, and stay parked until the number of markers is raised.      */
+typedef struct GC_marker_s {
+  ptr_t sp;             /* The cold end of the stack.   */
+# ifdef IA64
+    ptr_t bsp;
+# endif
+# if defined(GC_DARWIN_THREADS) && !defined(GC_NO_THREADS_DISCOVERY)
+    mach_port_t mach_thread;
+# endif
+  pthread_t id;
+} *GC_marker;
 
-#if defined(GC_DARWIN_THREADS) && !defined(GC_NO_THREADS_DISCOVERY)
-  static mach_port_t marker_mach_threads[MAX_MARKERS - 1] = {0};
+STATIC GC_marker GC_markers = NULL;     /* Of GC_max_markers_m1 ones.   */
+STATIC int GC_n_mark_threads = 0;       /* Number of helper threads     */
+                                        /* created so far.              */
+STATIC int GC_requested_markers = 0;    /* Set by GC_set_markers_count  */
+                                        /* before GC_INIT.              */
 
+#if defined(GC_DARWIN_THREADS) && !defined(GC_NO_THREADS_DISCOVERY)
   /* Used only by GC_suspend_thread_list().     */
   GC_INNER GC_bool GC_is_mach_marker(thread_act_t thread)
   {
     int i;
-    for (i = 0; i < GC_markers_m1; i++) {
-      if (marker_mach_threads[i] == thread)
+    for (i = 0; i < GC_n_mark_threads; i++) {
+      if (GC_markers[i].mach_thread == thread)
         return TRUE;
     }
     return FALSE;
   }
 #endif /* GC_DARWIN_THREADS */
 
+#ifdef MARKER_FUTEX
+  /* The idle helpers park on futexes rather than on the condition      */
+  /* variable shared with the initiating thread: the helpers waiting    */
+  /* for a mark phase and the retired ones are woken separately, and    */
+  /* none of them has to reacquire a mutex on wakeup.  The futex words  */
+  /* are only updated while holding the mark lock.                      */
+# include <limits.h>
+# include <linux/futex.h>
+# include <sys/syscall.h>
+
+  static volatile unsigned GC_helpers_futex = 0;
+  static volatile unsigned GC_retired_futex = 0;
+
+  /* Wait until *addr is changed (or a spurious wakeup).  Called with   */
+  /* the mark lock held, which is released while waiting.               */
+  static void futex_park(volatile unsigned *addr)
+  {
+    unsigned seen = *addr;
+
+    GC_release_mark_lock();
+    (void)syscall(SYS_futex, (unsigned *)addr, FUTEX_WAIT_PRIVATE, seen,
+                  NULL, NULL, 0);
+    GC_acquire_mark_lock();
+  }
+
+  /* Change *addr and wake up all its waiters.  The mark lock is held.  */
+  static void futex_unpark_all(volatile unsigned *addr)
+  {
+    ++*addr;
+    (void)syscall(SYS_futex, (unsigned *)addr, FUTEX_WAKE_PRIVATE,
+                  INT_MAX, NULL, NULL, 0);
+  }
+
+  GC_INNER void GC_park_marker(void)
+  {
+    futex_park(&GC_helpers_futex);
+  }
+
+  GC_INNER void GC_notify_all_helpers(void)
+  {
+    futex_unpark_all(&GC_helpers_futex);
+  }
+
+# define PARK_RETIRED_MARKER() futex_park(&GC_retired_futex)
+# define UNPARK_RETIRED_MARKERS() futex_unpark_all(&GC_retired_futex)
+#else
+# define PARK_RETIRED_MARKER() GC_wait_marker()
+# define UNPARK_RETIRED_MARKERS() GC_notify_all_marker()
+#endif /* !MARKER_FUTEX */
+
 STATIC void * GC_mark_thread(void * id)
 {
   word my_mark_no = 0;
@@ -360,15 +464,22 @@ STATIC void * GC_mark_thread(void * id)
   DISABLE_CANCEL(cancel_state);
                          /* Mark threads are not cancellable; they      */
                          /* should be invisible to client.              */
-  marker_sp[(word)id] = GC_approx_sp();
+  GC_markers[(word)id].sp = GC_approx_sp();
 # ifdef IA64
-    marker_bsp[(word)id] = GC_save_regs_in_stack();
+    GC_markers[(word)id].bsp = GC_save_regs_in_stack();
 # endif
 # if defined(GC_DARWIN_THREADS) && !defined(GC_NO_THREADS_DISCOVERY)
-    marker_mach_threads[(word)id] = mach_thread_self();
+    GC_markers[(word)id].mach_thread = mach_thread_self();
 # endif
 
   for (;; ++my_mark_no) {
+    if ((word)id >= (word)GC_markers_m1) {
+      GC_acquire_mark_lock();
+      while ((word)id >= (word)GC_markers_m1) {
+        PARK_RETIRED_MARKER();
+      }
+      GC_release_mark_lock();
+    }
     /* GC_mark_no is passed only to allow GC_help_marker to terminate   */
     /* promptly.  This is important if it were called from the signal   */
     /* handler or from the GC lock acquisition code.  Under Linux, it's */
@@ -388,14 +499,17 @@ STATIC void * GC_mark_thread(void * id)
   }
 }
 
-STATIC pthread_t GC_mark_threads[MAX_MARKERS];
-
-static void start_mark_threads(void)
+/* Create the helper threads up to n ones in total (n should not be     */
+/* greater than GC_max_markers_m1).  Return the number of the existing  */
+/* ones, which is less than n if some creation failed.                  */
+static int start_mark_threads(int n)
 {
     int i;
     pthread_attr_t attr;
 
     GC_ASSERT(I_DONT_HOLD_LOCK());
+    GC_ASSERT(n <= GC_max_markers_m1);
+    if (GC_n_mark_threads >= n) return GC_n_mark_threads;
     INIT_REAL_SYMS(); /* for pthread_create */
 
     if (0 != pthread_attr_init(&attr)) ABORT("pthread_attr_init failed");
@@ -420,24 +534,135 @@ static void start_mark_threads(void)
         }
       }
 #   endif /* HPUX || GC_DGUX386_THREADS */
-    for (i = 0; i < GC_markers_m1; ++i) {
-      if (0 != REAL_FUNC(pthread_create)(GC_mark_threads + i, &attr,
+    for (i = GC_n_mark_threads; i < n; ++i) {
+      if (0 != REAL_FUNC(pthread_create)(&GC_markers[i].id, &attr,
                               GC_mark_thread, (void *)(word)i)) {
         WARN("Marker thread creation failed, errno = %" WARN_PRIdPTR "\n",
              errno);
         /* Don't try to create other marker threads.    */
-        GC_markers_m1 = i;
         break;
       }
     }
+    GC_n_mark_threads = i;
     if (GC_print_stats) {
-      GC_log_printf("Started %d mark helper threads\n", GC_markers_m1);
+      GC_log_printf("Started %d mark helper threads\n", GC_n_mark_threads);
     }
     pthread_attr_destroy(&attr);
+    return i;
+}
+
+static pthread_mutex_t mark_pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+                        /* Serializes the changes of the number of      */
+                        /* markers after the initialization.            */
+
+GC_API int GC_CALL GC_set_markers_count(int markers)
+{
+    int n;
+    DCL_LOCK_STATE;
+
+    if (markers < 1) markers = 1;
+    if (!GC_is_initialized) {
+      /* The pool is not allocated yet; GC_thr_init will use the value. */
+      GC_requested_markers = markers;
+      return markers;
+    }
+    if (!GC_parallel) return 1;
+                        /* Parallel marking cannot be turned on (or     */
+                        /* off) after the initialization.               */
+    n = markers - 1;
+    if (n < 1) n = 1;
+    if (n > GC_max_markers_m1) n = GC_max_markers_m1;
+    pthread_mutex_lock(&mark_pool_mutex);
+    n = start_mark_threads(n) < n ? GC_n_mark_threads : n;
+    if (n > 0) {
+      LOCK(); /* Wait for the current collection (if any) to finish.    */
+      GC_acquire_mark_lock();
+      GC_markers_m1 = n;
+      UNPARK_RETIRED_MARKERS();
+      GC_release_mark_lock();
+      UNLOCK();
+    }
+    pthread_mutex_unlock(&mark_pool_mutex);
+    return GC_markers_m1 + 1;
 }
 
 #endif /* PARALLEL_MARK */
 
+#ifdef CAN_START_SCAVENGER
+  /* The scavenger parameters; protected by the allocation lock.        */
+  STATIC unsigned GC_scavenge_interval = 0; /* ms; 0 if not started */
+  STATIC unsigned GC_scavenge_age = 0;
+  STATIC word GC_scavenge_target_rss = 0;
+
+  /* Set by the scavenger thread instead of doing a pass while the      */
+  /* allocation lock is not really acquired by the client (i.e. the     */
+  /* scavenger has been started by GC_init and no other thread has been */
+  /* created yet).  The pass is done by the next block allocation then. */
+  GC_INNER volatile GC_bool GC_scavenge_requested = FALSE;
+
+  GC_INNER void GC_requested_scavenge(void)
+  {
+    GC_ASSERT(I_HOLD_LOCK());
+    GC_scavenge_requested = FALSE;
+    GC_scavenge(GC_scavenge_age, GC_scavenge_target_rss);
+  }
+
+  /* The scavenger thread is not registered (it never allocates nor     */
+  /* touches the objects), so it is not stopped by the collector.       */
+  STATIC void * GC_scavenger_thread(void *arg)
+  {
+    for (;;) {
+      unsigned interval = GC_scavenge_interval;
+      struct timespec ts;
+      DCL_LOCK_STATE;
+
+      ts.tv_sec = (time_t)(interval / 1000);
+      ts.tv_nsec = (long)(interval % 1000) * 1000000L;
+      nanosleep(&ts, 0);
+      if (GC_need_to_lock) {
+        LOCK();
+        GC_scavenge(GC_scavenge_age, GC_scavenge_target_rss);
+        UNLOCK();
+      } else {
+        GC_scavenge_requested = TRUE;
+      }
+    }
+    return arg; /* unreachable */
+  }
+
+  GC_INNER int GC_start_scavenger_inner(unsigned interval_ms,
+                                        unsigned age, word target_rss)
+  {
+    GC_bool start = (0 == GC_scavenge_interval);
+
+    GC_ASSERT(I_HOLD_LOCK());
+    if (0 == interval_ms) return EINVAL;
+    GC_scavenge_interval = interval_ms;
+    GC_scavenge_age = age;
+    GC_scavenge_target_rss = target_rss;
+    if (start) {
+      pthread_t t;
+      pthread_attr_t attr;
+      int code;
+
+      INIT_REAL_SYMS(); /* for pthread_create */
+      if (0 != pthread_attr_init(&attr)) ABORT("pthread_attr_init failed");
+      if (0 != pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED))
+        ABORT("pthread_attr_setdetachstate failed");
+      code = REAL_FUNC(pthread_create)(&t, &attr, GC_scavenger_thread, 0);
+      pthread_attr_destroy(&attr);
+      if (code != 0) {
+        GC_scavenge_interval = 0;
+        return code;
+      }
+      if (GC_print_stats)
+        GC_log_printf("Started scavenger thread (every %u ms)\n",
+                      interval_ms);
+    }
+    return 0;
+  }
+#endif /* CAN_START_SCAVENGER */
+
 GC_INNER GC_bool GC_thr_initialized = FALSE;
 
 GC_INNER volatile GC_thread GC_threads[THREAD_TABLE_SZ] = {0};
@@ -700,12 +925,13 @@ STATIC void GC_remove_all_threads_but_me(void)
 
     GC_ASSERT(I_HOLD_LOCK());
 #   ifdef PARALLEL_MARK
-      for (i = 0; i < GC_markers_m1; ++i) {
-        if ((word)marker_sp[i] > (word)lo && (word)marker_sp[i] < (word)hi)
+      for (i = 0; i < GC_n_mark_threads; ++i) {
+        if ((word)GC_markers[i].sp > (word)lo
+            && (word)GC_markers[i].sp < (word)hi)
           return TRUE;
 #       ifdef IA64
-          if ((word)marker_bsp[i] > (word)lo
-              && (word)marker_bsp[i] < (word)hi)
+          if ((word)GC_markers[i].bsp > (word)lo
+              && (word)GC_markers[i].bsp < (word)hi)
             return TRUE;
 #       endif
       }
@@ -741,10 +967,10 @@ STATIC void GC_remove_all_threads_but_me(void)
 
     GC_ASSERT(I_HOLD_LOCK());
 #   ifdef PARALLEL_MARK
-      for (i = 0; i < GC_markers_m1; ++i) {
-        if ((word)marker_sp[i] > (word)result
-            && (word)marker_sp[i] < (word)bound)
-          result = marker_sp[i];
+      for (i = 0; i < GC_n_mark_threads; ++i) {
+        if ((word)GC_markers[i].sp > (word)result
+            && (word)GC_markers[i].sp < (word)bound)
+          result = GC_markers[i].sp;
       }
 #   endif
     for (i = 0; i < THREAD_TABLE_SZ; i++) {
@@ -980,6 +1206,11 @@ STATIC void GC_fork_child_proc(void)
       /* just going to exec, and we would have to restart mark threads. */
         GC_parallel = FALSE;
 #   endif /* PARALLEL_MARK */
+#   ifdef CAN_START_SCAVENGER
+      /* The scavenger thread does not exist in the child; allow it to  */
+      /* be started again.                                              */
+      GC_scavenge_interval = 0;
+#   endif
     RESTORE_CANCEL(fork_cancel_state);
     UNLOCK();
 }
@@ -1064,7 +1295,13 @@ GC_INNER void GC_thr_init(void)
 #  ifdef PARALLEL_MARK
      {
        char * markers_string = GETENV("GC_MARKERS");
-       if (markers_string != NULL) {
+       if (GC_requested_markers > 0) {
+         GC_markers_m1 = GC_requested_markers - 1;
+         if (GC_markers_m1 >= MAX_MARKERS) {
+           WARN("Limiting number of mark threads\n", 0);
+           GC_markers_m1 = MAX_MARKERS - 1;
+         }
+       } else if (markers_string != NULL) {
          GC_markers_m1 = atoi(markers_string) - 1;
          if (GC_markers_m1 >= MAX_MARKERS) {
            WARN("Limiting number of mark threads\n", 0);
@@ -1099,9 +1336,21 @@ GC_INNER void GC_thr_init(void)
       /* Disable true incremental collection, but generational is OK.   */
       GC_time_limit = GC_TIME_UNLIMITED;
     }
-    /* If we are using a parallel marker, actually start helper threads. */
+    /* If we are using a parallel marker, allocate the pool (large      */
+    /* enough to have a marker per processor) and actually start the    */
+    /* helper threads.                                                  */
     if (GC_parallel) {
-      start_mark_threads();
+      GC_max_markers_m1 = GC_markers_m1;
+      if (GC_max_markers_m1 < GC_nprocs - 1) {
+        GC_max_markers_m1 = GC_nprocs < MAX_MARKERS ? GC_nprocs - 1
+                                                    : MAX_MARKERS - 1;
+      }
+      GC_markers = (GC_marker)GC_scratch_alloc(GC_max_markers_m1
+                                               * sizeof(struct GC_marker_s));
+      if (NULL == GC_markers)
+        ABORT("Failed to allocate memory for the marker pool");
+      BZERO(GC_markers, GC_max_markers_m1 * sizeof(struct GC_marker_s));
+      GC_markers_m1 = start_mark_threads(GC_markers_m1);
     }
 # else
     if (GC_print_stats)
@@ -1725,7 +1974,8 @@ GC_API int WRAP_FUNC(pthread_create)(pthread_t *new_thread,
     return(result);
 }
 
-#if defined(USE_SPIN_LOCK) || !defined(NO_PTHREAD_TRYLOCK)
+#if defined(USE_SPIN_LOCK) || !defined(NO_PTHREAD_TRYLOCK) \
+    || defined(FINE_GRAINED_LOCKS)
 /* Spend a few cycles in a way that can't introduce contention with     */
 /* other threads.                                                       */
 STATIC void GC_pause(void)
@@ -1903,6 +2153,51 @@ GC_INNER void GC_lock(void)
 
 #endif /* !USE_SPINLOCK */
 
+#ifdef FINE_GRAINED_LOCKS
+  GC_INNER volatile AO_t GC_shared_allocators = 0;
+  GC_INNER volatile AO_t GC_shared_alloc_excluded = FALSE;
+
+  /* AO_TS_CLEAR is zero.       */
+  GC_INNER volatile AO_TS_t GC_fl_locks[MAXOBJKINDS][MAXOBJGRANULES+1];
+  GC_INNER volatile AO_TS_t GC_hblk_lock = AO_TS_INITIALIZER;
+# ifdef GC_ASSERTIONS
+    GC_INNER unsigned long GC_hblk_lock_holder = NO_THREAD;
+# endif
+
+  /* The threads in the shared mode hold no lock for long, so we spin   */
+  /* with an exponential backoff (as GC_generic_lock does), then yield. */
+  GC_INNER void GC_wait_shared_alloc(void)
+  {
+    unsigned pause_length = 1;
+    unsigned i;
+
+    GC_ASSERT(AO_load(&GC_shared_alloc_excluded));
+    while (AO_load(&GC_shared_allocators) != 0) {
+      if (pause_length <= SPIN_MAX && GC_nprocs > 1) {
+        for (i = 0; i < pause_length; ++i) GC_pause();
+        pause_length <<= 1;
+      } else {
+        sched_yield();
+      }
+    }
+  }
+
+  GC_INNER void GC_spin_lock_wait(volatile AO_TS_t *lock)
+  {
+    unsigned pause_length = 1;
+    unsigned i;
+
+    do {
+      if (pause_length <= SPIN_MAX && GC_nprocs > 1) {
+        for (i = 0; i < pause_length; ++i) GC_pause();
+        pause_length <<= 1;
+      } else {
+        sched_yield();
+      }
+    } while (AO_test_and_set_acquire(lock) == AO_TS_SET);
+  }
+#endif /* FINE_GRAINED_LOCKS */
+
 #ifdef PARALLEL_MARK
 
 #ifdef GC_ASSERTIONS
@@ -2007,6 +2302,11 @@ GC_INNER void GC_notify_all_marker(void)
     }
 }
 
+GC_INNER void GC_marker_yield(void)
+{
+    sched_yield();
+}
+
 #endif /* PARALLEL_MARK */
 
 #endif /* GC_PTHREADS */
@@ -375,7 +375,41 @@ STATIC void GC_reclaim_block(struct hblk *hbp, word report_if_found)
     size_t sz = hhdr -> hb_sz;  /* size of objects in current block     */
     struct obj_kind * ok = &GC_obj_kinds[hhdr -> hb_obj_kind];
     struct hblk ** rlh;
+#   ifndef SMALL_CONFIG
+      struct GC_class_stats_s *cs;
+#   endif
 
+#   if defined(PARALLEL_MARK) || defined(SIDE_MARK_BITS)
+      /* The markers have not maintained the count (see INCR_MARKS),    */
+      /* or GC_clear_marks has not reset it.                            */
+      if (sz <= MAXOBJBYTES && !IS_UNCOLLECTABLE(hhdr -> hb_obj_kind))
+        hhdr -> hb_n_marks = GC_count_hdr_marks(hhdr);
+#   endif
+#   ifndef SMALL_CONFIG
+      cs = &GC_class_stats[hhdr -> hb_obj_kind]
+                          [sz > MAXOBJBYTES ? 0 : BYTES_TO_GRANULES(sz)];
+
+      if (!report_if_found) {
+        cs -> cs_blocks += OBJ_SZ_TO_BLOCKS(sz);
+        if (sz > MAXOBJBYTES) {
+          if (mark_bit_from_hdr(hhdr, 0)) cs -> cs_live_bytes += sz;
+        } else if ((hhdr -> hb_flags & REGION_BLK) != 0) {
+          cs -> cs_live_bytes += HBLKSIZE - HBLKSIZE % sz;
+        } else {
+          cs -> cs_live_bytes += sz * hhdr -> hb_n_marks;
+        }
+      }
+#   endif
+
+    if (EXPECT((hhdr -> hb_flags & REGION_BLK) != 0, FALSE)) {
+        /* Owned by an active region; swept only after the region end. */
+        if (hhdr -> hb_descr != 0) {
+          GC_composite_in_use += HBLKSIZE - HBLKSIZE % sz;
+        } else {
+          GC_atomic_in_use += HBLKSIZE - HBLKSIZE % sz;
+        }
+        return;
+    }
     if( sz > MAXOBJBYTES ) {  /* 1 big object */
         if( !mark_bit_from_hdr(hhdr, 0) ) {
             if (report_if_found) {
@@ -413,13 +447,12 @@ STATIC void GC_reclaim_block(struct hblk *hbp, word report_if_found)
     } else {
         GC_bool empty = GC_block_empty(hhdr);
 #       ifdef PARALLEL_MARK
-          /* Count can be low or one too high because we sometimes      */
-          /* have to ignore decrements.  Objects can also potentially   */
-          /* be repeatedly marked by each marker.                       */
-          /* Here we assume two markers, but this is extremely          */
-          /* unlikely to fail spuriously with more.  And if it does, it */
-          /* should be looked at.                                       */
-          GC_ASSERT(hhdr -> hb_n_marks <= 2 * (HBLKSIZE/sz + 1) + 16);
+          /* The count of an uncollectable block is not recounted, and  */
+          /* can be one too high because we sometimes have to ignore    */
+          /* decrements.                                                */
+          GC_ASSERT(sz * hhdr -> hb_n_marks <= HBLKSIZE
+                    || (IS_UNCOLLECTABLE(hhdr -> hb_obj_kind)
+                        && sz * (hhdr -> hb_n_marks - 1) <= HBLKSIZE));
 #       else
           GC_ASSERT(sz * hhdr -> hb_n_marks <= HBLKSIZE);
 #       endif
@@ -440,7 +473,12 @@ STATIC void GC_reclaim_block(struct hblk *hbp, word report_if_found)
           rlh = &(ok -> ok_reclaim_list[BYTES_TO_GRANULES(sz)]);
           hhdr -> hb_next = *rlh;
           *rlh = hbp;
-        } /* else not worth salvaging. */
+        } else {
+          /* Not worth salvaging.       */
+#         ifndef SMALL_CONFIG
+            cs -> cs_nearly_full_blocks++;
+#         endif
+        }
         /* We used to do the nearly_full check later, but we    */
         /* already have the right cache context here.  Also     */
         /* doing it here avoids some silly lock contention in   */
@@ -471,17 +509,10 @@ struct Print_stats
 /* Remains externally visible as used by GNU GCJ currently.     */
 int GC_n_set_marks(hdr *hhdr)
 {
-    int result = 0;
-    int i;
-    size_t sz = hhdr -> hb_sz;
-    int offset = (int)MARK_BIT_OFFSET(sz);
-    int limit = (int)FINAL_MARK_BIT(sz);
-
-    for (i = 0; i < limit; i += offset) {
-        result += hhdr -> hb_marks[i];
-    }
-    GC_ASSERT(hhdr -> hb_marks[limit]);
-    return(result);
+    /* Only the mark bytes of the object starts (and the one past the   */
+    /* end) are ever set.                                               */
+    GC_ASSERT(hhdr -> hb_marks[FINAL_MARK_BIT(hhdr -> hb_sz)]);
+    return (int)GC_count_hdr_marks(hhdr);
 }
 
 #else
@@ -622,6 +653,18 @@ GC_INNER void GC_start_reclaim(GC_bool report_if_found)
         struct hblk ** rlist = GC_obj_kinds[kind].ok_reclaim_list;
         GC_bool should_clobber = (GC_obj_kinds[kind].ok_descriptor != 0);
 
+#       ifndef SMALL_CONFIG
+          if (!report_if_found) {
+            /* GC_reclaim_block recomputes these, too.  */
+            size_t lg;
+
+            for (lg = 0; lg <= MAXOBJGRANULES; lg++) {
+              GC_class_stats[kind][lg].cs_live_bytes = 0;
+              GC_class_stats[kind][lg].cs_blocks = 0;
+              GC_class_stats[kind][lg].cs_nearly_full_blocks = 0;
+            }
+          }
+#       endif
         if (rlist == 0) continue;       /* This kind not used.  */
         if (!report_if_found) {
             lim = &(GC_obj_kinds[kind].ok_freelist[MAXOBJGRANULES+1]);
@@ -0,0 +1,136 @@
+/*
+ * THIS MATERIAL IS PROVIDED AS IS, WITH ABSOLUTELY NO WARRANTY EXPRESSED
+ * OR IMPLIED.  ANY USE IS AT YOUR OWN RISK.
+ *
+ * Permission is hereby granted to use or copy this program
+ * for any purpose,  provided the above notices are retained on all copies.
+ * Permission to modify the code and to distribute modified code is granted,
+ * provided the above notices are retained, and a notice that the code was
+ * modified is included with the above copyright notice.
+ */
+
+/* Measure how the allocation (and explicit deallocation) throughput    */
+/* scales from 1 to N threads (1, 2, 4, ..., N).  Each thread does the  */
+/* same amount of work, mostly on the allocation slow path (the         */
+/* thread-local free list refills and GC_free), so the time should      */
+/* stay flat as long as there are enough processors.  The maximum       */
+/* number of threads may be given as the first argument.                */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifndef GC_THREADS
+# define GC_THREADS
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "gc.h"
+
+#if defined(GC_PTHREADS) && !defined(GC_WIN32_PTHREADS)
+
+#include <pthread.h>
+#include <sys/time.h>
+
+#define DEFAULT_NTHREADS 8
+#define MAX_NTHREADS 256
+#define N_ALLOCS 100000
+#define KEEP 256                /* objects kept live by each thread     */
+
+static void *run_thread(void *arg)
+{
+  GC_word *kept[KEEP] = { NULL };
+  GC_word id = (GC_word)arg;
+  int i;
+
+  for (i = 0; i < N_ALLOCS; i++) {
+    /* Many size classes, so that the threads refill often.     */
+    size_t n = 2 + (size_t)(i % 61);
+    GC_word *p = (GC_word *)(i % 3 == 0
+                                ? GC_MALLOC_ATOMIC(n * sizeof(GC_word))
+                                : GC_MALLOC(n * sizeof(GC_word)));
+    GC_word *q;
+
+    if (NULL == p) {
+      fprintf(stderr, "Out of memory\n");
+      exit(1);
+    }
+    p[0] = id;
+    p[n - 1] = (GC_word)i;
+    q = kept[i % KEEP];
+    if (q != NULL) {
+      if (q[0] != id) {
+        fprintf(stderr, "Thread %lu: wrong contents of a kept object\n",
+                (unsigned long)id);
+        exit(1);
+      }
+      /* Some objects are deallocated explicitly.       */
+      if (i % 5 == 0) GC_FREE(q);
+    }
+    kept[i % KEEP] = p;
+  }
+  return NULL;
+}
+
+static unsigned long ms_since(const struct timeval *start)
+{
+  struct timeval now;
+
+  gettimeofday(&now, NULL);
+  return (unsigned long)((now.tv_sec - start -> tv_sec) * 1000
+                         + (now.tv_usec - start -> tv_usec) / 1000);
+}
+
+int main(int argc, char **argv)
+{
+  pthread_t t[MAX_NTHREADS];
+  int max_nthreads = argc > 1 ? atoi(argv[1]) : DEFAULT_NTHREADS;
+  int nthreads, i;
+
+  if (max_nthreads <= 0 || max_nthreads > MAX_NTHREADS) {
+    fprintf(stderr, "Usage: %s [MAX_NTHREADS]\n", argv[0]);
+    return 1;
+  }
+  GC_INIT();
+  for (nthreads = 1; ; nthreads *= 2) {
+    struct timeval start;
+    unsigned long elapsed;
+    GC_word gc_no = GC_get_gc_no();
+
+    if (nthreads > max_nthreads) nthreads = max_nthreads;
+    gettimeofday(&start, NULL);
+    for (i = 0; i < nthreads; i++) {
+      if (pthread_create(&t[i], NULL, run_thread,
+                         (void *)(GC_word)(i + 1)) != 0) {
+        fprintf(stderr, "Thread creation failed\n");
+        exit(1);
+      }
+    }
+    for (i = 0; i < nthreads; i++) {
+      if (pthread_join(t[i], NULL) != 0) {
+        fprintf(stderr, "Thread join failed\n");
+        exit(1);
+      }
+    }
+    elapsed = ms_since(&start);
+    printf("%d thread(s) x %d allocations: %lu ms"
+           " (%lu allocations/ms), %lu collections\n",
+           nthreads, N_ALLOCS, elapsed,
+           (unsigned long)nthreads * N_ALLOCS / (elapsed > 0 ? elapsed : 1),
+           (unsigned long)(GC_get_gc_no() - gc_no));
+    if (nthreads == max_nthreads) break;
+  }
+  return 0;
+}
+
+#else
+
+int main(void)
+{
+  printf("The scaling benchmark requires pthreads, skipped\n");
+  return 0;
+}
+
+#endif
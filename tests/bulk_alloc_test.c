@@ -0,0 +1,144 @@
+/*
+ * Test the bulk allocation functions (GC_malloc_bulk and friends).
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "gc.h"
+#include "gc_typed.h"
+
+#define N 5000
+
+struct node {
+  struct node *left;
+  GC_word value;
+  struct node *right;
+};
+
+static void check_objects(void **objs, size_t n, size_t lb, int cleared)
+{
+  size_t i, j;
+
+  for (i = 0; i < n; i++) {
+    if (NULL == objs[i] || GC_base(objs[i]) != objs[i]) {
+      fprintf(stderr, "Not an object start returned\n");
+      exit(1);
+    }
+    if (GC_size(objs[i]) < lb) {
+      fprintf(stderr, "Object of %lu bytes is too small\n",
+              (unsigned long)GC_size(objs[i]));
+      exit(1);
+    }
+    if (cleared) {
+      for (j = 0; j < lb / sizeof(GC_word); j++)
+        if (((GC_word *)objs[i])[j] != 0) {
+          fprintf(stderr, "Object is not cleared\n");
+          exit(1);
+        }
+    }
+    if (i > 0 && objs[i] == objs[i - 1]) {
+      fprintf(stderr, "Same object returned twice\n");
+      exit(1);
+    }
+  }
+}
+
+int main(void)
+{
+  static const size_t sizes[] = { 8, 24, 100, 1000, 3000, 10000 };
+  void **objs;
+  GC_word bitmap[GC_BITMAP_SIZE(struct node)] = { 0 };
+  GC_descr d;
+  size_t i, k;
+
+  GC_INIT();
+  objs = (void **)GC_MALLOC(N * sizeof(void *));
+  if (NULL == objs) {
+    fprintf(stderr, "Out of memory\n");
+    exit(1);
+  }
+  for (k = 0; k < sizeof(sizes) / sizeof(sizes[0]); k++) {
+    size_t n = sizes[k] > 2000 ? N / 20 : N;
+
+    if (GC_malloc_bulk(sizes[k], n, objs) != n) {
+      fprintf(stderr, "GC_malloc_bulk(%lu) failed\n", (unsigned long)sizes[k]);
+      exit(1);
+    }
+    check_objects(objs, n, sizes[k], 1);
+    for (i = 0; i < n; i++)
+      ((GC_word *)objs[i])[0] = (GC_word)(i < n - 1 ? objs[i + 1] : NULL);
+    GC_gcollect();
+    check_objects(objs, n, sizes[k], 0);
+
+    if (GC_malloc_atomic_bulk(sizes[k], n, objs) != n) {
+      fprintf(stderr, "GC_malloc_atomic_bulk(%lu) failed\n",
+              (unsigned long)sizes[k]);
+      exit(1);
+    }
+    check_objects(objs, n, sizes[k], 0);
+
+    if (GC_malloc_uncollectable_bulk(sizes[k], n, objs) != n) {
+      fprintf(stderr, "GC_malloc_uncollectable_bulk(%lu) failed\n",
+              (unsigned long)sizes[k]);
+      exit(1);
+    }
+    check_objects(objs, n, sizes[k], 1);
+    for (i = 0; i < n; i++) {
+      ((GC_word *)objs[i])[0] = 42;
+      objs[i] = (void *)~(GC_word)objs[i]; /* hide it */
+    }
+    GC_gcollect();
+    for (i = 0; i < n; i++) {
+      objs[i] = (void *)~(GC_word)objs[i];
+      if (((GC_word *)objs[i])[0] != 42) {
+        fprintf(stderr, "Uncollectable object has been collected\n");
+        exit(1);
+      }
+      GC_FREE(objs[i]);
+    }
+  }
+  if (GC_malloc_bulk(64, 0, objs) != 0) {
+    fprintf(stderr, "GC_malloc_bulk of no objects returned nonzero\n");
+    exit(1);
+  }
+
+  GC_set_bit(bitmap, GC_WORD_OFFSET(struct node, left));
+  GC_set_bit(bitmap, GC_WORD_OFFSET(struct node, right));
+  d = GC_make_descriptor(bitmap, GC_WORD_LEN(struct node));
+  if (GC_malloc_explicitly_typed_bulk(sizeof(struct node), d, N, objs)
+      != N) {
+    fprintf(stderr, "GC_malloc_explicitly_typed_bulk failed\n");
+    exit(1);
+  }
+  check_objects(objs, N, sizeof(struct node), 1);
+  for (i = 0; i < N; i++) {
+    struct node *p = (struct node *)objs[i];
+
+    p -> left = i > 0 ? (struct node *)objs[i - 1] : NULL;
+    p -> value = i;
+  }
+  {
+    struct node *p = (struct node *)objs[N - 1];
+
+    for (i = 0; i < N; i++) objs[i] = NULL;
+    GC_gcollect();
+    for (i = N; i-- > 0; p = p -> left) {
+      if (NULL == p || p -> value != i) {
+        fprintf(stderr, "Typed list is broken at node %lu\n",
+                (unsigned long)i);
+        exit(1);
+      }
+    }
+    if (p != NULL) {
+      fprintf(stderr, "Typed list is too long\n");
+      exit(1);
+    }
+  }
+  printf("SUCCEEDED\n");
+  return 0;
+}
@@ -0,0 +1,144 @@
+/*
+ * Test the per kind and size class statistics (GC_get_size_class_stats).
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "gc.h"
+#include "gc_tiny_fl.h" /* for GC_GRANULE_BYTES */
+
+#define N 10000
+#define OBJ_SZ 40
+#define LARGE_SZ 100000
+
+static void *kept[N];
+static void *large;
+
+static size_t get_stats(int kind, size_t granules,
+                        struct GC_size_class_stats_s *pstats)
+{
+  return GC_get_size_class_stats(kind, granules, pstats, sizeof(*pstats));
+}
+
+/* Sum the statistics of the small objects of the kind (the objects of  */
+/* the same size could get different size classes through the thread-   */
+/* local and global free lists).                                        */
+static void sum_small(int kind, struct GC_size_class_stats_s *psum)
+{
+  struct GC_size_class_stats_s stats;
+  size_t lg;
+
+  psum -> bytes_allocd_since_gc = psum -> live_bytes = psum -> blocks = 0;
+  for (lg = 1; get_stats(kind, lg, &stats) != 0; lg++) {
+    psum -> bytes_allocd_since_gc += stats.bytes_allocd_since_gc;
+    psum -> live_bytes += stats.live_bytes;
+    psum -> blocks += stats.blocks;
+  }
+}
+
+int main(void)
+{
+  struct GC_size_class_stats_s stats;
+  size_t lg;
+  int i, kind;
+
+  GC_INIT();
+  for (i = 0; i < N; i++) {
+    kept[i] = GC_MALLOC(OBJ_SZ);
+    if (NULL == kept[i]) {
+      fprintf(stderr, "Out of memory\n");
+      exit(1);
+    }
+    if (NULL == GC_MALLOC_ATOMIC(OBJ_SZ)) { /* garbage */
+      fprintf(stderr, "Out of memory\n");
+      exit(1);
+    }
+  }
+  large = GC_MALLOC(LARGE_SZ);
+  if (NULL == large) {
+    fprintf(stderr, "Out of memory\n");
+    exit(1);
+  }
+  GC_gcollect();
+  if (0 == get_stats(0, 0, &stats)) {
+    printf("Size class statistics are not supported, skipped\n");
+    return 0;
+  }
+
+  /* Kind 1 is that of the normal objects.      */
+  sum_small(1, &stats);
+  if (stats.live_bytes < N * OBJ_SZ) {
+    fprintf(stderr, "Too few live bytes of small objects: %lu\n",
+            (unsigned long)stats.live_bytes);
+    exit(1);
+  }
+  if (stats.blocks * 4096 < N * OBJ_SZ) {
+    fprintf(stderr, "Too few blocks of small objects: %lu\n",
+            (unsigned long)stats.blocks);
+    exit(1);
+  }
+  if (stats.bytes_allocd_since_gc >= N * OBJ_SZ) {
+    fprintf(stderr, "Allocated bytes are not reset by collection\n");
+    exit(1);
+  }
+  if (get_stats(1, 0, &stats) != sizeof(stats)) {
+    fprintf(stderr, "No statistics of large objects\n");
+    exit(1);
+  }
+  if (stats.live_bytes < LARGE_SZ || 0 == stats.blocks) {
+    fprintf(stderr, "Large object is not counted\n");
+    exit(1);
+  }
+
+  /* The pointer-free objects are garbage.    */
+  sum_small(0, &stats);
+  if (stats.live_bytes >= N * OBJ_SZ / 2) {
+    fprintf(stderr, "Garbage is counted as live: %lu bytes\n",
+            (unsigned long)stats.live_bytes);
+    exit(1);
+  }
+
+  for (i = 0; i < N; i++) {
+    if (NULL == GC_MALLOC(OBJ_SZ)) {
+      fprintf(stderr, "Out of memory\n");
+      exit(1);
+    }
+  }
+  sum_small(1, &stats);
+  if (stats.bytes_allocd_since_gc < N * OBJ_SZ) {
+    fprintf(stderr, "Too few allocated bytes: %lu\n",
+            (unsigned long)stats.bytes_allocd_since_gc);
+    exit(1);
+  }
+
+  /* The enumeration ends.      */
+  for (kind = 0; get_stats(kind, 0, &stats) != 0; kind++) {
+    for (lg = 1; get_stats(kind, lg, &stats) != 0; lg++) {
+      if (lg * GC_GRANULE_BYTES > 4096 * 16) {
+        fprintf(stderr, "Size class of %lu granules is reported\n",
+                (unsigned long)lg);
+        exit(1);
+      }
+    }
+  }
+  if (kind < 3 || kind >= 64) {
+    fprintf(stderr, "Wrong number of kinds: %d\n", kind);
+    exit(1);
+  }
+  if (get_stats(-1, 1, &stats) != 0) {
+    fprintf(stderr, "Statistics of an invalid kind are reported\n");
+    exit(1);
+  }
+  GC_print_size_class_stats();
+  if (NULL == kept[N - 1] || NULL == large) {
+    fprintf(stderr, "Kept objects are lost\n");
+    exit(1);
+  }
+  printf("SUCCEEDED\n");
+  return 0;
+}
@@ -0,0 +1,115 @@
+/*
+ * Test the sampling heap profiler (GC_start_heap_profiling and
+ * GC_dump_heap_profile).
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gc.h"
+
+#define KEPT 1000
+#define OBJ_SZ 1000
+
+static void *kept[KEPT];
+
+static void keep(void)
+{
+  int i;
+
+  for (i = 0; i < KEPT; i++) {
+    kept[i] = GC_MALLOC(OBJ_SZ);
+    if (NULL == kept[i]) {
+      fprintf(stderr, "Out of memory\n");
+      exit(1);
+    }
+  }
+}
+
+static void churn(void)
+{
+  int i;
+
+  for (i = 0; i < 32 * KEPT; i++) {
+    void *p = (i & 1) != 0 ? GC_MALLOC_ATOMIC(OBJ_SZ) : GC_MALLOC(OBJ_SZ);
+
+    if (NULL == p) {
+      fprintf(stderr, "Out of memory\n");
+      exit(1);
+    }
+  }
+}
+
+int main(void)
+{
+  char name[64];
+  FILE *f;
+  unsigned long live_count, live_bytes, alloc_count, alloc_bytes, interval;
+  int res;
+
+  GC_INIT();
+  res = GC_start_heap_profiling(4096);
+  if (GC_UNIMPLEMENTED == res) {
+    printf("Heap profiling is not supported, skipped\n");
+    return 0;
+  }
+  if (res != GC_SUCCESS) {
+    fprintf(stderr, "GC_start_heap_profiling failed\n");
+    exit(1);
+  }
+  keep();
+  churn();
+  GC_gcollect();
+
+  sprintf(name, "heap_profile_test.%lu.prof", (unsigned long)rand());
+  if (GC_dump_heap_profile(name) != 0) {
+    fprintf(stderr, "GC_dump_heap_profile failed\n");
+    exit(1);
+  }
+  f = fopen(name, "r");
+  if (NULL == f) {
+    fprintf(stderr, "Cannot open %s\n", name);
+    exit(1);
+  }
+  if (fscanf(f, "heap profile: %lu: %lu [%lu: %lu] @ heap_v2/%lu",
+             &live_count, &live_bytes, &alloc_count, &alloc_bytes,
+             &interval) != 5) {
+    fprintf(stderr, "Wrong profile header\n");
+    exit(1);
+  }
+  fclose(f);
+  remove(name);
+
+  /* About 33 MB were sampled every 4 KB, 1 MB of them stay live.       */
+  if (interval != 4096) {
+    fprintf(stderr, "Wrong sampling interval: %lu\n", interval);
+    exit(1);
+  }
+  if (alloc_count <= 2000 || alloc_count >= 20000) {
+    fprintf(stderr, "Wrong number of sampled allocations: %lu\n", alloc_count);
+    exit(1);
+  }
+  if (alloc_bytes != alloc_count * OBJ_SZ) {
+    fprintf(stderr, "Wrong number of sampled bytes: %lu\n", alloc_bytes);
+    exit(1);
+  }
+  if (0 == live_count || live_count >= alloc_count / 8) {
+    fprintf(stderr, "Wrong number of live samples: %lu\n", live_count);
+    exit(1);
+  }
+  if (live_bytes != live_count * OBJ_SZ) {
+    fprintf(stderr, "Wrong number of live bytes: %lu\n", live_bytes);
+    exit(1);
+  }
+  printf("Sampled %lu allocations, %lu live\n", alloc_count, live_count);
+  if (NULL == kept[KEPT - 1]) {
+    fprintf(stderr, "Kept objects are lost\n");
+    exit(1);
+  }
+  return 0;
+}
@@ -0,0 +1,110 @@
+/*
+ * THIS MATERIAL IS PROVIDED AS IS, WITH ABSOLUTELY NO WARRANTY EXPRESSED
+ * OR IMPLIED.  ANY USE IS AT YOUR OWN RISK.
+ *
+ * Permission is hereby granted to use or copy this program
+ * for any purpose,  provided the above notices are retained on all copies.
+ * Permission to modify the code and to distribute modified code is granted,
+ * provided the above notices are retained, and a notice that the code was
+ * modified is included with the above copyright notice.
+ */
+
+/* Measure the latency of large object allocation in a heap whose free  */
+/* space is fragmented into tens of thousands of runs of different      */
+/* lengths (which share the free lists of the large blocks, so that a   */
+/* search walking them is slow).  The timed objects are kept, so that   */
+/* each allocation takes (or splits) another run.  The heap size (in    */
+/* MB) may be given as the first argument; the default one gives about  */
+/* 20000 free runs (the pages of which are mostly never touched).       */
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "private/gc_priv.h"
+
+#define DEFAULT_HEAP_MB 4096
+#define MIN_RUN_BLOCKS 33       /* fragment lengths, in HBLKs           */
+#define MAX_RUN_BLOCKS 64
+#define ALLOC_CNT (16*1024)     /* number of timed allocations          */
+
+static unsigned long seed = 1;
+
+static unsigned long next_random(void)
+{
+    seed = seed * 1103515245UL + 12345;
+    return (seed >> 8) & 0xffffff;
+}
+
+static size_t random_run_bytes(void)
+{
+    size_t blocks = MIN_RUN_BLOCKS
+                    + next_random() % (MAX_RUN_BLOCKS - MIN_RUN_BLOCKS + 1);
+
+    return blocks * HBLKSIZE - HBLKSIZE / 2;
+}
+
+int main(int argc, char **argv)
+{
+    size_t heap_mb = argc > 1 ? (size_t)atol(argv[1]) : DEFAULT_HEAP_MB;
+    size_t total = 0;
+    size_t n_objs = 0;
+    size_t max_objs;
+    void **objs;
+    void **timed;
+    size_t i;
+    unsigned long elapsed;
+    CLOCK_TYPE start_time, done_time;
+
+    GC_INIT();
+    if (heap_mb == 0) {
+        fprintf(stderr, "Usage: %s [HEAP_MB]\n", argv[0]);
+        return 1;
+    }
+    GC_disable();
+    max_objs = (heap_mb << 20) / (MIN_RUN_BLOCKS * HBLKSIZE) + 1;
+    objs = (void **)GC_MALLOC_UNCOLLECTABLE(max_objs * sizeof(void *));
+    timed = (void **)GC_MALLOC_UNCOLLECTABLE(ALLOC_CNT * sizeof(void *));
+    if (NULL == objs || NULL == timed) {
+        fprintf(stderr, "Out of memory!\n");
+        return 2;
+    }
+
+    /* Fill the heap with large objects separated by small ones, then   */
+    /* free the large ones; the separators (each occupying a block of   */
+    /* its own) prevent coalescing.                                     */
+    while (total < (heap_mb << 20) && n_objs < max_objs) {
+        size_t lb = random_run_bytes();
+
+        objs[n_objs] = GC_MALLOC_ATOMIC(lb);
+        if (NULL == objs[n_objs]
+            || NULL == GC_MALLOC_UNCOLLECTABLE(HBLKSIZE / 2 + 8)) {
+            fprintf(stderr, "Out of memory!\n");
+            return 2;
+        }
+        total += lb;
+        n_objs++;
+    }
+    for (i = 0; i < n_objs; i++) {
+        GC_FREE(objs[i]);
+    }
+    printf("Heap size: %lu MB, %lu free runs\n",
+           (unsigned long)(GC_get_heap_size() >> 20), (unsigned long)n_objs);
+
+    GET_TIME(start_time);
+    for (i = 0; i < ALLOC_CNT; ++i) {
+        timed[i] = GC_MALLOC_ATOMIC(random_run_bytes());
+        if (NULL == timed[i]) {
+            fprintf(stderr, "Out of memory!\n");
+            return 2;
+        }
+    }
+    GET_TIME(done_time);
+    elapsed = MS_TIME_DIFF(done_time, start_time);
+    printf("%d large allocations: %lu ms (%.3f us per allocation)\n",
+           ALLOC_CNT, elapsed, elapsed * 1000.0 / ALLOC_CNT);
+    for (i = 0; i < ALLOC_CNT; ++i) {
+        GC_FREE(timed[i]);
+    }
+    GC_enable();
+    return 0;
+}
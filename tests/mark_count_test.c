@@ -0,0 +1,93 @@
+/*
+ * Test the counts of the marked objects per block (reported through the
+ * size class statistics) after a collection, including with the parallel
+ * marking (where they are recounted from the mark bits).
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifndef GC_THREADS
+# define GC_THREADS
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "gc.h"
+#include "gc_tiny_fl.h" /* for GC_GRANULE_BYTES */
+
+#define N 50000
+#define N_ROUNDS 4
+#define GRANULES 11     /* a size no other object is likely to have     */
+#define SLACK 256       /* objects retained conservatively by accident  */
+
+struct node {
+  struct node *next;
+  GC_word pad[GRANULES * GC_GRANULE_BYTES / sizeof(GC_word) - 1];
+};
+
+static struct node *list;
+
+static size_t get_stats(size_t granules,
+                        struct GC_size_class_stats_s *pstats)
+{
+  /* Kind 1 is that of the normal objects.      */
+  return GC_get_size_class_stats(1, granules, pstats, sizeof(*pstats));
+}
+
+int main(void)
+{
+  struct GC_size_class_stats_s stats;
+  size_t obj_sz;
+  int i, round;
+
+  (void)GC_set_markers_count(4);
+  GC_INIT();
+  if (0 == get_stats(0, &stats)) {
+    printf("Size class statistics are not supported, skipped\n");
+    return 0;
+  }
+  list = GC_NEW(struct node);
+  if (NULL == list) {
+    fprintf(stderr, "Out of memory\n");
+    exit(1);
+  }
+  obj_sz = GC_size(list);       /* the size class */
+  for (round = 1; round <= N_ROUNDS; round++) {
+    GC_word expected = ((GC_word)round * N + 1) * obj_sz;
+
+    /* The list grows by N, and as much garbage is allocated.   */
+    for (i = 0; i < 2 * N; i++) {
+      struct node *p = GC_NEW(struct node);
+
+      if (NULL == p) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+      }
+      if (i % 2 == 0) {
+        p -> next = list;
+        list = p;
+      }
+    }
+    GC_gcollect();
+    if (get_stats(obj_sz / GC_GRANULE_BYTES, &stats) != sizeof(stats)) {
+      fprintf(stderr, "No statistics of the size class\n");
+      exit(1);
+    }
+    printf("Round %d: %lu bytes live (%lu expected), %d marker(s)\n", round,
+           (unsigned long)stats.live_bytes, (unsigned long)expected,
+           GC_get_parallel() + 1);
+    if (stats.live_bytes < expected) {
+      fprintf(stderr, "Live objects are not counted\n");
+      exit(1);
+    }
+    if (stats.live_bytes > expected + SLACK * obj_sz) {
+      fprintf(stderr, "Garbage is counted as live\n");
+      exit(1);
+    }
+  }
+  printf("SUCCEEDED\n");
+  return 0;
+}
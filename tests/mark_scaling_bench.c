@@ -0,0 +1,190 @@
+/*
+ * THIS MATERIAL IS PROVIDED AS IS, WITH ABSOLUTELY NO WARRANTY EXPRESSED
+ * OR IMPLIED.  ANY USE IS AT YOUR OWN RISK.
+ *
+ * Permission is hereby granted to use or copy this program
+ * for any purpose,  provided the above notices are retained on all copies.
+ * Permission to modify the code and to distribute modified code is granted,
+ * provided the above notices are retained, and a notice that the code was
+ * modified is included with the above copyright notice.
+ */
+
+/* Measure how the parallel mark phase scales with the number of        */
+/* markers (1, 2, 4, ..., N): the same object graph (a few long lists   */
+/* and wide trees, the latter being easy to split among the markers,    */
+/* the former not) is built and collected in a child process for each   */
+/* value of GC_MARKERS.  The maximum number of markers, and the live    */
+/* heap size in MiB, may be given as the arguments.                     */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifndef GC_THREADS
+# define GC_THREADS
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "gc.h"
+
+#if defined(GC_PTHREADS) && !defined(GC_WIN32_PTHREADS)
+
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define DEFAULT_MAX_MARKERS 64
+#define DEFAULT_HEAP_MB 32
+#define N_COLLECTIONS 5
+#define N_LISTS 4
+#define TREE_FANOUT 8
+
+struct node {
+  struct node *next[TREE_FANOUT];
+  GC_word value;
+};
+
+static struct node *lists[N_LISTS];
+static struct node *tree;
+
+static struct node *make_list(size_t n)
+{
+  struct node *head = NULL;
+
+  while (n-- > 0) {
+    struct node *p = GC_NEW(struct node);
+
+    if (NULL == p) {
+      fprintf(stderr, "Out of memory\n");
+      exit(1);
+    }
+    p -> next[0] = head;
+    p -> value = n;
+    head = p;
+  }
+  return head;
+}
+
+static struct node *make_tree(size_t n)
+{
+  struct node *p;
+  size_t i;
+
+  if (0 == n) return NULL;
+  p = GC_NEW(struct node);
+  if (NULL == p) {
+    fprintf(stderr, "Out of memory\n");
+    exit(1);
+  }
+  p -> value = n--;
+  for (i = 0; i < TREE_FANOUT; i++) {
+    p -> next[i] = make_tree(n / TREE_FANOUT
+                             + (i < n % TREE_FANOUT ? 1 : 0));
+  }
+  return p;
+}
+
+static size_t count_tree(const struct node *p)
+{
+  size_t n = 0;
+  size_t i;
+
+  if (NULL == p) return 0;
+  for (i = 0; i < TREE_FANOUT; i++) n += count_tree(p -> next[i]);
+  return n + 1;
+}
+
+static unsigned long ms_since(const struct timeval *start)
+{
+  struct timeval now;
+
+  gettimeofday(&now, NULL);
+  return (unsigned long)((now.tv_sec - start -> tv_sec) * 1000
+                         + (now.tv_usec - start -> tv_usec) / 1000);
+}
+
+static void run(int heap_mb)
+{
+  size_t n_nodes = (size_t)heap_mb * 1024 * 1024 / sizeof(struct node);
+  struct timeval start;
+  unsigned long elapsed;
+  int i;
+
+  GC_INIT();
+  /* A quarter of the nodes is in the lists, the rest is in the tree.   */
+  for (i = 0; i < N_LISTS; i++) {
+    lists[i] = make_list(n_nodes / 4 / N_LISTS);
+  }
+  tree = make_tree(n_nodes - n_nodes / 4);
+  GC_gcollect();
+
+  gettimeofday(&start, NULL);
+  for (i = 0; i < N_COLLECTIONS; i++) {
+    GC_gcollect();
+  }
+  elapsed = ms_since(&start);
+  if (count_tree(tree) != n_nodes - n_nodes / 4) {
+    fprintf(stderr, "Tree nodes have been collected\n");
+    exit(1);
+  }
+  printf("%d marker(s): %lu ms per collection, heap %lu MiB\n",
+         GC_get_parallel() + 1, elapsed / N_COLLECTIONS,
+         (unsigned long)(GC_get_heap_size() >> 20));
+}
+
+int main(int argc, char **argv)
+{
+  int max_markers = argc > 1 ? atoi(argv[1]) : DEFAULT_MAX_MARKERS;
+  int heap_mb = argc > 2 ? atoi(argv[2]) : DEFAULT_HEAP_MB;
+  int markers;
+
+  if (max_markers <= 0 || heap_mb <= 0) {
+    fprintf(stderr, "Usage: %s [MAX_MARKERS [HEAP_MB]]\n", argv[0]);
+    return 1;
+  }
+  /* The collector is initialized in the children only.  */
+  for (markers = 1; ; markers *= 2) {
+    char buf[16];
+    pid_t pid;
+    int status;
+
+    if (markers > max_markers) markers = max_markers;
+    fflush(stdout);
+    pid = fork();
+    if (-1 == pid) {
+      fprintf(stderr, "Fork failed\n");
+      exit(1);
+    }
+    if (0 == pid) {
+      sprintf(buf, "%d", markers);
+      if (setenv("GC_MARKERS", buf, 1) != 0) {
+        fprintf(stderr, "setenv failed\n");
+        exit(1);
+      }
+      run(heap_mb);
+      exit(0);
+    }
+    if (waitpid(pid, &status, 0) != pid) {
+      fprintf(stderr, "waitpid failed\n");
+      exit(1);
+    }
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      fprintf(stderr, "Run with %d marker(s) failed\n", markers);
+      exit(1);
+    }
+    if (markers == max_markers) break;
+  }
+  return 0;
+}
+
+#else
+
+int main(void)
+{
+  printf("The marker scaling benchmark requires pthreads, skipped\n");
+  return 0;
+}
+
+#endif
@@ -0,0 +1,154 @@
+/*
+ * Test the runtime changes of the number of parallel markers
+ * (GC_set_markers_count), while another thread keeps collecting.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifndef GC_THREADS
+# define GC_THREADS
+#endif
+
+#include "gc.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef GC_PTHREADS
+# include <pthread.h>
+#else
+# include <windows.h>
+#endif
+
+#define INITIAL_MARKERS 4
+#define LIST_LEN 100000
+#define N_ROUNDS 20
+
+struct node {
+  struct node *next;
+  GC_word value;
+};
+
+static struct node *make_list(GC_word n)
+{
+  struct node *head = NULL;
+
+  while (n-- > 0) {
+    struct node *p = GC_NEW(struct node);
+
+    if (NULL == p) {
+      fprintf(stderr, "Out of memory\n");
+      exit(1);
+    }
+    p -> next = head;
+    p -> value = n;
+    head = p;
+  }
+  return head;
+}
+
+static void check_list(const struct node *p, GC_word n)
+{
+  GC_word i;
+
+  for (i = 0; i < n; i++, p = p -> next) {
+    if (NULL == p || p -> value != i) {
+      fprintf(stderr, "List is broken at node %lu\n", (unsigned long)i);
+      exit(1);
+    }
+  }
+  if (p != NULL) {
+    fprintf(stderr, "List is too long\n");
+    exit(1);
+  }
+}
+
+#ifdef GC_PTHREADS
+  static void * collect(void * arg)
+#else
+  static DWORD WINAPI collect(LPVOID arg)
+#endif
+{
+  struct node *list = make_list(LIST_LEN);
+  int i;
+
+  for (i = 0; i < N_ROUNDS; i++) {
+    GC_gcollect();
+    /* Garbage, so that the objects are reused.  */
+    (void)make_list(LIST_LEN / 10);
+    check_list(list, LIST_LEN);
+  }
+  return arg;
+}
+
+int main(void)
+{
+  int markers, i;
+# ifdef GC_PTHREADS
+    pthread_t t;
+# else
+    HANDLE t;
+    DWORD thread_id;
+# endif
+
+  if (GC_set_markers_count(INITIAL_MARKERS) != INITIAL_MARKERS) {
+    fprintf(stderr, "Cannot set markers count before GC_INIT\n");
+    exit(1);
+  }
+  GC_INIT();
+  markers = GC_get_parallel() + 1;
+  if (markers < 2) {
+    printf("Parallel marking is not supported, skipped\n");
+    return 0;
+  }
+  printf("Markers: %d\n", markers);
+# ifdef GC_PTHREADS
+    if (pthread_create(&t, NULL, collect, NULL) != 0) {
+      fprintf(stderr, "Thread creation failed\n");
+      exit(1);
+    }
+# else
+    t = CreateThread(NULL, 0, collect, NULL, 0, &thread_id);
+    if (NULL == t) {
+      fprintf(stderr, "Thread creation failed\n");
+      exit(1);
+    }
+# endif
+  for (i = 0; i < 4 * N_ROUNDS; i++) {
+    int n = GC_set_markers_count(2 + i % markers);
+
+    /* Only the Win32 implementation does not support the changes.   */
+    if ((n != 2 + i % markers || n != GC_get_parallel() + 1)
+        && n != markers) {
+      fprintf(stderr, "Wrong markers count: %d\n", n);
+      exit(1);
+    }
+  }
+  /* The number is limited by the pool size.    */
+  i = GC_set_markers_count(100000);
+  if (i < markers || i != GC_get_parallel() + 1) {
+    fprintf(stderr, "Markers count is not limited properly: %d\n", i);
+    exit(1);
+  }
+  if (GC_set_markers_count(0) != 2 && i != markers) {
+    fprintf(stderr, "Markers count is not raised to the minimum\n");
+    exit(1);
+  }
+# ifdef GC_PTHREADS
+    if (pthread_join(t, NULL) != 0) {
+      fprintf(stderr, "Thread join failed\n");
+      exit(1);
+    }
+# else
+    if (WaitForSingleObject(t, INFINITE) != WAIT_OBJECT_0) {
+      fprintf(stderr, "Thread join failed\n");
+      exit(1);
+    }
+# endif
+  GC_set_markers_count(markers);
+  collect(NULL);
+  printf("SUCCEEDED\n");
+  return 0;
+}
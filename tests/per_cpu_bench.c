@@ -0,0 +1,188 @@
+/*
+ * THIS MATERIAL IS PROVIDED AS IS, WITH ABSOLUTELY NO WARRANTY EXPRESSED
+ * OR IMPLIED.  ANY USE IS AT YOUR OWN RISK.
+ *
+ * Permission is hereby granted to use or copy this program
+ * for any purpose,  provided the above notices are retained on all copies.
+ * Permission to modify the code and to distribute modified code is granted,
+ * provided the above notices are retained, and a notice that the code was
+ * modified is included with the above copyright notice.
+ */
+
+/* Compare the per-CPU free lists (PER_CPU_ALLOC) with the thread-local */
+/* ones: many threads allocate small objects, then stay idle while the  */
+/* bytes held by the free lists are measured.  Each configuration runs  */
+/* in a child process (the second one with GC_NO_PER_CPU_ALLOC set).    */
+/* The number of threads may be given as the first argument.            */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifndef GC_THREADS
+# define GC_THREADS
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "gc.h"
+
+#if defined(GC_PTHREADS) && !defined(GC_WIN32_PTHREADS)
+
+#include <pthread.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define DEFAULT_NTHREADS 64
+#define MAX_NTHREADS 1024
+#define N_ALLOCS 50000
+#define KEEP 64                 /* objects kept live by each thread     */
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+static int n_done = 0;
+static int released = 0;
+
+static void *run_thread(void *arg)
+{
+  void *kept[KEEP] = { NULL };
+  int i;
+
+  (void)arg;
+  for (i = 0; i < N_ALLOCS; i++) {
+    size_t lb = 8 + (size_t)(i % 16) * 8;
+    void *p = i % 4 == 0 ? GC_MALLOC_ATOMIC(lb) : GC_MALLOC(lb);
+
+    if (NULL == p) {
+      fprintf(stderr, "Out of memory\n");
+      exit(1);
+    }
+    kept[i % KEEP] = p;
+  }
+
+  /* Stay idle (with the free lists filled) until released.     */
+  pthread_mutex_lock(&lock);
+  n_done++;
+  pthread_cond_broadcast(&cond);
+  while (!released)
+    pthread_cond_wait(&cond, &lock);
+  pthread_mutex_unlock(&lock);
+  if (NULL == kept[KEEP - 1]) {
+    fprintf(stderr, "Kept objects are lost\n");
+    exit(1);
+  }
+  return NULL;
+}
+
+static unsigned long ms_since(const struct timeval *start)
+{
+  struct timeval now;
+
+  gettimeofday(&now, NULL);
+  return (unsigned long)((now.tv_sec - start -> tv_sec) * 1000
+                         + (now.tv_usec - start -> tv_usec) / 1000);
+}
+
+static void run(const char *name, int nthreads)
+{
+  pthread_t t[MAX_NTHREADS];
+  struct GC_prof_stats_s stats;
+  struct timeval start;
+  unsigned long elapsed;
+  int i;
+
+  GC_INIT();
+  gettimeofday(&start, NULL);
+  for (i = 0; i < nthreads; i++) {
+    if (pthread_create(&t[i], NULL, run_thread, NULL) != 0) {
+      fprintf(stderr, "Thread creation failed\n");
+      exit(1);
+    }
+  }
+  pthread_mutex_lock(&lock);
+  while (n_done < nthreads)
+    pthread_cond_wait(&cond, &lock);
+  pthread_mutex_unlock(&lock);
+  elapsed = ms_since(&start);
+
+  GC_gcollect();
+  if (GC_get_prof_stats(&stats, sizeof(stats)) != sizeof(stats)) {
+    fprintf(stderr, "GC_get_prof_stats failed\n");
+    exit(1);
+  }
+  printf("%s: %d threads x %d allocations: %lu ms;"
+         " %lu KiB held by idle free lists, heap %lu KiB\n",
+         name, nthreads, N_ALLOCS, elapsed,
+         (unsigned long)(stats.tl_stranded_bytes >> 10),
+         (unsigned long)(stats.heapsize_full >> 10));
+
+  pthread_mutex_lock(&lock);
+  released = 1;
+  pthread_cond_broadcast(&cond);
+  pthread_mutex_unlock(&lock);
+  for (i = 0; i < nthreads; i++) {
+    if (pthread_join(t[i], NULL) != 0) {
+      fprintf(stderr, "Thread join failed\n");
+      exit(1);
+    }
+  }
+}
+
+int main(int argc, char **argv)
+{
+  int nthreads = argc > 1 ? atoi(argv[1]) : DEFAULT_NTHREADS;
+  int mode;
+
+  if (nthreads <= 0 || nthreads > MAX_NTHREADS) {
+    fprintf(stderr, "Usage: %s [NTHREADS]\n", argv[0]);
+    return 1;
+  }
+  /* The collector is initialized in the children only.  */
+  for (mode = 0; mode < 2; mode++) {
+    pid_t pid;
+    int status;
+
+    fflush(stdout);
+    pid = fork();
+    if (-1 == pid) {
+      fprintf(stderr, "Fork failed\n");
+      exit(1);
+    }
+    if (0 == pid) {
+      if (mode != 0) {
+        if (setenv("GC_NO_PER_CPU_ALLOC", "1", 1) != 0) {
+          fprintf(stderr, "setenv failed\n");
+          exit(1);
+        }
+      } else {
+        if (unsetenv("GC_NO_PER_CPU_ALLOC") != 0) {
+          fprintf(stderr, "unsetenv failed\n");
+          exit(1);
+        }
+      }
+      run(mode != 0 ? "thread-local" : "per-CPU (if enabled)", nthreads);
+      exit(0);
+    }
+    if (waitpid(pid, &status, 0) != pid) {
+      fprintf(stderr, "waitpid failed\n");
+      exit(1);
+    }
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      fprintf(stderr, "Run in mode %d failed\n", mode);
+      exit(1);
+    }
+  }
+  return 0;
+}
+
+#else
+
+int main(void)
+{
+  printf("Per-CPU allocation requires pthreads, skipped\n");
+  return 0;
+}
+
+#endif
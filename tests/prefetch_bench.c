@@ -0,0 +1,191 @@
+/*
+ * THIS MATERIAL IS PROVIDED AS IS, WITH ABSOLUTELY NO WARRANTY EXPRESSED
+ * OR IMPLIED.  ANY USE IS AT YOUR OWN RISK.
+ *
+ * Permission is hereby granted to use or copy this program
+ * for any purpose,  provided the above notices are retained on all copies.
+ * Permission to modify the code and to distribute modified code is granted,
+ * provided the above notices are retained, and a notice that the code was
+ * modified is included with the above copyright notice.
+ */
+
+/* Measure the mark phase on a pointer-chasing workload (a tree whose   */
+/* nodes are linked in a random order, so that nearly every pointer     */
+/* followed is a cache miss) for several depths of the prefetch FIFO    */
+/* of the marker (GC_PREFETCH_FIFO_DEPTH), to tune the latter.  The     */
+/* same graph is built and collected in a child process for each depth. */
+/* The live heap size in MiB, and the maximum depth, may be given as    */
+/* the arguments.                                                       */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifndef GC_THREADS
+# define GC_THREADS
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "gc.h"
+
+#if defined(GC_PTHREADS) && !defined(GC_WIN32_PTHREADS)
+
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define DEFAULT_HEAP_MB 32
+#define DEFAULT_MAX_DEPTH 16
+#define N_COLLECTIONS 5
+#define FANOUT 4
+
+struct node {
+  struct node *child[FANOUT];
+  GC_word value;
+};
+
+static struct node *root;
+
+static unsigned long seed = 1;
+
+static unsigned long next_random(void)
+{
+  seed = seed * 1103515245UL + 12345;
+  return (seed >> 8) & 0xffffff;
+}
+
+/* Node i has nodes FANOUT*i+1 .. FANOUT*i+FANOUT as the children, but  */
+/* the nodes are numbered in a random order of their addresses.         */
+static void build(size_t n_nodes)
+{
+  /* Collectable, so that the nodes are referenced until linked.        */
+  struct node **nodes = (struct node **)GC_MALLOC(n_nodes * sizeof(*nodes));
+  size_t i;
+
+  if (NULL == nodes) {
+    fprintf(stderr, "Out of memory\n");
+    exit(1);
+  }
+  for (i = 0; i < n_nodes; i++) {
+    nodes[i] = GC_NEW(struct node);
+    if (NULL == nodes[i]) {
+      fprintf(stderr, "Out of memory\n");
+      exit(1);
+    }
+    nodes[i] -> value = i;
+  }
+  for (i = n_nodes - 1; i > 0; i--) {
+    size_t j = (size_t)((next_random() << 24 | next_random()) % (i + 1));
+    struct node *p = nodes[i];
+
+    nodes[i] = nodes[j];
+    nodes[j] = p;
+  }
+  for (i = 1; i < n_nodes; i++) {
+    nodes[(i - 1) / FANOUT] -> child[(i - 1) % FANOUT] = nodes[i];
+  }
+  root = nodes[0];
+  /* Not to have the nodes reachable from the array (in address order)  */
+  /* if the latter is still referenced from the stack.                  */
+  for (i = 0; i < n_nodes; i++) nodes[i] = NULL;
+}
+
+static size_t count(const struct node *p)
+{
+  size_t n = 0;
+  size_t i;
+
+  if (NULL == p) return 0;
+  for (i = 0; i < FANOUT; i++) n += count(p -> child[i]);
+  return n + 1;
+}
+
+static unsigned long ms_since(const struct timeval *start)
+{
+  struct timeval now;
+
+  gettimeofday(&now, NULL);
+  return (unsigned long)((now.tv_sec - start -> tv_sec) * 1000
+                         + (now.tv_usec - start -> tv_usec) / 1000);
+}
+
+static void run(int depth, int heap_mb)
+{
+  size_t n_nodes = (size_t)heap_mb * 1024 * 1024 / sizeof(struct node);
+  struct timeval start;
+  unsigned long elapsed;
+  int i;
+
+  GC_INIT();
+  build(n_nodes);
+  GC_gcollect();
+
+  gettimeofday(&start, NULL);
+  for (i = 0; i < N_COLLECTIONS; i++) {
+    GC_gcollect();
+  }
+  elapsed = ms_since(&start);
+  if (count(root) != n_nodes) {
+    fprintf(stderr, "Tree nodes have been collected\n");
+    exit(1);
+  }
+  printf("FIFO depth %d: %lu ms per collection, %d marker(s)\n",
+         depth, elapsed / N_COLLECTIONS, GC_get_parallel() + 1);
+}
+
+int main(int argc, char **argv)
+{
+  int heap_mb = argc > 1 ? atoi(argv[1]) : DEFAULT_HEAP_MB;
+  int max_depth = argc > 2 ? atoi(argv[2]) : DEFAULT_MAX_DEPTH;
+  int depth;
+
+  if (heap_mb <= 0 || max_depth < 0) {
+    fprintf(stderr, "Usage: %s [HEAP_MB [MAX_DEPTH]]\n", argv[0]);
+    return 1;
+  }
+  /* The collector is initialized in the children only.  */
+  for (depth = 0; ; depth = depth > 0 ? depth * 2 : 1) {
+    char buf[16];
+    pid_t pid;
+    int status;
+
+    if (depth > max_depth) depth = max_depth;
+    fflush(stdout);
+    pid = fork();
+    if (-1 == pid) {
+      fprintf(stderr, "Fork failed\n");
+      exit(1);
+    }
+    if (0 == pid) {
+      sprintf(buf, "%d", depth);
+      if (setenv("GC_PREFETCH_FIFO_DEPTH", buf, 1) != 0) {
+        fprintf(stderr, "setenv failed\n");
+        exit(1);
+      }
+      run(depth, heap_mb);
+      exit(0);
+    }
+    if (waitpid(pid, &status, 0) != pid) {
+      fprintf(stderr, "waitpid failed\n");
+      exit(1);
+    }
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      fprintf(stderr, "Run with FIFO depth %d failed\n", depth);
+      exit(1);
+    }
+    if (depth == max_depth) break;
+  }
+  return 0;
+}
+
+#else
+
+int main(void)
+{
+  printf("The prefetch benchmark requires pthreads, skipped\n");
+  return 0;
+}
+
+#endif
@@ -0,0 +1,82 @@
+/*
+ * THIS MATERIAL IS PROVIDED AS IS, WITH ABSOLUTELY NO WARRANTY EXPRESSED
+ * OR IMPLIED.  ANY USE IS AT YOUR OWN RISK.
+ *
+ * Permission is hereby granted to use or copy this program
+ * for any purpose,  provided the above notices are retained on all copies.
+ * Permission to modify the code and to distribute modified code is granted,
+ * provided the above notices are retained, and a notice that the code was
+ * modified is included with the above copyright notice.
+ */
+
+/* Measure GC_realloc growing large buffers step by step, as vectors    */
+/* and string builders do: first a single buffer, then several ones    */
+/* growing in turn (so that they cannot all be extended in place).  The */
+/* final size of each buffer (in MB) may be given as the first          */
+/* argument, e.g. 512; the default is kept small for "make check".      */
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "private/gc_priv.h"
+
+#define DEFAULT_FINAL_MB 32
+#define N_BUFS 4
+#define GROW_STEP (64 * 1024)   /* bytes appended at a time             */
+
+/* Grow the buffers (round-robin) up to final_bytes each, appending     */
+/* GROW_STEP bytes at a time, and check that the contents are kept.     */
+/* Return the elapsed time in ms.                                       */
+static unsigned long grow_buffers(int n_bufs, size_t final_bytes)
+{
+    char *bufs[N_BUFS];
+    size_t len = 0;
+    int i;
+    CLOCK_TYPE start_time, done_time;
+
+    for (i = 0; i < n_bufs; i++)
+      bufs[i] = NULL;
+    GET_TIME(start_time);
+    while (len < final_bytes) {
+      for (i = 0; i < n_bufs; i++) {
+        char *p = (char *)GC_REALLOC(bufs[i], len + GROW_STEP);
+
+        if (NULL == p) {
+          fprintf(stderr, "Out of memory!\n");
+          exit(2);
+        }
+        if (len > 0 && (p[0] != (char)i || p[len - 1] != (char)(len + i))) {
+          fprintf(stderr, "GC_realloc lost the contents at %lu bytes\n",
+                  (unsigned long)len);
+          exit(1);
+        }
+        p[0] = (char)i;
+        p[len + GROW_STEP - 1] = (char)(len + GROW_STEP + i);
+        bufs[i] = p;
+      }
+      len += GROW_STEP;
+    }
+    GET_TIME(done_time);
+    return MS_TIME_DIFF(done_time, start_time);
+}
+
+int main(int argc, char **argv)
+{
+    size_t final_mb = argc > 1 ? (size_t)atol(argv[1]) : DEFAULT_FINAL_MB;
+    unsigned long elapsed;
+
+    GC_INIT();
+    if (final_mb == 0) {
+        fprintf(stderr, "Usage: %s [FINAL_MB]\n", argv[0]);
+        return 1;
+    }
+    elapsed = grow_buffers(1, final_mb << 20);
+    printf("1 buffer grown to %lu MB: %lu ms\n",
+           (unsigned long)final_mb, elapsed);
+    elapsed = grow_buffers(N_BUFS, final_mb << 20);
+    printf("%d buffers grown to %lu MB: %lu ms\n",
+           N_BUFS, (unsigned long)final_mb, elapsed);
+    printf("Heap size: %lu MB\n",
+           (unsigned long)(GC_get_heap_size() >> 20));
+    return 0;
+}
@@ -0,0 +1,99 @@
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "gc.h"
+
+#define N_OBJS 4
+#define OBJ_BYTES (2 * 1024 * 1024)
+#define N_CELLS (OBJ_BYTES / sizeof(GC_word *))
+
+/* Check that the huge objects moved by GC_realloc (by swapping their   */
+/* pages if the collector is built with USE_MREMAP_REALLOC) keep their  */
+/* contents, that the small objects referenced only from them survive  */
+/* the collections, and that the old pages are reused cleared.          */
+int main(void)
+{
+  GC_word **objs[N_OBJS];
+  struct GC_prof_stats_s stats;
+  GC_word moved_before;
+  size_t i, j;
+
+  GC_INIT();
+  /* The objects are allocated in turn, so that most of them are        */
+  /* followed by another one and cannot grow in place.                  */
+  for (i = 0; i < N_OBJS; i++) {
+    objs[i] = (GC_word **)GC_MALLOC(OBJ_BYTES);
+    if (NULL == objs[i]) {
+      fprintf(stderr, "Out of memory\n");
+      exit(1);
+    }
+    for (j = 0; j < N_CELLS; j += 1024) {
+      objs[i][j] = (GC_word *)GC_MALLOC_ATOMIC(sizeof(GC_word));
+      if (NULL == objs[i][j]) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+      }
+      *objs[i][j] = (GC_word)(i * N_CELLS + j);
+    }
+  }
+  if (GC_get_prof_stats(&stats, sizeof(stats)) != sizeof(stats)) {
+    fprintf(stderr, "GC_get_prof_stats failed\n");
+    exit(1);
+  }
+  moved_before = stats.realloc_moved_bytes;
+
+  for (i = 0; i < N_OBJS; i++) {
+    objs[i] = (GC_word **)GC_REALLOC(objs[i], 2 * OBJ_BYTES);
+    if (NULL == objs[i]) {
+      fprintf(stderr, "Out of memory\n");
+      exit(1);
+    }
+    if (GC_base(objs[i]) != objs[i] || GC_size(objs[i]) < 2 * OBJ_BYTES) {
+      fprintf(stderr, "Wrong base or size of the reallocated object\n");
+      exit(1);
+    }
+    for (j = N_CELLS; j < 2 * N_CELLS; j++) {
+      if (objs[i][j] != NULL) {
+        fprintf(stderr, "Grown part of the object is not cleared\n");
+        exit(1);
+      }
+    }
+  }
+  (void)GC_get_prof_stats(&stats, sizeof(stats));
+  printf("Moved %lu bytes by swapping the pages\n",
+         (unsigned long)(stats.realloc_moved_bytes - moved_before));
+
+  /* Reuse the pages of the old objects.        */
+  for (i = 0; i < N_OBJS; i++) {
+    GC_word *p = (GC_word *)GC_MALLOC(OBJ_BYTES);
+
+    if (NULL == p) {
+      fprintf(stderr, "Out of memory\n");
+      exit(1);
+    }
+    for (j = 0; j < OBJ_BYTES / sizeof(GC_word); j++) {
+      if (p[j] != 0) {
+        fprintf(stderr, "Reused pages are not cleared\n");
+        exit(1);
+      }
+    }
+  }
+  GC_gcollect();
+  GC_gcollect();
+  for (i = 0; i < N_OBJS; i++) {
+    for (j = 0; j < N_CELLS; j++) {
+      if (j % 1024 != 0 ? objs[i][j] != NULL
+          : NULL == objs[i][j] || *objs[i][j] != (GC_word)(i * N_CELLS + j)) {
+        fprintf(stderr, "Contents of the moved object are lost\n");
+        exit(1);
+      }
+    }
+  }
+  printf("SUCCEEDED\n");
+  return 0;
+}
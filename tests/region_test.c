@@ -0,0 +1,144 @@
+/*
+ * Test the scoped allocation regions (GC_region_begin/end).
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gc.h"
+
+#define N 20000
+
+struct node {
+  struct node *next;
+  void *data;
+};
+
+static struct node *escaped;
+static struct node *escaped_while_disabled;
+
+/* Build a list in the region, each node pointing to a normal object.  */
+static struct node *build(GC_region_t r, int n)
+{
+  struct node *head = NULL;
+  int i;
+
+  for (i = 0; i < n; i++) {
+    struct node *p = (struct node *)GC_region_malloc(r, sizeof(struct node));
+    char *s = (char *)GC_region_malloc_atomic(r, 20);
+
+    if (NULL == p || NULL == s) {
+      fprintf(stderr, "Out of memory\n");
+      exit(1);
+    }
+    if (p -> next != NULL || p -> data != NULL) {
+      fprintf(stderr, "Region object is not cleared\n");
+      exit(1);
+    }
+    strcpy(s, "in region");
+    p -> data = GC_MALLOC(16);
+    if (NULL == p -> data) {
+      fprintf(stderr, "Out of memory\n");
+      exit(1);
+    }
+    *(char **)(p -> data) = s;
+    p -> next = head;
+    head = p;
+  }
+  return head;
+}
+
+static int check(struct node *p)
+{
+  int n = 0;
+
+  for (; p != NULL; p = p -> next, n++) {
+    if (strcmp(*(char **)(p -> data), "in region") != 0) {
+      fprintf(stderr, "Region object has been reclaimed\n");
+      exit(1);
+    }
+  }
+  return n;
+}
+
+int main(void)
+{
+  GC_region_t r;
+  int i;
+
+  GC_INIT();
+  for (i = 0; i < 20; i++) {
+    r = GC_region_begin();
+    if (NULL == r) {
+      fprintf(stderr, "GC_region_begin failed\n");
+      exit(1);
+    }
+    {
+      struct node *list = build(r, N / 2);
+
+      GC_gcollect(); /* Nothing allocated in the region is reclaimed. */
+      if (check(list) != N / 2) {
+        fprintf(stderr, "Region list is broken after collection\n");
+        exit(1);
+      }
+      GC_free(list); /* Ignored. */
+      if (check(build(r, N / 2)) != N / 2) {
+        fprintf(stderr, "Region list is broken\n");
+        exit(1);
+      }
+      if (NULL == GC_region_malloc(r, 100000)) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+      }
+    }
+    GC_region_end(r, GC_REGION_RELEASE);
+  }
+
+  /* An object which escapes the region is kept alive. */
+  r = GC_region_begin();
+  escaped = build(r, 100);
+  GC_region_end(r, GC_REGION_RELEASE | GC_REGION_CHECK);
+  for (i = 0; i < 10; i++) {
+    GC_gcollect();
+    r = GC_region_begin();
+    (void)build(r, 1000);
+    GC_region_end(r, 0);
+  }
+  if (check(escaped) != 100) {
+    fprintf(stderr, "Escaped region list is broken\n");
+    exit(1);
+  }
+
+  /* The check cannot be done while the collector is disabled, so the   */
+  /* blocks are not released (and not reused by the next region).       */
+  GC_disable();
+  r = GC_region_begin();
+  escaped_while_disabled = build(r, 100);
+  GC_region_end(r, GC_REGION_RELEASE | GC_REGION_CHECK);
+  r = GC_region_begin();
+  {
+    struct node *p, *q;
+
+    for (p = build(r, 1000); p != NULL; p = p -> next) {
+      for (q = escaped_while_disabled; q != NULL; q = q -> next) {
+        if (p == q) {
+          fprintf(stderr, "Region released while collection is disabled\n");
+          exit(1);
+        }
+      }
+    }
+  }
+  GC_region_end(r, 0);
+  GC_enable();
+  if (check(escaped_while_disabled) != 100) {
+    fprintf(stderr, "Region list escaped while disabled is broken\n");
+    exit(1);
+  }
+  printf("SUCCEEDED\n");
+  return 0;
+}
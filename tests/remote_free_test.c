@@ -0,0 +1,262 @@
+/*
+ * Test the explicit deallocation of objects by a thread other than the
+ * allocating one (the remote-free queues), in a producer/consumer pattern.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifndef GC_THREADS
+# define GC_THREADS
+#endif
+
+#include "gc.h"
+
+#ifdef GC_PTHREADS
+# include <pthread.h>
+# include <sched.h>
+#else
+# include <windows.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define NPAIRS 2
+#define N 200000
+#define RING 256        /* objects in flight per pair */
+
+struct ring {
+  GC_word *objs[RING];
+  volatile GC_word head;        /* written by the producer only */
+  volatile GC_word tail;        /* written by the consumer only */
+  GC_word id;
+};
+
+static struct ring rings[NPAIRS]; /* scanned as static roots */
+
+static GC_word obj_words(GC_word i)
+{
+  return 2 + i % 7;
+}
+
+static void pause_thread(void)
+{
+# ifdef GC_PTHREADS
+    sched_yield();
+# else
+    Sleep(0);
+# endif
+}
+
+#ifdef GC_PTHREADS
+  static void * produce(void * arg)
+#else
+  static DWORD WINAPI produce(LPVOID arg)
+#endif
+{
+  struct ring *r = (struct ring *)arg;
+  GC_word i;
+
+  for (i = 0; i < N; i++) {
+    GC_word n = obj_words(i);
+    GC_word *p = (GC_word *)(i % 3 == 0
+                                ? GC_MALLOC_ATOMIC(n * sizeof(GC_word))
+                                : GC_MALLOC(n * sizeof(GC_word)));
+    GC_word j;
+
+    if (NULL == p) {
+      fprintf(stderr, "Out of memory\n");
+      exit(1);
+    }
+    if (i % 3 != 0) {
+      for (j = 0; j < n; j++) {
+        if (p[j] != 0) {
+          fprintf(stderr, "Object is not cleared\n");
+          exit(1);
+        }
+      }
+    }
+    /* Distinct contents for each object in flight.     */
+    for (j = 0; j < n; j++) p[j] = (r -> id << 24) + i;
+    while (r -> head - r -> tail >= RING) pause_thread();
+    r -> objs[r -> head % RING] = p;
+#   ifdef GC_PTHREADS
+      __sync_synchronize();
+#   else
+      MemoryBarrier();
+#   endif
+    r -> head++;
+    if (i % (N / 4) == 0) GC_gcollect();
+  }
+  return 0;
+}
+
+#ifdef GC_PTHREADS
+  static void * consume(void * arg)
+#else
+  static DWORD WINAPI consume(LPVOID arg)
+#endif
+{
+  struct ring *r = (struct ring *)arg;
+  GC_word i;
+
+  for (i = 0; i < N; i++) {
+    GC_word n = obj_words(i);
+    GC_word *p;
+    GC_word j;
+
+    while (r -> tail == r -> head) pause_thread();
+#   ifdef GC_PTHREADS
+      __sync_synchronize();
+#   else
+      MemoryBarrier();
+#   endif
+    p = r -> objs[r -> tail % RING];
+    r -> objs[r -> tail % RING] = NULL;
+    r -> tail++;
+    /* The object has not been reused while in flight.  */
+    for (j = 0; j < n; j++) {
+      if (p[j] != (r -> id << 24) + i) {
+        fprintf(stderr, "Object has been reused while in flight\n");
+        exit(1);
+      }
+    }
+    GC_FREE(p);
+  }
+  return 0;
+}
+
+#ifdef GC_PTHREADS
+  typedef pthread_t thread_t;
+  typedef void * thread_fn_t(void *);
+#else
+  typedef HANDLE thread_t;
+  typedef DWORD WINAPI thread_fn_t(LPVOID);
+#endif
+
+static void start_thread(thread_t *t, thread_fn_t fn, void *arg)
+{
+# ifdef GC_PTHREADS
+    if (pthread_create(t, NULL, fn, arg) != 0) {
+      fprintf(stderr, "Thread creation failed\n");
+      exit(1);
+    }
+# else
+    DWORD thread_id;
+
+    *t = CreateThread(NULL, 0, fn, arg, 0, &thread_id);
+    if (NULL == *t) {
+      fprintf(stderr, "Thread creation failed\n");
+      exit(1);
+    }
+# endif
+}
+
+static void join_thread(thread_t t)
+{
+# ifdef GC_PTHREADS
+    if (pthread_join(t, NULL) != 0) {
+      fprintf(stderr, "Thread join failed\n");
+      exit(1);
+    }
+# else
+    if (WaitForSingleObject(t, INFINITE) != WAIT_OBJECT_0) {
+      fprintf(stderr, "Thread join failed\n");
+      exit(1);
+    }
+# endif
+}
+
+/* The objects allocated by the idle owner below and freed by the main */
+/* thread while the former does not allocate anymore.                  */
+#define IDLE_N 200000
+#define IDLE_OBJ_SZ 48
+
+static void **idle_objs;
+static volatile int idle_state; /* 1: allocated, 2: to exit */
+
+#ifdef GC_PTHREADS
+  static void * idle_owner(void * arg)
+#else
+  static DWORD WINAPI idle_owner(LPVOID arg)
+#endif
+{
+  int i;
+
+  for (i = 0; i < IDLE_N; i++) {
+    idle_objs[i] = GC_MALLOC(IDLE_OBJ_SZ);
+    if (NULL == idle_objs[i]) {
+      fprintf(stderr, "Out of memory\n");
+      exit(1);
+    }
+  }
+  idle_state = 1;
+  while (idle_state != 2) pause_thread();
+  return arg;
+}
+
+/* The objects freed to the queue of a thread which no longer refills  */
+/* its free lists should not stay reserved for it.                     */
+static void test_idle_owner(void)
+{
+  thread_t t;
+  size_t free_bytes;
+  int i;
+
+  idle_objs = (void **)GC_MALLOC(IDLE_N * sizeof(void *));
+  if (NULL == idle_objs) {
+    fprintf(stderr, "Out of memory\n");
+    exit(1);
+  }
+  start_thread(&t, idle_owner, NULL);
+  while (idle_state != 1) pause_thread();
+  GC_gcollect();
+  free_bytes = GC_get_free_bytes();
+  for (i = 0; i < IDLE_N; i++) {
+    GC_FREE(idle_objs[i]);
+    idle_objs[i] = NULL;
+  }
+  /* The objects left queued at the first collection are reclaimed by */
+  /* the second one.                                                  */
+  GC_gcollect();
+  GC_gcollect();
+  printf("Free bytes: %lu KiB before, %lu KiB after freeing %lu KiB\n",
+         (unsigned long)(free_bytes >> 10),
+         (unsigned long)(GC_get_free_bytes() >> 10),
+         (unsigned long)((IDLE_N * IDLE_OBJ_SZ) >> 10));
+  if (GC_get_free_bytes() < free_bytes + IDLE_N / 4 * 3 * IDLE_OBJ_SZ) {
+    fprintf(stderr, "Objects freed to an idle owner are not reclaimed\n");
+    exit(1);
+  }
+  idle_state = 2;
+  join_thread(t);
+}
+
+int main(void)
+{
+  int i;
+  thread_t t[2 * NPAIRS];
+
+  GC_INIT();
+  for (i = 0; i < NPAIRS; i++) {
+    rings[i].id = (GC_word)i + 1;
+    start_thread(&t[2 * i], produce, &rings[i]);
+    start_thread(&t[2 * i + 1], consume, &rings[i]);
+  }
+  for (i = 0; i < 2 * NPAIRS; i++) {
+    join_thread(t[i]);
+  }
+  /* The objects are reused rather than reclaimed by the collector.   */
+  printf("Heap size: %lu KiB, collections: %lu\n",
+         (unsigned long)(GC_get_heap_size() >> 10),
+         (unsigned long)GC_get_gc_no());
+  if (GC_get_heap_size() >= (size_t)N * 8 * sizeof(GC_word)) {
+    fprintf(stderr, "Freed objects are not reused\n");
+    exit(1);
+  }
+  test_idle_owner();
+  printf("SUCCEEDED\n");
+  return 0;
+}
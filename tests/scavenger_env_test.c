@@ -0,0 +1,76 @@
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifndef GC_THREADS
+# define GC_THREADS
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "gc.h"
+
+#ifdef GC_PTHREADS
+# include <unistd.h>
+# define SLEEP_MS(ms) usleep((ms) * 1000)
+#else
+# include <windows.h>
+# define SLEEP_MS(ms) Sleep(ms)
+#endif
+
+#define N_OBJS 64
+#define OBJ_SIZE (64 * 1024)
+#define MAX_WAIT_MS 5000
+
+/* Check that the scavenger started by GC_SCAVENGE_INTERVAL does not    */
+/* break the allocation lock if the collector is initialized implicitly */
+/* (by the first allocation, with the lock held), and that it returns   */
+/* the memory of dropped objects while the client is single-threaded.   */
+int main(void)
+{
+  void *objs[N_OBJS];
+  int i, waited;
+
+  putenv((char *)"GC_SCAVENGE_INTERVAL=10");
+  putenv((char *)"GC_SCAVENGE_AGE=1");
+  /* No GC_INIT() call here.    */
+  for (i = 0; i < N_OBJS; i++) {
+    objs[i] = GC_MALLOC_ATOMIC(OBJ_SIZE);
+    if (NULL == objs[i]) {
+      fprintf(stderr, "Out of memory!\n");
+      return 1;
+    }
+  }
+  for (i = 0; i < N_OBJS; i++) {
+    GC_FREE(objs[i]);
+    objs[i] = NULL;
+  }
+
+  /* The scavenger passes are done by the block allocations.  */
+  GC_disable();
+  for (waited = 0; GC_get_scavenged_bytes() == 0; waited += 10) {
+    if (waited >= MAX_WAIT_MS) {
+      if (GC_start_scavenger(10 /* ms */, 1, 0) != 0) {
+        printf("Scavenger is not supported, test skipped\n");
+        return 0;
+      }
+      fprintf(stderr, "Scavenger returned no memory\n");
+      return 1;
+    }
+    SLEEP_MS(10);
+    objs[0] = GC_MALLOC_ATOMIC(OBJ_SIZE);
+    if (NULL == objs[0]) {
+      fprintf(stderr, "Out of memory!\n");
+      return 1;
+    }
+    GC_FREE(objs[0]);
+  }
+  GC_enable();
+  printf("Scavenged %lu bytes in about %d ms\n",
+         (unsigned long)GC_get_scavenged_bytes(), waited);
+  GC_gcollect();
+  printf("SUCCEEDED\n");
+  return 0;
+}
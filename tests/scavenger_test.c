@@ -0,0 +1,86 @@
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifndef GC_THREADS
+# define GC_THREADS
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gc.h"
+
+#ifdef GC_PTHREADS
+# include <unistd.h>
+# define SLEEP_MS(ms) usleep((ms) * 1000)
+#else
+# include <windows.h>
+# define SLEEP_MS(ms) Sleep(ms)
+#endif
+
+#define N_OBJS 256
+#define OBJ_SIZE (64 * 1024)
+#define MAX_WAIT_MS 5000
+
+/* Check that the background scavenger returns the memory of dropped    */
+/* objects to the OS without any collection in the meantime, and that   */
+/* the memory is usable after being reallocated.                        */
+int main(void)
+{
+  void **objs;
+  GC_word gc_no;
+  int i, waited;
+
+  GC_INIT();
+  objs = (void **)GC_MALLOC_UNCOLLECTABLE(N_OBJS * sizeof(void *));
+  if (NULL == objs) {
+    fprintf(stderr, "Out of memory!\n");
+    return 1;
+  }
+  for (i = 0; i < N_OBJS; i++) {
+    objs[i] = GC_MALLOC_ATOMIC(OBJ_SIZE);
+    if (NULL == objs[i]) {
+      fprintf(stderr, "Out of memory!\n");
+      return 1;
+    }
+    memset(objs[i], i, OBJ_SIZE);
+  }
+  for (i = 0; i < N_OBJS; i++) {
+    GC_FREE(objs[i]);
+    objs[i] = NULL;
+  }
+
+  if (GC_start_scavenger(10 /* ms */, 2, 0) != 0) {
+    printf("Scavenger is not supported, test skipped\n");
+    return 0;
+  }
+  gc_no = GC_get_gc_no();
+  GC_disable();
+  for (waited = 0; GC_get_scavenged_bytes() == 0; waited += 10) {
+    if (waited >= MAX_WAIT_MS) {
+      fprintf(stderr, "Scavenger returned no memory\n");
+      return 1;
+    }
+    SLEEP_MS(10);
+  }
+  GC_enable();
+  printf("Scavenged %lu bytes in about %d ms (gc_no %lu -> %lu)\n",
+         (unsigned long)GC_get_scavenged_bytes(), waited,
+         (unsigned long)gc_no, (unsigned long)GC_get_gc_no());
+
+  /* Reuse the returned memory.       */
+  for (i = 0; i < N_OBJS; i++) {
+    objs[i] = GC_MALLOC_ATOMIC(OBJ_SIZE);
+    if (NULL == objs[i]) {
+      fprintf(stderr, "Out of memory!\n");
+      return 1;
+    }
+    memset(objs[i], 0x5a, OBJ_SIZE);
+  }
+  GC_gcollect();
+  printf("SUCCEEDED\n");
+  return 0;
+}
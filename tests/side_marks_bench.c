@@ -0,0 +1,96 @@
+/*
+ * THIS MATERIAL IS PROVIDED AS IS, WITH ABSOLUTELY NO WARRANTY EXPRESSED
+ * OR IMPLIED.  ANY USE IS AT YOUR OWN RISK.
+ *
+ * Permission is hereby granted to use or copy this program
+ * for any purpose,  provided the above notices are retained on all copies.
+ * Permission to modify the code and to distribute modified code is granted,
+ * provided the above notices are retained, and a notice that the code was
+ * modified is included with the above copyright notice.
+ */
+
+/* Measure the full collection time of a large heap of small objects,   */
+/* i.e. of many blocks, most of them sparsely live, so that clearing    */
+/* the marks and sweeping are a significant part of it.  The results    */
+/* of the builds with and without SIDE_MARK_BITS are to be compared.    */
+/* The heap size (in MB) may be given as the first argument; the        */
+/* default is kept small for "make check".                              */
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "private/gc_priv.h"
+
+#define DEFAULT_HEAP_MB 64
+#define N_COLLECTIONS 8
+#define MAX_OBJ_WORDS 24
+#define LIVE_RATIO 8            /* one object in LIVE_RATIO is kept     */
+
+#ifdef SIDE_MARK_BITS
+# define MARK_BITS_LAYOUT "side tables"
+#else
+# define MARK_BITS_LAYOUT "block headers"
+#endif
+
+int main(int argc, char **argv)
+{
+    size_t heap_mb = argc > 1 ? (size_t)atol(argv[1]) : DEFAULT_HEAP_MB;
+    size_t n_live, n_allocd = 0;
+    size_t total = 0;
+    void **live;
+    size_t i;
+    unsigned long elapsed;
+    CLOCK_TYPE start_time, done_time;
+
+    GC_INIT();
+    if (heap_mb == 0) {
+        fprintf(stderr, "Usage: %s [HEAP_MB]\n", argv[0]);
+        return 1;
+    }
+    GC_expand_hp(heap_mb << 20);
+    /* The kept objects are referenced from an uncollectable array, and */
+    /* interleaved with the garbage ones in the blocks.                 */
+    n_live = (heap_mb << 20) / LIVE_RATIO / (MAX_OBJ_WORDS * sizeof(word))
+             * 2;
+    live = (void **)GC_MALLOC_UNCOLLECTABLE(n_live * sizeof(void *));
+    if (NULL == live) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    GC_disable();
+    for (i = 0; total < (heap_mb << 20) / 2; i++) {
+        size_t lb = (1 + i % MAX_OBJ_WORDS) * sizeof(word);
+        void *p = i % 3 == 0 ? GC_MALLOC_ATOMIC(lb) : GC_MALLOC(lb);
+
+        if (NULL == p) {
+            fprintf(stderr, "Out of memory\n");
+            return 1;
+        }
+        if (i % LIVE_RATIO == 0 && n_allocd < n_live) {
+            *(word *)p = ~(word)p;
+            live[n_allocd++] = p;
+        }
+        total += lb;
+    }
+    GC_enable();
+    GC_gcollect();
+
+    GET_TIME(start_time);
+    for (i = 0; i < N_COLLECTIONS; i++) {
+        GC_gcollect();
+    }
+    GET_TIME(done_time);
+    elapsed = MS_TIME_DIFF(done_time, start_time);
+    for (i = 0; i < n_allocd; i++) {
+        if (*(word *)live[i] != ~(word)live[i]) {
+            fprintf(stderr, "Kept object %p has been collected\n", live[i]);
+            return 1;
+        }
+    }
+    printf("Heap %lu MiB, %lu blocks: %lu ms per full collection"
+           " (mark bits in " MARK_BITS_LAYOUT ")\n",
+           (unsigned long)(GC_get_heap_size() >> 20),
+           (unsigned long)(GC_get_heap_size() / HBLKSIZE),
+           elapsed / N_COLLECTIONS);
+    return 0;
+}
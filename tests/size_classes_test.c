@@ -0,0 +1,71 @@
+/*
+ * Test the custom size classes and the size profiling.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "gc.h"
+
+int main(void)
+{
+  static const size_t bad_sizes[] = { 1000, 600 };
+  static const size_t sizes[] = { 600, 1000 };
+  void *p, *q, *r;
+  int i;
+
+  if (0 == GC_set_size_classes(bad_sizes, 2)) {
+    fprintf(stderr, "Unsorted size classes are accepted\n");
+    exit(1);
+  }
+  if (GC_set_size_classes(sizes, 2) != 0) {
+    fprintf(stderr, "GC_set_size_classes failed\n");
+    exit(1);
+  }
+  GC_INIT();
+  if (0 == GC_set_size_classes(sizes, 2)) {
+    fprintf(stderr, "Size classes are accepted after GC_INIT\n");
+    exit(1);
+  }
+
+  /* Both are in the class of 600 bytes (the tiny sizes end well below  */
+  /* 500 bytes even with 16-byte granules).                             */
+  p = GC_MALLOC(500);
+  q = GC_MALLOC(600);
+  r = GC_MALLOC(601);
+  if (NULL == p || NULL == q || NULL == r) {
+    fprintf(stderr, "Out of memory\n");
+    exit(1);
+  }
+  if (GC_size(p) < 600 || GC_size(p) != GC_size(q)) {
+    fprintf(stderr, "Wrong size class of 500 bytes: %lu\n",
+            (unsigned long)GC_size(p));
+    exit(1);
+  }
+  if (GC_size(r) < 601 || GC_size(r) > 1024 + sizeof(void *)) {
+    fprintf(stderr, "Wrong size class of 601 bytes: %lu\n",
+            (unsigned long)GC_size(r));
+    exit(1);
+  }
+  p = GC_MALLOC_ATOMIC(1000);
+  if (NULL == p || GC_size(p) < 1000) {
+    fprintf(stderr, "Wrong atomic object of 1000 bytes\n");
+    exit(1);
+  }
+
+  GC_start_size_profiling();
+  for (i = 0; i < 10000; i++) {
+    p = GC_MALLOC(i % 2 == 0 ? 520 : 900);
+    if (NULL == p) {
+      fprintf(stderr, "Out of memory\n");
+      exit(1);
+    }
+  }
+  GC_print_size_profile();
+  printf("SUCCEEDED\n");
+  return 0;
+}
@@ -1206,6 +1206,13 @@ void run_one_test(void)
             GC_word result = (GC_word) GC_memalign(i, 17);
             if (result % i != 0 || result == 0 || *(int *)result != 0) FAIL;
           }
+          /* Power-of-two alignments need no interior pointers.         */
+          for (i = 2 * sizeof(GC_word); i <= 256 * 1024; i *= 2) {
+            void *p = GC_memalign(i, i);
+
+            if (0 == p || (GC_word)p % i != 0 || GC_base(p) != p
+                || GC_size(p) < i || *(int *)p != 0) FAIL;
+          }
         }
 #     ifndef ALL_INTERIOR_POINTERS
 #      if defined(RS6000) || defined(POWERPC)
@@ -1319,6 +1326,7 @@ void check_heap_stats(void)
 {
     size_t max_heap_sz;
     int i;
+    CLOCK_TYPE start_time, done_time;
 #   ifndef GC_NO_FINALIZATION
       int still_live;
 #     ifdef FINALIZE_ON_DEMAND
@@ -1360,6 +1368,7 @@ void check_heap_stats(void)
     /* Garbage collect repeatedly so that all inaccessible objects      */
     /* can be finalized.                                                */
       while (GC_collect_a_little()) { }
+      GET_TIME(start_time);
       for (i = 0; i < 16; i++) {
         GC_gcollect();
 #       ifndef GC_NO_FINALIZATION
@@ -1369,6 +1378,7 @@ void check_heap_stats(void)
                 GC_invoke_finalizers();
 #       endif
       }
+      GET_TIME(done_time);
       if (print_stats) {
         struct GC_stack_base sb;
         int res = GC_get_stack_base(&sb);
@@ -1383,6 +1393,15 @@ void check_heap_stats(void)
         }
       }
     GC_printf("Completed %u tests\n", n_tests);
+    /* To compare the layouts of the mark bits on the same heap.        */
+#   ifdef SIDE_MARK_BITS
+#     define MARK_BITS_LAYOUT "side tables"
+#   else
+#     define MARK_BITS_LAYOUT "block headers"
+#   endif
+    GC_printf("Full collections took %lu ms on average"
+              " (mark bits in " MARK_BITS_LAYOUT ")\n",
+              (unsigned long)MS_TIME_DIFF(done_time, start_time) / 16);
     GC_printf("Allocated %d collectable objects\n", collectable_count);
     GC_printf("Allocated %d uncollectable objects\n",
                   uncollectable_count);
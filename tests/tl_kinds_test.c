@@ -0,0 +1,146 @@
+/*
+ * Test the thread-local allocation of the explicitly typed and
+ * uncollectable objects from several threads.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifndef GC_THREADS
+# define GC_THREADS
+#endif
+
+#include "gc.h"
+#include "gc_typed.h"
+
+#ifdef GC_PTHREADS
+# include <pthread.h>
+#else
+# include <windows.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define NTHREADS 4
+#define N 20000
+
+struct node {
+  GC_word val;
+  struct node *next;
+};
+
+static GC_descr node_descr;
+
+/* The uncollectable objects are only referenced from here.     */
+static GC_word hidden[NTHREADS][N];
+
+#ifdef GC_PTHREADS
+  static void * test(void * arg)
+#else
+  static DWORD WINAPI test(LPVOID arg)
+#endif
+{
+  int id = (int)(GC_word)arg;
+  struct node *head = NULL;
+  struct node *p;
+  int i;
+
+  for (i = 0; i < N; i++) {
+    GC_word *u = (GC_word *)GC_MALLOC_UNCOLLECTABLE(3 * sizeof(GC_word));
+
+    if (NULL == u) {
+      fprintf(stderr, "Out of memory\n");
+      exit(1);
+    }
+    u[0] = (GC_word)i;
+    u[2] = (GC_word)id;
+    hidden[id][i] = GC_HIDE_POINTER(u);
+
+    p = (struct node *)GC_MALLOC_EXPLICITLY_TYPED(sizeof(struct node),
+                                                  node_descr);
+    if (NULL == p) {
+      fprintf(stderr, "Out of memory\n");
+      exit(1);
+    }
+    if (p -> next != NULL) {
+      fprintf(stderr, "Typed object is not cleared\n");
+      exit(1);
+    }
+    p -> val = (GC_word)i;
+    p -> next = head;
+    head = p;
+    if (i % (N / 4) == 0) GC_gcollect();
+  }
+  GC_gcollect();
+
+  /* The list is only reachable through the typed "next" fields.       */
+  for (i = N - 1, p = head; i >= 0; i--, p = p -> next) {
+    if (NULL == p || p -> val != (GC_word)i) {
+      fprintf(stderr, "Thread %d: typed list is broken at node %d\n", id, i);
+      exit(1);
+    }
+  }
+  if (p != NULL) {
+    fprintf(stderr, "Thread %d: typed list is too long\n", id);
+    exit(1);
+  }
+  for (i = 0; i < N; i++) {
+    GC_word *u = (GC_word *)GC_REVEAL_POINTER(hidden[id][i]);
+
+    if (u[0] != (GC_word)i || u[2] != (GC_word)id) {
+      fprintf(stderr, "Thread %d: uncollectable object %d is corrupted\n",
+              id, i);
+      exit(1);
+    }
+    GC_FREE(u);
+  }
+  return 0;
+}
+
+int main(void)
+{
+  GC_word bitmap[GC_BITMAP_SIZE(struct node)] = { 0 };
+  int i;
+# ifdef GC_PTHREADS
+    pthread_t t[NTHREADS];
+# else
+    HANDLE t[NTHREADS];
+# endif
+
+  GC_INIT();
+  GC_set_bit(bitmap, GC_WORD_OFFSET(struct node, next));
+  node_descr = GC_make_descriptor(bitmap, GC_WORD_LEN(struct node));
+  for (i = 0; i < NTHREADS; i++) {
+#   ifdef GC_PTHREADS
+      if (pthread_create(&t[i], NULL, test, (void *)(GC_word)i) != 0) {
+        fprintf(stderr, "Thread creation failed\n");
+        exit(1);
+      }
+#   else
+      DWORD thread_id;
+
+      t[i] = CreateThread(NULL, 0, test, (LPVOID)(GC_word)i, 0, &thread_id);
+      if (NULL == t[i]) {
+        fprintf(stderr, "Thread creation failed\n");
+        exit(1);
+      }
+#   endif
+  }
+  for (i = 0; i < NTHREADS; i++) {
+#   ifdef GC_PTHREADS
+      if (pthread_join(t[i], NULL) != 0) {
+        fprintf(stderr, "Thread join failed\n");
+        exit(1);
+      }
+#   else
+      if (WaitForSingleObject(t[i], INFINITE) != WAIT_OBJECT_0) {
+        fprintf(stderr, "Thread join failed\n");
+        exit(1);
+      }
+#   endif
+  }
+  printf("SUCCEEDED\n");
+  return 0;
+}
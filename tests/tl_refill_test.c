@@ -0,0 +1,280 @@
+/*
+ * Test the adaptive refill of the thread-local free lists
+ * (GC_set_tl_refill_limits and the related GC_prof_stats_s fields).
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "gc.h"
+
+#ifdef GC_PTHREADS
+# include <pthread.h>
+#endif
+
+#define N 100000
+#define OBJ_SZ 16
+#define SMALL_BATCH 1024
+
+static void *kept;
+
+static void get_stats(struct GC_prof_stats_s *pstats)
+{
+  if (GC_get_prof_stats(pstats, sizeof(*pstats)) != sizeof(*pstats)) {
+    fprintf(stderr, "GC_get_prof_stats failed\n");
+    exit(1);
+  }
+}
+
+/* Return the number of the locked refills done by N allocations. */
+static GC_word locked_refills(size_t min_bytes, size_t max_bytes)
+{
+  struct GC_prof_stats_s stats;
+  GC_word before;
+  int i;
+
+  GC_set_tl_refill_limits(min_bytes, max_bytes);
+  get_stats(&stats);
+  before = stats.tl_locked_refills;
+  for (i = 0; i < N; i++) {
+    kept = GC_MALLOC(OBJ_SZ);
+    if (NULL == kept) {
+      fprintf(stderr, "Out of memory\n");
+      exit(1);
+    }
+  }
+  get_stats(&stats);
+  return stats.tl_locked_refills - before;
+}
+
+#ifdef GC_PTHREADS
+  static void *alloc_many(void *arg)
+  {
+    int i;
+
+    for (i = 0; i < N; i++) {
+      kept = GC_MALLOC(OBJ_SZ);
+      if (NULL == kept) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+      }
+    }
+    return arg;
+  }
+
+  /* Return the number of all the refills done by N allocations in a    */
+  /* new thread (so that the allocation lock is needed, and the shared  */
+  /* mode is used if supported).                                        */
+  static GC_word thread_refills(void)
+  {
+    struct GC_prof_stats_s stats;
+    GC_word before;
+    pthread_t t;
+
+    get_stats(&stats);
+    before = stats.tl_refills;
+    if (pthread_create(&t, NULL, alloc_many, NULL) != 0) {
+      fprintf(stderr, "Thread creation failed\n");
+      exit(1);
+    }
+    if (pthread_join(t, NULL) != 0) {
+      fprintf(stderr, "Thread join failed\n");
+      exit(1);
+    }
+    get_stats(&stats);
+    return stats.tl_refills - before;
+  }
+
+# define IDLE_ALLOCS 300    /* a few more than those served directly   */
+
+  static pthread_mutex_t idle_lock = PTHREAD_MUTEX_INITIALIZER;
+  static pthread_cond_t idle_cond = PTHREAD_COND_INITIALIZER;
+  static int idle_state = 0; /* 1: the thread is idle, 2: it may exit  */
+  static void **live;
+
+  static void set_idle_state(int state)
+  {
+    pthread_mutex_lock(&idle_lock);
+    idle_state = state;
+    pthread_cond_broadcast(&idle_cond);
+    pthread_mutex_unlock(&idle_lock);
+  }
+
+  static void wait_idle_state(int state)
+  {
+    pthread_mutex_lock(&idle_lock);
+    while (idle_state != state)
+      pthread_cond_wait(&idle_cond, &idle_lock);
+    pthread_mutex_unlock(&idle_lock);
+  }
+
+  static void *alloc_then_idle(void *arg)
+  {
+    int i;
+
+    for (i = 0; i < IDLE_ALLOCS; i++) {
+      kept = GC_MALLOC(OBJ_SZ);
+      if (NULL == kept) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+      }
+    }
+    set_idle_state(1);
+    wait_idle_state(2);
+    return arg;
+  }
+
+  /* Return the bytes held by the thread-local free lists after a few   */
+  /* collections while a thread, which has refilled its list with the   */
+  /* given batch (from the blocks left half-full by a collection), is   */
+  /* idle.                                                              */
+  static GC_word idle_stranded_bytes(size_t batch)
+  {
+    struct GC_prof_stats_s stats;
+    pthread_t t;
+    int i;
+
+    for (i = 0; i < N; i++) {
+      void **q = (void **)GC_MALLOC(OBJ_SZ);
+
+      if (NULL == q) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+      }
+      if (i % 2 == 0) {
+        *q = live;
+        live = q;
+      }
+    }
+    GC_gcollect();
+    GC_set_tl_refill_limits(batch, batch);
+    if (pthread_create(&t, NULL, alloc_then_idle, NULL) != 0) {
+      fprintf(stderr, "Thread creation failed\n");
+      exit(1);
+    }
+    wait_idle_state(1);
+    for (i = 0; i < 3; i++) GC_gcollect();
+    get_stats(&stats);
+    set_idle_state(2);
+    if (pthread_join(t, NULL) != 0) {
+      fprintf(stderr, "Thread join failed\n");
+      exit(1);
+    }
+    live = NULL;
+    return stats.tl_stranded_bytes;
+  }
+#endif
+
+int main(void)
+{
+  struct GC_prof_stats_s stats;
+  size_t min_bytes, max_bytes, lo, hi;
+  GC_word small, large;
+  int i;
+
+# ifdef __linux__
+    /* The per-CPU free lists (if any) would be used instead.   */
+    putenv((char *)"GC_NO_PER_CPU_ALLOC=1");
+# endif
+  GC_INIT();
+  GC_get_tl_refill_limits(&min_bytes, &max_bytes);
+  if (0 == min_bytes || min_bytes > max_bytes) {
+    fprintf(stderr, "Wrong default refill limits\n");
+    exit(1);
+  }
+  GC_set_tl_refill_limits(max_bytes, min_bytes);
+  GC_get_tl_refill_limits(&lo, &hi);
+  if (lo != hi) {
+    fprintf(stderr, "Refill limits are not ordered\n");
+    exit(1);
+  }
+
+  for (i = 0; i < N; i++) {
+    kept = GC_MALLOC(OBJ_SZ);
+    if (NULL == kept) {
+      fprintf(stderr, "Out of memory\n");
+      exit(1);
+    }
+  }
+  get_stats(&stats);
+  if (0 == stats.tl_refills) {
+    printf("Thread-local allocation is not supported, skipped\n");
+    return 0;
+  }
+
+  /* Without collections, a smaller fixed batch means more locking.     */
+  GC_disable();
+  small = locked_refills(SMALL_BATCH, SMALL_BATCH);
+  large = locked_refills(4 * SMALL_BATCH, 4 * SMALL_BATCH);
+  printf("Locked refills: %lu (batch of %d bytes), %lu (batch of %d)\n",
+         (unsigned long)small, SMALL_BATCH, (unsigned long)large,
+         4 * SMALL_BATCH);
+  if (small < (GC_word)N * OBJ_SZ / SMALL_BATCH / 2) {
+    fprintf(stderr, "Too few locked refills\n");
+    exit(1);
+  }
+  if (small <= large) {
+    fprintf(stderr, "A larger batch does not reduce the locked refills\n");
+    exit(1);
+  }
+# ifdef GC_PTHREADS
+    /* Each refill is counted, whatever the path taken.  The first      */
+    /* allocations of a new thread are done directly, thus the slack.   */
+    GC_set_tl_refill_limits(SMALL_BATCH, SMALL_BATCH);
+    small = thread_refills();
+    printf("Refills in a thread: %lu (batch of %d bytes)\n",
+           (unsigned long)small, SMALL_BATCH);
+    if (small < (GC_word)N * OBJ_SZ / SMALL_BATCH / 2) {
+      fprintf(stderr, "Too few refills counted\n");
+      exit(1);
+    }
+# endif
+  GC_enable();
+
+  /* The adaptive batch.        */
+  GC_set_tl_refill_limits(min_bytes, max_bytes);
+  for (i = 0; i < 10 * N; i++) {
+    kept = GC_MALLOC(OBJ_SZ);
+    if (NULL == kept) {
+      fprintf(stderr, "Out of memory\n");
+      exit(1);
+    }
+    if (i % N == 0 && NULL == GC_MALLOC_ATOMIC(3 * OBJ_SZ)) {
+      fprintf(stderr, "Out of memory\n");
+      exit(1);
+    }
+  }
+  GC_gcollect();
+  get_stats(&stats);
+  printf("Refills: %lu, locked: %lu, stranded bytes: %lu\n",
+         (unsigned long)stats.tl_refills,
+         (unsigned long)stats.tl_locked_refills,
+         (unsigned long)stats.tl_stranded_bytes);
+  if (stats.tl_locked_refills > stats.tl_refills) {
+    fprintf(stderr, "Locked refills exceed all refills\n");
+    exit(1);
+  }
+  if (0 == stats.tl_stranded_bytes) {
+    fprintf(stderr, "Stranded bytes are not counted\n");
+    exit(1);
+  }
+  if (stats.tl_stranded_bytes > 16 * max_bytes) {
+    fprintf(stderr, "Too many stranded bytes\n");
+    exit(1);
+  }
+# ifdef GC_PTHREADS
+    /* The lists not refilled in a collection cycle are trimmed.  */
+    stats.tl_stranded_bytes = idle_stranded_bytes(max_bytes);
+    printf("Stranded bytes with an idle thread: %lu (batch of %lu bytes)\n",
+           (unsigned long)stats.tl_stranded_bytes, (unsigned long)max_bytes);
+    if (stats.tl_stranded_bytes > max_bytes / 2) {
+      fprintf(stderr, "Idle free lists are not trimmed\n");
+      exit(1);
+    }
+# endif
+  return 0;
+}
@@ -38,6 +38,152 @@ static GC_bool keys_initialized;
         /* fnlz_mlc module unless the client uses the latter one.       */
 #endif
 
+GC_INNER ptr_t * GC_eobjfreelist = NULL;
+        /* Same as above for typd_mlc module.   */
+
+/* Return the thread-local freelists structure of the current thread    */
+/* or NULL if there is none.                                            */
+static GC_tlfs current_tlfs(void)
+{
+# if !defined(USE_PTHREAD_SPECIFIC) && !defined(USE_WIN32_SPECIFIC)
+    GC_key_t k = GC_thread_key;
+
+    if (EXPECT(0 == k, FALSE)) return NULL;
+    return (GC_tlfs)GC_getspecific(k);
+# else
+    if (!EXPECT(keys_initialized, TRUE)) return NULL;
+    return (GC_tlfs)GC_getspecific(GC_thread_key);
+# endif
+}
+
+#ifndef TL_REFILL_GROW
+# define TL_REFILL_GROW 8       /* Refills of a free list within a      */
+                                /* collection cycle doubling its batch. */
+#endif
+#ifndef TL_REFILL_SHRINK
+# define TL_REFILL_SHRINK 2     /* Fewer refills within a cycle halve   */
+                                /* the batch.                           */
+#endif
+#define TL_REFILL_INIT_LOG 2    /* A block worth of objects.            */
+#define TL_REFILL_MAX_LOG 5
+
+GC_INNER size_t GC_tl_refill_min = HBLKSIZE / 4;
+GC_INNER size_t GC_tl_refill_max = 8 * HBLKSIZE;
+GC_INNER word GC_tl_locked_refills = 0;
+GC_INNER word GC_tl_lockless_refills = 0;
+GC_INNER word GC_tl_stranded_bytes = 0;
+
+GC_INNER size_t GC_tl_refill_bytes(void **result)
+{
+    GC_tlfs p = current_tlfs();
+    word i;
+    unsigned log;
+    size_t bytes;
+
+    if (NULL == p) return 0;
+    i = ((word)result - (word)(p -> ptrfree_freelists)) / sizeof(void *);
+    if ((word)result < (word)(p -> ptrfree_freelists)
+        || i >= TL_FREELIST_KINDS * TINY_FREELISTS)
+      return 0;
+
+    /* The owner thread updates the state without the lock.  A list     */
+    /* which is refilled often between collections gets a larger batch  */
+    /* (thus the lock is acquired less often).  The batch of one        */
+    /* refilled rarely is reduced by the collector (see                 */
+    /* decay_refills).  A race with the latter could only leave a stale */
+    /* batch size.                                                      */
+    log = p -> refill_log[i];
+    if (p -> refill_count[i] < 0xff
+        && ++(p -> refill_count[i]) % TL_REFILL_GROW == 0
+        && log < TL_REFILL_MAX_LOG) {
+      log++;
+    }
+    p -> refill_log[i] = (unsigned char)log;
+
+    bytes = ((size_t)HBLKSIZE << log) >> TL_REFILL_INIT_LOG;
+    if (bytes < GC_tl_refill_min) bytes = GC_tl_refill_min;
+    if (bytes > GC_tl_refill_max) bytes = GC_tl_refill_max;
+    return bytes;
+}
+
+#ifdef USE_ALLOC_SPANS
+# define SPAN_FLAGS (GC_SPAN_TAG | GC_SPAN_CLEAR)
+# define IS_SPAN(q) (((word)(q) & GC_SPAN_TAG) != 0)
+
+  GC_INNER ptr_t GC_tl_build_fl(struct hblk *h, size_t words, GC_bool clear,
+                                void **result)
+  {
+    GC_tlfs p = current_tlfs();
+
+    /* Only the ptrfree and normal lists qualify: the free objects of   */
+    /* a span are not linked, so their first word is not a valid gcj    */
+    /* vtable pointer (or 0) if a stale pointer makes the marker look   */
+    /* at them, and the finalized kinds use their own inline copy.      */
+    if (p != NULL && (word)result >= (word)(p -> ptrfree_freelists)
+        && (word)result < (word)(p -> normal_freelists + TINY_FREELISTS)) {
+      GC_ASSERT(HDR(h) -> hb_sz == WORDS_TO_BYTES(words));
+      return (ptr_t)((word)h | GC_SPAN_TAG | (clear ? GC_SPAN_CLEAR : 0));
+    }
+    return GC_build_fl(h, words, clear, 0);
+  }
+
+  /* Set the mark bits of the objects not yet allocated from the span. */
+  static void set_span_marks(ptr_t q)
+  {
+    struct hblk *h = HBLKPTR(q);
+    hdr *hhdr = HDR(h);
+    size_t sz = hhdr -> hb_sz;
+    ptr_t lim = (ptr_t)h + HBLKSIZE - sz;
+
+    for (q = (ptr_t)((word)q & ~(word)SPAN_FLAGS); (word)q <= (word)lim;
+         q += sz) {
+      unsigned bit_no = MARK_BIT_NO(q - (ptr_t)h, sz);
+
+      if (!mark_bit_from_hdr(hhdr, bit_no)) {
+        set_mark_bit_from_hdr(hhdr, bit_no);
+        ++hhdr -> hb_n_marks;
+      }
+    }
+  }
+
+  /* Turn the rest of the span q into a free list and prepend it to     */
+  /* the global one gfl.                                                */
+  static void return_span(ptr_t q, void **gfl)
+  {
+    struct hblk *h = HBLKPTR(q);
+    size_t sz = HDR(h) -> hb_sz;
+    ptr_t lim = (ptr_t)h + HBLKSIZE - sz;
+    GC_bool clear = ((word)q & GC_SPAN_CLEAR) != 0;
+
+    for (q = (ptr_t)((word)q & ~(word)SPAN_FLAGS); (word)q <= (word)lim;
+         q += sz) {
+      if (clear) BZERO(q, sz);
+      obj_link(q) = *gfl;
+      *gfl = q;
+    }
+  }
+#endif /* USE_ALLOC_SPANS */
+
+/* Return the number of bytes held by the nonempty free list q.        */
+static word fl_bytes(ptr_t q)
+{
+    word sz;
+    word n = 0;
+
+#   ifdef USE_ALLOC_SPANS
+      if (IS_SPAN(q)) {
+        ptr_t h = (ptr_t)HBLKPTR(q);
+
+        sz = HDR(h) -> hb_sz;
+        q = (ptr_t)((word)q & ~(word)SPAN_FLAGS);
+        return (HBLKSIZE - (word)(q - h)) / sz * sz;
+      }
+#   endif
+    sz = HDR(q) -> hb_sz;
+    for (; q != 0; q = (ptr_t)obj_link(q)) n++;
+    return n * sz;
+}
+
 /* Return a single nonempty freelist fl to the global one pointed to    */
 /* by gfl.                                                              */
 
@@ -45,6 +191,12 @@ static void return_single_freelist(void *fl, void **gfl)
 {
     void *q, **qptr;
 
+#   ifdef USE_ALLOC_SPANS
+      if (IS_SPAN(fl)) {
+        return_span((ptr_t)fl, gfl);
+        return;
+      }
+#   endif
     if (*gfl == 0) {
       *gfl = fl;
     } else {
@@ -82,6 +234,649 @@ static void return_freelists(void **fl, void **gfl)
     }
 }
 
+#ifndef NO_TL_HBLK_CACHE
+# ifdef LOCK_FREE_HBLK_CACHE
+    GC_INNER volatile AO_t GC_tl_hblk_users = 0;
+    GC_INNER volatile AO_t GC_tl_hblk_flushing = 0;
+# endif
+
+  GC_INNER void GC_flush_tl_hblk_cache(GC_tlfs p)
+  {
+    unsigned i;
+
+    GC_ASSERT(I_HOLD_LOCK());
+    for (i = 0; i < p -> hblk_cache_cnt; ++i) {
+      GC_freehblk(p -> hblk_cache[i]);
+    }
+    p -> hblk_cache_cnt = 0;
+    GC_bytes_allocd += p -> hblk_bytes_allocd;
+    p -> hblk_bytes_allocd = 0;
+    GC_tl_lockless_refills += p -> hblk_refills;
+    p -> hblk_refills = 0;
+  }
+
+  GC_INNER struct hblk * GC_tl_allochblk(size_t lb, int k)
+  {
+    GC_tlfs p = current_tlfs();
+    struct hblk *h;
+    unsigned n;
+
+#   ifdef FINE_GRAINED_LOCKS
+      GC_ASSERT(I_HOLD_LOCK() || I_HOLD_HBLK_LOCK());
+#   else
+      GC_ASSERT(I_HOLD_LOCK());
+#   endif
+    if (NULL == p || GC_incremental) {
+      /* The cached blocks would not be treated as dirty, and they      */
+      /* should not survive a collection in progress.                   */
+      return GC_allochblk(lb, k, 0);
+    }
+    SHARED_COUNT_ADD(GC_bytes_allocd, p -> hblk_bytes_allocd);
+    p -> hblk_bytes_allocd = 0;
+    SHARED_COUNT_ADD(GC_tl_lockless_refills, p -> hblk_refills);
+    p -> hblk_refills = 0;
+    n = p -> hblk_cache_cnt;
+    if (0 == n) {
+      /* Refill the cache.  The blocks are allocated as NORMAL ones, so */
+      /* that black-listed blocks are avoided whatever their final      */
+      /* kind is.  The free block being split normally stays at the     */
+      /* head of its free list, so this is cheap, and the blocks are    */
+      /* usually adjacent.                                              */
+      while (n < TL_HBLK_CACHE_SZ
+             && (h = GC_allochblk(HBLKSIZE, NORMAL, 0)) != 0) {
+        p -> hblk_cache[n++] = h;
+      }
+      if (0 == n) return GC_allochblk(lb, k, 0);
+    }
+    h = p -> hblk_cache[--n];
+    p -> hblk_cache_cnt = n;
+    if (!GC_setup_hblk(h, lb, k)) {
+      GC_freehblk(h);
+      return 0;
+    }
+    return h;
+  }
+
+  GC_INNER GC_bool GC_tl_hblk_malloc_many(size_t lb, int k, void **result)
+  {
+#   ifdef LOCK_FREE_HBLK_CACHE
+      GC_tlfs p = current_tlfs();
+      struct obj_kind * ok = &GC_obj_kinds[k];
+      size_t lg = BYTES_TO_GRANULES(lb);
+      struct hblk *h;
+      unsigned n;
+      GC_bool done = FALSE;
+
+      if (NULL == p || 0 == p -> hblk_cache_cnt || GC_incremental)
+        return FALSE;
+      /* Blocks waiting to be reclaimed and the global free list are    */
+      /* to be used up before new blocks (by GC_generic_malloc_many).   */
+      /* The lists are examined without the lock, but that only         */
+      /* matters for the choice of the block.                           */
+      /* A missing reclaim list could only be allocated with the lock.  */
+      if (NULL == ok -> ok_reclaim_list || ok -> ok_reclaim_list[lg] != 0
+          || ok -> ok_freelist[lg] != 0)
+        return FALSE;
+#     ifdef MARK_BIT_PER_GRANULE
+        /* A missing object map could only be created with the lock.    */
+        if (NULL == GC_obj_map[lg]) return FALSE;
+#     endif
+
+      /* Announce ourselves to GC_flush_thread_local_hblks, which       */
+      /* waits for us (before stopping the world) once it has set       */
+      /* GC_tl_hblk_flushing.  The full barriers guarantee that either  */
+      /* it sees our increment or we see the flag.                      */
+      (void)AO_fetch_and_add_full(&GC_tl_hblk_users, 1);
+      if (!AO_load(&GC_tl_hblk_flushing)
+          && (n = p -> hblk_cache_cnt) > 0) {
+        h = p -> hblk_cache[--n];
+        p -> hblk_cache_cnt = n;
+        (void)GC_setup_hblk(h, lb, k); /* cannot fail */
+        if (IS_UNCOLLECTABLE(k)) GC_set_hdr_marks(HDR(h));
+        p -> hblk_bytes_allocd += HBLKSIZE - HBLKSIZE % lb;
+        p -> hblk_refills++;
+        GC_CLASS_ALLOCD(k, lg, HBLKSIZE - HBLKSIZE % lb);
+        /* The list should be stored before the collector can see it.   */
+#       ifdef USE_ALLOC_SPANS
+          *result = GC_tl_build_fl(h, BYTES_TO_WORDS(lb),
+                                   ok -> ok_init || GC_debugging_started,
+                                   result);
+#       else
+          *result = GC_build_fl(h, BYTES_TO_WORDS(lb),
+                                ok -> ok_init || GC_debugging_started, 0);
+#       endif
+        done = TRUE;
+      }
+      (void)AO_fetch_and_add_full(&GC_tl_hblk_users, (AO_t)(-1));
+      return done;
+#   else
+      (void)lb;
+      (void)k;
+      (void)result;
+      return FALSE;
+#   endif
+  }
+#endif /* !NO_TL_HBLK_CACHE */
+
+#ifdef REMOTE_FREE
+# ifndef REMOTE_FREE_QUEUES
+#   define REMOTE_FREE_QUEUES 256       /* Threads beyond that free to  */
+                                        /* the global lists (locking).  */
+# endif
+# ifndef REMOTE_FREE_QUEUE_BYTES
+#   define REMOTE_FREE_QUEUE_BYTES (16 * HBLKSIZE)
+                                        /* Objects freed to a fuller    */
+                                        /* queue go to the global lists.*/
+# endif
+
+  /* The objects explicitly deallocated to the blocks owned by a thread */
+  /* (by any thread) are pushed to its queue without the lock, and the  */
+  /* thread moves them to its free lists as those run dry.  Only the    */
+  /* pointer-free and normal objects are queued.  A queue the owner has */
+  /* not taken objects from since the previous collection (e.g. as the  */
+  /* owner is idle) is dropped by the collector, so that the objects    */
+  /* are reclaimed (unless the thread is in the middle of the taking).  */
+  struct remote_queue {
+    volatile AO_t head;         /* Pushed objects, linked (or 0).       */
+    volatile AO_t bytes;        /* Total size of the objects in head    */
+                                /* and taken (approximate while being   */
+                                /* pushed or taken).                    */
+    ptr_t taken;                /* Objects taken from head by the owner */
+                                /* but not yet moved to its lists.      */
+    GC_bool in_use;             /* Owned by a live thread.              */
+    GC_bool drained;            /* Objects have been taken since the    */
+                                /* recent collection.                   */
+    GC_bool draining;           /* The owner is taking objects.         */
+  };
+
+  /* Each queue occupies separate cache lines.  */
+# define REMOTE_QUEUE_STRIDE \
+        ((sizeof(struct remote_queue) + CACHE_LINE_SIZE - 1) \
+         & ~(word)(CACHE_LINE_SIZE - 1))
+
+  STATIC ptr_t GC_remote_queues = NULL;
+                /* Allocated with the first thread; entry 0 is unused.  */
+
+# define REMOTE_QUEUE(i) \
+        ((struct remote_queue *)(GC_remote_queues \
+                                 + (word)(i) * REMOTE_QUEUE_STRIDE))
+
+# define REMOTE_BYTES_SUB(rq, n) \
+        (void)AO_fetch_and_add(&((rq) -> bytes), (AO_t)0 - (AO_t)(n))
+
+  STATIC void GC_init_remote_queues(void)
+  {
+    ptr_t p;
+    word bytes = REMOTE_FREE_QUEUES * REMOTE_QUEUE_STRIDE + CACHE_LINE_SIZE;
+
+    GC_STATIC_ASSERT(REMOTE_FREE_QUEUES <= 0x10000);
+    GC_ASSERT(I_HOLD_LOCK());
+    p = (ptr_t)GC_scratch_alloc(bytes);
+    if (NULL == p) return;
+    BZERO(p, bytes);
+    GC_remote_queues = (ptr_t)(((word)p + CACHE_LINE_SIZE - 1)
+                               & ~(word)(CACHE_LINE_SIZE - 1));
+  }
+
+  /* Assign a free queue to p.  */
+  STATIC void GC_acquire_remote_queue(GC_tlfs p)
+  {
+    static unsigned next_slot = 1;
+    unsigned i, slot;
+
+    GC_ASSERT(I_HOLD_LOCK());
+    p -> remote_slot = 0;
+    if (NULL == GC_remote_queues) return;
+    for (i = 1; i < REMOTE_FREE_QUEUES; i++) {
+      slot = next_slot;
+      if (++next_slot >= REMOTE_FREE_QUEUES) next_slot = 1;
+      if (!REMOTE_QUEUE(slot) -> in_use) {
+        /* The objects left by the previous owner (if no collection    */
+        /* has occurred since) are inherited.                          */
+        REMOTE_QUEUE(slot) -> in_use = TRUE;
+        REMOTE_QUEUE(slot) -> drained = TRUE;
+        p -> remote_slot = (unsigned short)slot;
+        return;
+      }
+    }
+  }
+
+  GC_INNER GC_bool GC_remote_free(void *p, hdr *hhdr)
+  {
+    int k = hhdr -> hb_obj_kind;
+    struct remote_queue *rq;
+    AO_t head;
+
+    if (0 == hhdr -> hb_owner || (k != PTRFREE && k != NORMAL))
+      return FALSE;
+    GC_ASSERT(GC_remote_queues != NULL);
+    rq = REMOTE_QUEUE(hhdr -> hb_owner);
+    if (AO_load(&(rq -> bytes)) >= REMOTE_FREE_QUEUE_BYTES)
+      return FALSE;
+    if (GC_obj_kinds[k].ok_init) {
+      BZERO((word *)p + 1, hhdr -> hb_sz - sizeof(word));
+    }
+    /* Counted before pushed, so that the collector (dropping the      */
+    /* queue) never subtracts the size of an object not yet added.      */
+    (void)AO_fetch_and_add(&(rq -> bytes), (AO_t)(hhdr -> hb_sz));
+    /* The collector may only see the object linked (or not yet) to    */
+    /* the queue, both are fine.  The object is counted neither in      */
+    /* GC_bytes_freed nor (when reused by the owner) in                 */
+    /* GC_bytes_allocd, unless returned to the global free lists.       */
+    do {
+      head = AO_load(&(rq -> head));
+      obj_link(p) = (ptr_t)head;
+    } while (!AO_compare_and_swap_release(&(rq -> head), head, (AO_t)p));
+    return TRUE;
+  }
+
+  GC_INNER unsigned short GC_tl_remote_slot(void)
+  {
+    GC_tlfs p = current_tlfs();
+
+    return NULL == p ? 0 : p -> remote_slot;
+  }
+
+  GC_INNER GC_bool GC_tl_remote_drain(unsigned short slot, size_t lb, int k,
+                                      void **result)
+  {
+    struct remote_queue *rq = REMOTE_QUEUE(slot);
+    ptr_t q;
+    void **prev;
+    AO_t head;
+    word n = 0;
+
+    GC_ASSERT(slot != 0);
+    if (NULL == rq -> taken && 0 == AO_load(&(rq -> head)))
+      return FALSE;
+    /* Neither list is dropped by a collection from now on (the latter  */
+    /* runs only while the thread is stopped, so only the compiler      */
+    /* could reorder the stores).                                       */
+    rq -> draining = TRUE;
+    rq -> drained = TRUE;
+    AO_compiler_barrier();
+    if (NULL == rq -> taken) {
+      /* The list is stored to taken (which is marked by the collector) */
+      /* before it is detached from head.                               */
+      do {
+        head = AO_load(&(rq -> head));
+        rq -> taken = (ptr_t)head;
+        if (0 == head) break;
+      } while (!AO_compare_and_swap_full(&(rq -> head), head, 0));
+    }
+
+    /* Each object is unlinked from taken before it is linked to        */
+    /* result, so that it is always reachable from either list (or a    */
+    /* register).                                                       */
+    *result = 0;
+    prev = (void **)&(rq -> taken);
+    while ((q = (ptr_t)(*prev)) != NULL) {
+      hdr *hhdr = HDR(q);
+
+      if (hhdr -> hb_sz == lb && hhdr -> hb_obj_kind == k) {
+        *prev = obj_link(q);
+        obj_link(q) = *result;
+        *result = q;
+        n++;
+      } else {
+        prev = &obj_link(q);
+      }
+    }
+    AO_compiler_barrier();
+    rq -> draining = FALSE;
+    if (n != 0) REMOTE_BYTES_SUB(rq, n * lb);
+    return *result != 0;
+  }
+
+  /* Return the objects of the list (linked by their first word) to the */
+  /* global free lists.  The objects are counted as deallocated.  The   */
+  /* total size is returned.  Called with the lock held or in the       */
+  /* shared mode.                                                       */
+  static word return_remote_objs(ptr_t q)
+  {
+    word bytes = 0;
+
+    while (q != NULL) {
+      ptr_t next = obj_link(q);
+      hdr *hhdr = HDR(q);
+      int k = hhdr -> hb_obj_kind;
+      size_t lg = BYTES_TO_GRANULES(hhdr -> hb_sz);
+      void **flh = &(GC_obj_kinds[k].ok_freelist[lg]);
+
+      bytes += hhdr -> hb_sz;
+      FL_LOCK(k, lg);
+      obj_link(q) = *flh;
+      *flh = q;
+      FL_UNLOCK(k, lg);
+      q = next;
+    }
+    SHARED_COUNT_ADD(GC_bytes_freed, bytes);
+    return bytes;
+  }
+
+  /* Same as GC_tl_remote_flush but called with the lock held or in the */
+  /* shared mode (so that the collector could not run concurrently, and */
+  /* taken may be cleared first).                                       */
+  STATIC void GC_remote_flush_inner(struct remote_queue *rq)
+  {
+    ptr_t q = rq -> taken;
+
+    rq -> taken = NULL;
+    REMOTE_BYTES_SUB(rq, return_remote_objs(q));
+  }
+
+  GC_INNER void GC_tl_remote_flush(unsigned short slot)
+  {
+    struct remote_queue *rq = REMOTE_QUEUE(slot);
+    GC_bool shared = FALSE;
+    DCL_LOCK_STATE;
+
+    /* Only the collector could clear taken meanwhile.  */
+    if (NULL == rq -> taken) return;
+#   ifdef FINE_GRAINED_LOCKS
+      shared = GC_enter_shared_alloc();
+#   endif
+    if (!shared) LOCK();
+    GC_remote_flush_inner(rq);
+#   ifdef FINE_GRAINED_LOCKS
+      if (shared) {
+        GC_leave_shared_alloc();
+      } else
+#   endif
+    /* else */ {
+      UNLOCK();
+    }
+  }
+
+  /* Release the queue of p (exiting), returning its objects.  Those    */
+  /* pushed later are inherited by the next owner or reclaimed.         */
+  STATIC void GC_release_remote_queue(GC_tlfs p)
+  {
+    struct remote_queue *rq;
+    AO_t head;
+
+    GC_ASSERT(I_HOLD_LOCK());
+    if (0 == p -> remote_slot) return;
+    rq = REMOTE_QUEUE(p -> remote_slot);
+    GC_remote_flush_inner(rq);
+    do {
+      head = AO_load(&(rq -> head));
+    } while (head != 0
+             && !AO_compare_and_swap_full(&(rq -> head), head, 0));
+    REMOTE_BYTES_SUB(rq, return_remote_objs((ptr_t)head));
+    rq -> in_use = FALSE;
+    p -> remote_slot = 0;
+  }
+
+  /* Unlink the objects of the list (so that a stray pointer to one of  */
+  /* them does not retain the rest), returning their total size.        */
+  static word drop_remote_objs(ptr_t q)
+  {
+    word bytes = 0;
+
+    while (q != NULL) {
+      ptr_t next = obj_link(q);
+
+      bytes += HDR(q) -> hb_sz;
+      obj_link(q) = NULL;
+      q = next;
+    }
+    return bytes;
+  }
+
+  GC_INNER void GC_mark_remote_free_queues(void)
+  {
+    unsigned i;
+
+    if (NULL == GC_remote_queues) return;
+    for (i = 1; i < REMOTE_FREE_QUEUES; i++) {
+      struct remote_queue *rq = REMOTE_QUEUE(i);
+
+      if (rq -> in_use && (rq -> drained || rq -> draining)) {
+        GC_set_fl_marks((ptr_t)rq -> head);
+        GC_set_fl_marks(rq -> taken);
+        rq -> drained = FALSE;
+      } else if (rq -> head != 0 || rq -> taken != NULL) {
+        /* The objects are left unmarked, thus reclaimed.       */
+        REMOTE_BYTES_SUB(rq, drop_remote_objs((ptr_t)rq -> head)
+                             + drop_remote_objs(rq -> taken));
+        rq -> head = 0;
+        rq -> taken = NULL;
+      }
+    }
+  }
+#endif /* REMOTE_FREE */
+
+#ifdef PER_CPU_ALLOC
+# include <stddef.h>
+# include <sys/rseq.h>
+# include <unistd.h>
+
+  /* The free lists of GC_malloc and GC_malloc_atomic of a CPU.  A list */
+  /* is either NULL or a pointer to its first object; it is used by     */
+  /* the threads running on the CPU inside rseq critical sections       */
+  /* (which the kernel aborts if the thread is preempted, migrated or   */
+  /* signaled), so neither a lock nor an atomic operation is needed.    */
+  struct cpu_freelists {
+    void * ptrfree_freelists[TINY_FREELISTS];
+    void * normal_freelists[TINY_FREELISTS];
+  };
+
+  /* Each CPU's lists occupy separate cache lines.  */
+# define CPU_FLS_STRIDE \
+        ((sizeof(struct cpu_freelists) + CACHE_LINE_SIZE - 1) \
+         & ~(word)(CACHE_LINE_SIZE - 1))
+
+  GC_INNER GC_bool GC_no_per_cpu_alloc = FALSE;
+
+  STATIC ptr_t GC_cpu_fls = NULL;
+                /* The lists of all the CPUs, or NULL if the per-CPU    */
+                /* allocation is not used.  Set once (before other      */
+                /* threads are registered).                             */
+  STATIC unsigned GC_cpu_fls_cnt = 0;
+
+  STATIC void GC_init_cpu_freelists(void)
+  {
+    long n;
+    ptr_t p;
+
+    GC_ASSERT(I_HOLD_LOCK());
+    if (GC_no_per_cpu_alloc || 0 == __rseq_size) return;
+    n = sysconf(_SC_NPROCESSORS_CONF);
+    if (n <= 0 || (unsigned long)n > (~(word)0 >> 1) / CPU_FLS_STRIDE)
+      return;
+    p = (ptr_t)GC_scratch_alloc((word)n * CPU_FLS_STRIDE + CACHE_LINE_SIZE);
+    if (NULL == p) return;
+    BZERO(p, (word)n * CPU_FLS_STRIDE + CACHE_LINE_SIZE);
+    GC_cpu_fls_cnt = (unsigned)n;
+    GC_cpu_fls = (ptr_t)(((word)p + CACHE_LINE_SIZE - 1)
+                         & ~(word)(CACHE_LINE_SIZE - 1));
+  }
+
+  /* Both critical sections below start at label 1 and commit by the    */
+  /* last store before label 2.  On abort, the kernel clears rseq_cs    */
+  /* and resumes at label 4 (preceded by the signature), which restarts */
+  /* from label 0 (thus setting rseq_cs again).  The CPU number is read */
+  /* from the rseq area of the thread (at __rseq_offset from the thread */
+  /* pointer); an unregistered area holds a CPU number of -1, thus      */
+  /* exceeding GC_cpu_fls_cnt.                                          */
+# define CPU_CS_BEGIN \
+        ".pushsection __rseq_cs, \"aw\"\n\t" \
+        ".balign 32\n" \
+        "3:\n\t" \
+        ".long 0, 0\n\t" \
+        ".quad 1f, 2f - 1f, 4f\n\t" \
+        ".popsection\n" \
+        "0:\n\t" \
+        "leaq 3b(%%rip), %%rax\n\t" \
+        "movq %%rax, %%fs:8(%[rs])\n" \
+        "1:\n\t" \
+        "movl %%fs:4(%[rs]), %%eax\n\t" \
+        "cmpl %[cnt], %%eax\n\t" \
+        "jae %l[no_cpu]\n\t" \
+        "imulq %[stride], %%rax\n\t" \
+        "addq %[fl], %%rax\n\t"
+# define CPU_CS_END \
+        "2:\n\t" \
+        ".pushsection __rseq_failure, \"ax\"\n\t" \
+        ".byte 0x0f, 0xb9, 0x3d\n\t" \
+        ".long %c[sig]\n" \
+        "4:\n\t" \
+        "jmp 0b\n\t" \
+        ".popsection"
+# define CPU_CS_INPUTS(offset) \
+        [rs] "r" (__rseq_offset), [cnt] "r" (GC_cpu_fls_cnt), \
+        [stride] "r" ((word)CPU_FLS_STRIDE), \
+        [fl] "r" (GC_cpu_fls + (offset)), [sig] "i" (RSEQ_SIG)
+
+  /* Pop the first object (to *result) from the list at the given       */
+  /* offset in the free lists of the current CPU.  Return 1 on success, */
+  /* 0 if the list is empty, -1 if the CPU has no free lists.           */
+  static int cpu_fl_pop(word offset, void **result)
+  {
+    __asm__ goto (CPU_CS_BEGIN
+                  "movq (%%rax), %%rcx\n\t"
+                  "testq %%rcx, %%rcx\n\t"
+                  "jz %l[empty]\n\t"
+                  "movq (%%rcx), %%rdx\n\t"
+                  "movq %%rcx, (%[res])\n\t"
+                  "movq %%rdx, (%%rax)\n"
+                  CPU_CS_END
+                  : /* no outputs */
+                  : CPU_CS_INPUTS(offset), [res] "r" (result)
+                  : "rax", "rcx", "rdx", "memory", "cc"
+                  : empty, no_cpu);
+    return 1;
+  empty:
+    return 0;
+  no_cpu:
+    return -1;
+  }
+
+  /* Store the list to the one at the given offset in the free lists of */
+  /* the current CPU if the latter is empty.  Return TRUE on success.   */
+  static GC_bool cpu_fl_push_if_empty(word offset, void *list)
+  {
+    __asm__ goto (CPU_CS_BEGIN
+                  "cmpq $0, (%%rax)\n\t"
+                  "jne %l[no_cpu]\n\t"
+                  "movq %[list], (%%rax)\n"
+                  CPU_CS_END
+                  : /* no outputs */
+                  : CPU_CS_INPUTS(offset), [list] "r" (list)
+                  : "rax", "memory", "cc"
+                  : no_cpu);
+    return TRUE;
+  no_cpu:
+    return FALSE;
+  }
+
+  /* Allocate an object of the given size (in granules, nonzero and     */
+  /* less than TINY_FREELISTS) and kind (PTRFREE or NORMAL) from the    */
+  /* free list of the current CPU, refilling the list if it is empty.   */
+  /* The first word of the object is not cleared.  Return NULL if the   */
+  /* thread-local free lists (of p) are to be used instead.             */
+  STATIC void * GC_cpu_malloc(GC_tlfs p, size_t granules, int kind)
+  {
+    word offset = (kind == NORMAL
+                    ? offsetof(struct cpu_freelists, normal_freelists)
+                    : offsetof(struct cpu_freelists, ptrfree_freelists))
+                  + granules * sizeof(void *);
+    void *result;
+    void *rest;
+    int res = cpu_fl_pop(offset, &result);
+
+    if (EXPECT(res > 0, TRUE)) return result;
+    if (res < 0) return NULL;
+
+    /* The refilled list is stored in p (rather than in a local        */
+    /* variable) so that the pointer-free objects are not collected    */
+    /* until the list is published.                                     */
+    GC_generic_malloc_many(GRANULES_TO_BYTES(granules), kind,
+                           &(p -> cpu_refill));
+    result = p -> cpu_refill;
+    if (EXPECT(NULL == result, FALSE)) return NULL;
+    rest = obj_link(result);
+    if (rest != NULL) {
+      GC_bool shared = FALSE;
+      DCL_LOCK_STATE;
+
+      /* Once published, the rest may be taken by other threads (which  */
+      /* overwrite the links), so it should not be reachable from p     */
+      /* when a collection marks the latter: the push and the clearing  */
+      /* of p -> cpu_refill are done while the collections are          */
+      /* excluded.  If the list has been refilled by another thread on  */
+      /* the same CPU meanwhile (or the thread is migrated), the rest   */
+      /* is just left to the collector.                                 */
+#     ifdef FINE_GRAINED_LOCKS
+        shared = GC_enter_shared_alloc();
+#     endif
+      if (!shared) LOCK();
+      (void)cpu_fl_push_if_empty(offset, rest);
+      p -> cpu_refill = NULL;
+#     ifdef FINE_GRAINED_LOCKS
+        if (shared) {
+          GC_leave_shared_alloc();
+        } else
+#     endif
+      /* else */ {
+        UNLOCK();
+      }
+    } else {
+      p -> cpu_refill = NULL;
+    }
+    return result;
+  }
+
+  GC_INNER void GC_mark_cpu_freelists(void)
+  {
+    unsigned cpu;
+    int j;
+    ptr_t q;
+    word bytes = 0;
+
+    if (NULL == GC_cpu_fls) return;
+    for (cpu = 0; cpu < GC_cpu_fls_cnt; ++cpu) {
+      struct cpu_freelists *fls =
+                (struct cpu_freelists *)(GC_cpu_fls + cpu * CPU_FLS_STRIDE);
+
+      for (j = 1; j < TINY_FREELISTS; ++j) {
+        q = fls -> ptrfree_freelists[j];
+        if (q != NULL) {
+          GC_set_fl_marks(q);
+          bytes += fl_bytes(q);
+        }
+        q = fls -> normal_freelists[j];
+        if (q != NULL) {
+          GC_set_fl_marks(q);
+          bytes += fl_bytes(q);
+        }
+      }
+    }
+    GC_tl_stranded_bytes += bytes;
+  }
+
+# ifdef GC_ASSERTIONS
+    /* Check that all per-CPU free lists are completely marked.         */
+    void GC_check_cpu_freelists(void)
+    {
+      unsigned cpu;
+      int j;
+
+      if (NULL == GC_cpu_fls) return;
+      for (cpu = 0; cpu < GC_cpu_fls_cnt; ++cpu) {
+        struct cpu_freelists *fls =
+                (struct cpu_freelists *)(GC_cpu_fls + cpu * CPU_FLS_STRIDE);
+
+        for (j = 1; j < TINY_FREELISTS; ++j) {
+          GC_check_fl_marks(&(fls -> ptrfree_freelists[j]));
+          GC_check_fl_marks(&(fls -> normal_freelists[j]));
+        }
+      }
+    }
+# endif
+#endif /* PER_CPU_ALLOC */
+
 /* Each thread structure must be initialized.   */
 /* This call must be made from the new thread.  */
 GC_INNER void GC_init_thread_local(GC_tlfs p)
@@ -95,6 +890,12 @@ GC_INNER void GC_init_thread_local(GC_tlfs p)
             ABORT("Failed to create key for local allocator");
         }
         keys_initialized = TRUE;
+#       ifdef REMOTE_FREE
+          GC_init_remote_queues();
+#       endif
+#       ifdef PER_CPU_ALLOC
+          GC_init_cpu_freelists();
+#       endif
     }
     if (0 != GC_setspecific(GC_thread_key, p)) {
         ABORT("Failed to set thread specific allocation pointers");
@@ -108,6 +909,8 @@ GC_INNER void GC_init_thread_local(GC_tlfs p)
 #       ifdef ENABLE_DISCLAIM
           p -> finalized_freelists[i] = (void *)(word)1;
 #       endif
+        p -> uncollectable_freelists[i] = (void *)(word)1;
+        p -> typed_freelists[i] = (void *)(word)1;
     }
     /* Set up the size 0 free lists.    */
     /* We now handle most of them like regular free lists, to ensure    */
@@ -120,6 +923,27 @@ GC_INNER void GC_init_thread_local(GC_tlfs p)
 #   endif
 #   ifdef ENABLE_DISCLAIM
         p -> finalized_freelists[0] = (void *)(word)1;
+#   endif
+    p -> uncollectable_freelists[0] = (void *)(word)1;
+    p -> typed_freelists[0] = (void *)(word)1;
+#   ifndef NO_TL_HBLK_CACHE
+      p -> hblk_cache_cnt = 0;
+      p -> hblk_bytes_allocd = 0;
+      p -> hblk_refills = 0;
+#   endif
+    for (i = 0; i < TL_FREELIST_KINDS * TINY_FREELISTS; ++i) {
+      p -> refill_log[i] = TL_REFILL_INIT_LOG;
+      p -> refill_count[i] = 0;
+    }
+    p -> refill_gc_no = GC_gc_no;
+#   ifdef HEAP_PROFILE
+      p -> sample_countdown = GC_next_heap_sample();
+#   endif
+#   ifdef REMOTE_FREE
+      GC_acquire_remote_queue(p);
+#   endif
+#   ifdef PER_CPU_ALLOC
+      p -> cpu_refill = NULL;
 #   endif
 }
 
@@ -128,6 +952,9 @@ GC_INNER void GC_destroy_thread_local(GC_tlfs p)
 {
     /* We currently only do this from the thread itself or from */
     /* the fork handler for a child process.                    */
+#   ifndef NO_TL_HBLK_CACHE
+      GC_flush_tl_hblk_cache(p);
+#   endif
     return_freelists(p -> ptrfree_freelists, GC_aobjfreelist);
     return_freelists(p -> normal_freelists, GC_objfreelist);
 #   ifdef GC_GCJ_SUPPORT
@@ -136,6 +963,20 @@ GC_INNER void GC_destroy_thread_local(GC_tlfs p)
 #   ifdef ENABLE_DISCLAIM
         return_freelists(p -> finalized_freelists,
                          (void **)GC_finalized_objfreelist);
+#   endif
+    {
+      int i;
+
+      /* The objects are no longer held by the thread.  */
+      for (i = 0; i < TINY_FREELISTS; ++i) {
+        if ((word)(p -> uncollectable_freelists[i]) >= HBLKSIZE)
+          GC_non_gc_bytes -= fl_bytes((ptr_t)p -> uncollectable_freelists[i]);
+      }
+    }
+    return_freelists(p -> uncollectable_freelists, GC_uobjfreelist);
+    return_freelists(p -> typed_freelists, (void **)GC_eobjfreelist);
+#   ifdef REMOTE_FREE
+      GC_release_remote_queue(p);
 #   endif
 }
 
@@ -171,9 +1012,22 @@ GC_API void * GC_CALL GC_malloc(size_t bytes)
 
     GC_ASSERT(GC_is_thread_tsd_valid(tsd));
 
+#   ifdef PER_CPU_ALLOC
+      if (EXPECT(granules - 1 < TINY_FREELISTS - 1 && GC_cpu_fls != NULL,
+                 TRUE)) {
+        result = GC_cpu_malloc((GC_tlfs)tsd, granules, NORMAL);
+        if (EXPECT(result != NULL, TRUE)) {
+          obj_link(result) = 0;
+          GC_TL_SAMPLE(tsd, result, bytes);
+          return result;
+        }
+      }
+#   endif
     tiny_fl = ((GC_tlfs)tsd) -> normal_freelists;
     GC_FAST_MALLOC_GRANS(result, granules, tiny_fl, DIRECT_GRANULES,
-                         NORMAL, GC_core_malloc(bytes), obj_link(result)=0);
+                         NORMAL, GC_core_malloc(bytes),
+                         {obj_link(result) = 0;
+                          GC_TL_SAMPLE(tsd, result, bytes);});
 #   ifdef LOG_ALLOCS
       GC_err_printf("GC_malloc(%lu) = %p, GC: %lu\n",
                     (unsigned long)bytes, result, (unsigned long)GC_gc_no);
@@ -205,9 +1059,57 @@ GC_API void * GC_CALL GC_malloc_atomic(size_t bytes)
       }
 #   endif
     GC_ASSERT(GC_is_initialized);
+#   ifdef PER_CPU_ALLOC
+      if (EXPECT(granules - 1 < TINY_FREELISTS - 1 && GC_cpu_fls != NULL,
+                 TRUE)) {
+        result = GC_cpu_malloc((GC_tlfs)tsd, granules, PTRFREE);
+        if (EXPECT(result != NULL, TRUE)) {
+          GC_TL_SAMPLE(tsd, result, bytes);
+          return result;
+        }
+      }
+#   endif
     tiny_fl = ((GC_tlfs)tsd) -> ptrfree_freelists;
     GC_FAST_MALLOC_GRANS(result, granules, tiny_fl, DIRECT_GRANULES, PTRFREE,
-                         GC_core_malloc_atomic(bytes), (void)0 /* no init */);
+                         GC_core_malloc_atomic(bytes),
+                         GC_TL_SAMPLE(tsd, result, bytes));
+    return result;
+}
+
+GC_API void * GC_CALL GC_malloc_uncollectable(size_t bytes)
+{
+    size_t granules;
+    void *tsd;
+    void *result;
+    void **tiny_fl;
+
+#   if !defined(USE_PTHREAD_SPECIFIC) && !defined(USE_WIN32_SPECIFIC)
+      GC_key_t k = GC_thread_key;
+      if (EXPECT(0 == k, FALSE)) {
+        return GC_core_malloc_uncollectable(bytes);
+      }
+      tsd = GC_getspecific(k);
+#   else
+      tsd = GC_getspecific(GC_thread_key);
+#   endif
+#   if !defined(USE_COMPILER_TLS) && !defined(USE_WIN32_COMPILER_TLS)
+      if (EXPECT(0 == tsd, FALSE)) {
+        return GC_core_malloc_uncollectable(bytes);
+      }
+#   endif
+    GC_ASSERT(GC_is_initialized);
+    /* The extra byte is not needed, since the object won't be          */
+    /* collected anyway.                                                */
+    granules = ROUNDED_UP_GRANULES(EXTRA_BYTES != 0 && bytes != 0 ?
+                                   bytes - 1 : bytes);
+    tiny_fl = ((GC_tlfs)tsd) -> uncollectable_freelists;
+    /* The objects on the list are already marked (and counted in       */
+    /* GC_non_gc_bytes).                                                */
+    GC_FAST_MALLOC_GRANS(result, granules, tiny_fl, DIRECT_GRANULES,
+                         UNCOLLECTABLE, GC_core_malloc_uncollectable(bytes),
+                         {obj_link(result) = 0;
+                          GC_ASSERT(GC_is_marked(result));
+                          GC_TL_SAMPLE(tsd, result, bytes);});
     return result;
 }
 
@@ -245,15 +1147,16 @@ GC_API void * GC_CALL GC_gcj_malloc(size_t bytes,
   } else {
     size_t granules = ROUNDED_UP_GRANULES(bytes);
     void *result;
-    void **tiny_fl = ((GC_tlfs)GC_getspecific(GC_thread_key))
-                                        -> gcj_freelists;
+    void *tsd = GC_getspecific(GC_thread_key);
+    void **tiny_fl = ((GC_tlfs)tsd) -> gcj_freelists;
     GC_ASSERT(GC_gcj_malloc_initialized);
     GC_FAST_MALLOC_GRANS(result, granules, tiny_fl, DIRECT_GRANULES,
                          GC_gcj_kind,
                          GC_core_gcj_malloc(bytes,
                                             ptr_to_struct_containing_descr),
                          {AO_compiler_barrier();
-                          *(void **)result = ptr_to_struct_containing_descr;});
+                          *(void **)result = ptr_to_struct_containing_descr;
+                          GC_TL_SAMPLE(tsd, result, bytes);});
         /* This forces the initialization of the "method ptr".          */
         /* This is necessary to ensure some very subtle properties      */
         /* required if a GC is run in the middle of such an allocation. */
@@ -278,32 +1181,123 @@ GC_API void * GC_CALL GC_gcj_malloc(size_t bytes,
 
 #endif /* GC_GCJ_SUPPORT */
 
+/* Drop the objects of the free list *flp past the first two ones, so  */
+/* that they are reclaimed by the collection (which is about to mark    */
+/* the list).  The owner is stopped but could be popping the first      */
+/* object (having read the link to the second one), or prepending       */
+/* objects (see GC_tl_remote_drain).  Spans are kept as they are.       */
+static void trim_idle_fl(void **flp)
+{
+    ptr_t q = (ptr_t)(*flp);
+
+    if ((word)q <= HBLKSIZE) return;
+#   ifdef USE_ALLOC_SPANS
+      if (IS_SPAN(q)) return;
+#   endif
+    q = (ptr_t)obj_link(q);
+    if (q != NULL) obj_link(q) = NULL;
+}
+
+/* Called by the collector (with the world stopped) for each thread.    */
+/* The refill batch of a list refilled fewer than TL_REFILL_SHRINK      */
+/* times in the recent collection cycle is halved (as many times as     */
+/* there were collections since the previous call).  A list not         */
+/* refilled at all is considered idle; all but two of its objects are   */
+/* returned (the uncollectable and finalized ones are kept, as those    */
+/* would not be reclaimed by the sweep).                                */
+static void decay_refills(GC_tlfs p)
+{
+    word elapsed = GC_gc_no - p -> refill_gc_no;
+    int i;
+
+    if (0 == elapsed) return;
+    p -> refill_gc_no = GC_gc_no;
+    for (i = 0; i < TL_FREELIST_KINDS * TINY_FREELISTS; ++i) {
+      unsigned log = p -> refill_log[i];
+
+      if (p -> refill_count[i] < TL_REFILL_SHRINK)
+        p -> refill_log[i] = (unsigned char)(elapsed < log ? log - elapsed
+                                                           : 0);
+      if (0 == p -> refill_count[i]) {
+        void **flp = &(p -> ptrfree_freelists[0]) + i;
+
+        if ((word)flp < (word)(p -> normal_freelists + TINY_FREELISTS)
+#           ifdef GC_GCJ_SUPPORT
+              || ((word)flp > (word)(p -> gcj_freelists)
+                  && (word)flp < (word)(p -> gcj_freelists + TINY_FREELISTS))
+#           endif
+            || (word)flp >= (word)(p -> typed_freelists))
+          trim_idle_fl(flp);
+      }
+      p -> refill_count[i] = 0;
+    }
+}
+
 /* The thread support layer must arrange to mark thread-local   */
 /* free lists explicitly, since the link field is often         */
 /* invisible to the marker.  It knows how to find all threads;  */
 /* we take care of an individual thread freelist structure.     */
+/* The idle lists are trimmed first (see decay_refills).        */
+/* The bytes held by the lists are added to                     */
+/* GC_tl_stranded_bytes (which the thread support layer clears  */
+/* first).                                                      */
 GC_INNER void GC_mark_thread_local_fls_for(GC_tlfs p)
 {
     ptr_t q;
     int j;
+    word bytes = 0;
+
+    decay_refills(p);
 
+#   ifdef USE_ALLOC_SPANS
+#     define SET_FL_MARKS(q) \
+                (IS_SPAN(q) ? set_span_marks(q) : GC_set_fl_marks(q))
+#   else
+#     define SET_FL_MARKS(q) GC_set_fl_marks(q)
+#   endif
     for (j = 0; j < TINY_FREELISTS; ++j) {
       q = p -> ptrfree_freelists[j];
-      if ((word)q > HBLKSIZE) GC_set_fl_marks(q);
+      if ((word)q > HBLKSIZE) {
+        SET_FL_MARKS(q);
+        bytes += fl_bytes(q);
+      }
       q = p -> normal_freelists[j];
-      if ((word)q > HBLKSIZE) GC_set_fl_marks(q);
+      if ((word)q > HBLKSIZE) {
+        SET_FL_MARKS(q);
+        bytes += fl_bytes(q);
+      }
 #     ifdef GC_GCJ_SUPPORT
         if (j > 0) {
           q = p -> gcj_freelists[j];
-          if ((word)q > HBLKSIZE) GC_set_fl_marks(q);
+          if ((word)q > HBLKSIZE) {
+            SET_FL_MARKS(q);
+            bytes += fl_bytes(q);
+          }
         }
 #     endif /* GC_GCJ_SUPPORT */
 #     ifdef ENABLE_DISCLAIM
         q = p -> finalized_freelists[j];
-        if ((word)q > HBLKSIZE)
+        if ((word)q > HBLKSIZE) {
           GC_set_fl_marks(q);
+          bytes += fl_bytes(q);
+        }
 #     endif
+      q = p -> uncollectable_freelists[j];
+      if ((word)q > HBLKSIZE) {
+        GC_set_fl_marks(q);
+        bytes += fl_bytes(q);
+      }
+      q = p -> typed_freelists[j];
+      if ((word)q > HBLKSIZE) {
+        GC_set_fl_marks(q);
+        bytes += fl_bytes(q);
+      }
     }
+#   ifdef PER_CPU_ALLOC
+      q = p -> cpu_refill;
+      if (q != NULL) GC_set_fl_marks(q);
+#   endif
+    GC_tl_stranded_bytes += bytes;
 }
 
 #if defined(GC_ASSERTIONS)
@@ -321,6 +1315,8 @@ GC_INNER void GC_mark_thread_local_fls_for(GC_tlfs p)
 #         ifdef ENABLE_DISCLAIM
             GC_check_fl_marks(&p->finalized_freelists[j]);
 #         endif
+          GC_check_fl_marks(&p->uncollectable_freelists[j]);
+          GC_check_fl_marks(&p->typed_freelists[j]);
         }
     }
 #endif /* GC_ASSERTIONS */
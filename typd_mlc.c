@@ -334,7 +334,11 @@ GC_make_sequence_descriptor(complex_descriptor *first,
   }
 #endif
 
-STATIC ptr_t * GC_eobjfreelist = NULL;
+#ifdef THREAD_LOCAL_ALLOC
+# include "private/thread_local_alloc.h"
+#else
+  STATIC ptr_t * GC_eobjfreelist = NULL;
+#endif
 
 STATIC ptr_t * GC_arobjfreelist = NULL;
 
@@ -581,7 +585,11 @@ GC_API GC_descr GC_CALL GC_make_descriptor(const GC_word * bm, size_t len)
     }
 }
 
-GC_API void * GC_CALL GC_malloc_explicitly_typed(size_t lb, GC_descr d)
+#ifdef THREAD_LOCAL_ALLOC
+  STATIC void * GC_core_malloc_explicitly_typed(size_t lb, GC_descr d)
+#else
+  GC_API void * GC_CALL GC_malloc_explicitly_typed(size_t lb, GC_descr d)
+#endif
 {
     ptr_t op;
     ptr_t * opp;
@@ -604,6 +612,7 @@ GC_API void * GC_CALL GC_malloc_explicitly_typed(size_t lb, GC_descr d)
             *opp = obj_link(op);
             obj_link(op) = 0;
             GC_bytes_allocd += GRANULES_TO_BYTES(lg);
+            GC_CLASS_ALLOCD(GC_explicit_kind, lg, GRANULES_TO_BYTES(lg));
             UNLOCK();
         }
         ((word *)op)[GRANULES_TO_WORDS(lg) - 1] = d;
@@ -617,6 +626,68 @@ GC_API void * GC_CALL GC_malloc_explicitly_typed(size_t lb, GC_descr d)
    return((void *) op);
 }
 
+#ifdef THREAD_LOCAL_ALLOC
+  GC_API void * GC_CALL GC_malloc_explicitly_typed(size_t lb, GC_descr d)
+  {
+    size_t granules = ROUNDED_UP_GRANULES(lb + TYPD_EXTRA_BYTES);
+    void *tsd;
+    void *result;
+    void **tiny_fl;
+    GC_bool from_tl = FALSE;
+
+#   if !defined(USE_PTHREAD_SPECIFIC) && !defined(USE_WIN32_SPECIFIC)
+      GC_key_t k = GC_thread_key;
+      if (EXPECT(0 == k, FALSE)) {
+        return GC_core_malloc_explicitly_typed(lb, d);
+      }
+      tsd = GC_getspecific(k);
+#   else
+      tsd = GC_getspecific(GC_thread_key);
+#   endif
+#   if !defined(USE_COMPILER_TLS) && !defined(USE_WIN32_COMPILER_TLS)
+      if (EXPECT(0 == tsd, FALSE)) {
+        return GC_core_malloc_explicitly_typed(lb, d);
+      }
+#   endif
+    if (EXPECT(!GC_explicit_typing_initialized, FALSE))
+      return GC_core_malloc_explicitly_typed(lb, d);
+    tiny_fl = ((GC_tlfs)tsd) -> typed_freelists;
+    GC_FAST_MALLOC_GRANS(result, granules, tiny_fl, DIRECT_GRANULES,
+                         GC_explicit_kind,
+                         GC_core_malloc_explicitly_typed(lb, d),
+                         {obj_link(result) = 0;
+                          from_tl = TRUE;
+                          GC_TL_SAMPLE(tsd, result, lb);});
+    /* The descriptor is stored after the object is taken from the      */
+    /* list, as in the locked path; the free objects are cleared, so    */
+    /* the marker sees a zero descriptor in the meantime.               */
+    if (from_tl)
+      ((word *)result)[GRANULES_TO_WORDS(granules) - 1] = d;
+    return result;
+  }
+#endif /* THREAD_LOCAL_ALLOC */
+
+GC_API size_t GC_CALL GC_malloc_explicitly_typed_bulk(size_t lb,
+                                                      GC_descr d, size_t n,
+                                                      void **result)
+{
+    size_t i;
+    size_t count;
+
+    lb += TYPD_EXTRA_BYTES;
+    count = GC_generic_malloc_bulk(lb, GC_explicit_kind, n, result);
+    if (SMALL_OBJ(lb)) {
+        size_t lw = GRANULES_TO_WORDS(GC_size_map[lb]);
+
+        for (i = 0; i < count; i++)
+            ((word *)result[i])[lw - 1] = d;
+    } else {
+        for (i = 0; i < count; i++)
+            ((word *)result[i])[BYTES_TO_WORDS(GC_size(result[i])) - 1] = d;
+    }
+    return count;
+}
+
 GC_API void * GC_CALL GC_malloc_explicitly_typed_ignore_off_page(size_t lb,
                                                                  GC_descr d)
 {
@@ -641,6 +712,7 @@ GC_API void * GC_CALL GC_malloc_explicitly_typed_ignore_off_page(size_t lb,
             *opp = obj_link(op);
             obj_link(op) = 0;
             GC_bytes_allocd += GRANULES_TO_BYTES(lg);
+            GC_CLASS_ALLOCD(GC_explicit_kind, lg, GRANULES_TO_BYTES(lg));
             UNLOCK();
         }
         ((word *)op)[GRANULES_TO_WORDS(lg) - 1] = d;
@@ -694,6 +766,7 @@ GC_API void * GC_CALL GC_calloc_explicitly_typed(size_t n, size_t lb,
             *opp = obj_link(op);
             obj_link(op) = 0;
             GC_bytes_allocd += GRANULES_TO_BYTES(lg);
+            GC_CLASS_ALLOCD(GC_array_kind, lg, GRANULES_TO_BYTES(lg));
             UNLOCK();
         }
    } else {
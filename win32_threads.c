@@ -2138,6 +2138,11 @@ GC_INNER void GC_get_next_stack(char *start, char *limit,
 
 # endif /* ! GC_PTHREADS_PARAMARK */
 
+  GC_INNER void GC_marker_yield(void)
+  {
+    Sleep(0);
+  }
+
 #endif /* PARALLEL_MARK */
 
   /* We have no DllMain to take care of new threads.  Thus we   */
@@ -2489,7 +2494,10 @@ GC_INNER void GC_thr_init(void)
 
 # ifdef PARALLEL_MARK
     /* If we are using a parallel marker, actually start helper threads. */
-    if (GC_parallel) start_mark_threads();
+    if (GC_parallel) {
+      start_mark_threads();
+      GC_max_markers_m1 = GC_markers_m1; /* the pool is not resizable */
+    }
     if (GC_print_stats) {
       GC_log_printf("Started %d mark helper threads\n", GC_markers_m1);
     }
@@ -2843,6 +2851,7 @@ GC_INNER void GC_init_parallel(void)
     int i;
     GC_thread p;
 
+    GC_tl_stranded_bytes = 0;
     for (i = 0; i < THREAD_TABLE_SZ; ++i) {
       for (p = GC_threads[i]; 0 != p; p = p -> tm.next) {
         if (!KNOWN_FINISHED(p)) {
@@ -2853,8 +2862,36 @@ GC_INNER void GC_init_parallel(void)
         }
       }
     }
+#   ifdef REMOTE_FREE
+      GC_mark_remote_free_queues();
+#   endif
   }
 
+# ifndef NO_TL_HBLK_CACHE
+    GC_INNER void GC_flush_thread_local_hblks(void)
+    {
+      int i;
+      GC_thread p;
+
+      GC_ASSERT(I_HOLD_LOCK());
+#     ifdef LOCK_FREE_HBLK_CACHE
+        AO_store(&GC_tl_hblk_flushing, TRUE);
+        AO_nop_full();
+        while (AO_load(&GC_tl_hblk_users) != 0)
+          Sleep(0); /* yield */
+#     endif
+      for (i = 0; i < THREAD_TABLE_SZ; ++i) {
+        for (p = GC_threads[i]; 0 != p; p = p -> tm.next) {
+          if (!KNOWN_FINISHED(p))
+            GC_flush_tl_hblk_cache(&(p->tlfs));
+        }
+      }
+#     ifdef LOCK_FREE_HBLK_CACHE
+        AO_store(&GC_tl_hblk_flushing, FALSE);
+#     endif
+    }
+# endif
+
 # if defined(GC_ASSERTIONS)
     void GC_check_tls_for(GC_tlfs p);
 #   if defined(USE_CUSTOM_SPECIFIC)